@@ -118,3 +118,87 @@ cc_color_device_get_sortable_base (CdDevice *device)
   g_free (title);
   return sortable;
 }
+
+/* Connected profiles by object path, shared by every instance of the
+ * panel. The proxies keep their properties up to date, so they only
+ * need to go when colord drops the profile. */
+static GHashTable *profile_cache = NULL;
+static CdClient *profile_cache_client = NULL;
+
+static void
+profile_cache_profile_removed_cb (CdClient  *client,
+                                  CdProfile *profile,
+                                  gpointer   user_data)
+{
+  g_hash_table_remove (profile_cache, cd_profile_get_object_path (profile));
+}
+
+static void
+profile_cache_connect_cb (GObject      *object,
+                          GAsyncResult *res,
+                          gpointer      user_data)
+{
+  CdProfile *profile = CD_PROFILE (object);
+  GTask *task = G_TASK (user_data);
+  GError *error = NULL;
+
+  if (!cd_profile_connect_finish (profile, res, &error))
+    {
+      g_task_return_error (task, error);
+      g_object_unref (task);
+      return;
+    }
+
+  g_hash_table_replace (profile_cache,
+                        g_strdup (cd_profile_get_object_path (profile)),
+                        g_object_ref (profile));
+  g_task_return_pointer (task, g_object_ref (profile), g_object_unref);
+  g_object_unref (task);
+}
+
+/**
+ * cc_color_profile_connect_cached:
+ *
+ * Like cd_profile_connect(), but profiles that were already connected
+ * once are handed back straight away. The profile returned by
+ * cc_color_profile_connect_cached_finish() may therefore be a
+ * different object for the same colord profile.
+ **/
+void
+cc_color_profile_connect_cached (CdClient            *client,
+                                 CdProfile           *profile,
+                                 GCancellable        *cancellable,
+                                 GAsyncReadyCallback  callback,
+                                 gpointer             user_data)
+{
+  CdProfile *cached;
+  GTask *task;
+
+  if (profile_cache == NULL)
+    {
+      profile_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                             g_free, g_object_unref);
+      profile_cache_client = g_object_ref (client);
+      g_signal_connect (profile_cache_client, "profile-removed",
+                        G_CALLBACK (profile_cache_profile_removed_cb), NULL);
+    }
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+
+  cached = g_hash_table_lookup (profile_cache, cd_profile_get_object_path (profile));
+  if (cached != NULL)
+    {
+      g_task_return_pointer (task, g_object_ref (cached), g_object_unref);
+      g_object_unref (task);
+      return;
+    }
+
+  cd_profile_connect (profile, cancellable, profile_cache_connect_cb, task);
+}
+
+CdProfile *
+cc_color_profile_connect_cached_finish (GAsyncResult  *res,
+                                        GError       **error)
+{
+  return g_task_propagate_pointer (G_TASK (res), error);
+}
@@ -29,6 +29,14 @@
 gchar   *cc_color_device_get_sortable_base (CdDevice *device);
 gchar   *cc_color_device_get_title         (CdDevice *device);
 
+void       cc_color_profile_connect_cached        (CdClient            *client,
+                                                   CdProfile           *profile,
+                                                   GCancellable        *cancellable,
+                                                   GAsyncReadyCallback  callback,
+                                                   gpointer             user_data);
+CdProfile *cc_color_profile_connect_cached_finish (GAsyncResult        *res,
+                                                   GError             **error);
+
 G_END_DECLS
 
 #endif /* CC_COLOR_COMMON_H */
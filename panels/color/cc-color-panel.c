@@ -46,9 +46,12 @@ struct _CcColorPanelPrivate
 {
   CdClient      *client;
   CdDevice      *current_device;
-  GPtrArray     *devices;
+  GHashTable    *device_rows;
   GPtrArray     *sensors;
   GCancellable  *cancellable;
+  GCancellable  *sensors_cancellable;
+  GCancellable  *assign_cancellable;
+  guint          n_loading;
   GDBusProxy    *proxy;
   GSettings     *settings;
   GSettings     *settings_colord;
@@ -107,6 +110,109 @@ enum {
 #define GCM_PREFS_MAX_DEVICES_PROFILES_EXPANDED         5
 
 static void gcm_prefs_refresh_toolbar_buttons (CcColorPanel *panel);
+static void gcm_prefs_update_device_list_extra_entry (CcColorPanel *prefs);
+static void gcm_prefs_set_calibrate_button_sensitivity (CcColorPanel *prefs);
+
+/* The rows of a device, by device object path */
+typedef struct
+{
+  CdDevice      *device;
+  gulong         changed_id;
+  GtkWidget     *row;
+  GHashTable    *profile_rows;
+} GcmPrefsDeviceRows;
+
+static GcmPrefsDeviceRows *
+gcm_prefs_device_rows_new (CdDevice *device)
+{
+  GcmPrefsDeviceRows *rows;
+
+  rows = g_new0 (GcmPrefsDeviceRows, 1);
+  rows->device = g_object_ref (device);
+
+  /* profile object path to row, or to NULL while connecting */
+  rows->profile_rows = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                              g_free, NULL);
+  return rows;
+}
+
+static void
+gcm_prefs_device_rows_free (GcmPrefsDeviceRows *rows)
+{
+  if (rows->changed_id != 0)
+    g_signal_handler_disconnect (rows->device, rows->changed_id);
+  g_object_unref (rows->device);
+  g_hash_table_destroy (rows->profile_rows);
+  g_free (rows);
+}
+
+/* the device may have been removed, or replaced, while connecting */
+static GcmPrefsDeviceRows *
+gcm_prefs_lookup_device_rows (CcColorPanel *prefs, CdDevice *device)
+{
+  GcmPrefsDeviceRows *rows;
+
+  rows = g_hash_table_lookup (prefs->priv->device_rows,
+                              cd_device_get_object_path (device));
+  if (rows == NULL || rows->device != device)
+    return NULL;
+  return rows;
+}
+
+/* A device or device profile being connected to. The panel may be
+ * gone by the time the call returns, in which case the cancellable
+ * is cancelled and nothing else may be touched. */
+typedef struct
+{
+  CcColorPanel  *prefs;
+  GCancellable  *cancellable;
+  CdDevice      *device;
+  gchar         *profile_path;
+  gboolean       is_default;
+} GcmPrefsLoad;
+
+static GcmPrefsLoad *
+gcm_prefs_load_new (CcColorPanel *prefs, CdDevice *device)
+{
+  GcmPrefsLoad *load;
+
+  load = g_new0 (GcmPrefsLoad, 1);
+  load->prefs = prefs;
+  load->cancellable = g_object_ref (prefs->priv->cancellable);
+  load->device = g_object_ref (device);
+  prefs->priv->n_loading++;
+  return load;
+}
+
+static void
+gcm_prefs_load_free (GcmPrefsLoad *load)
+{
+  CcColorPanelPrivate *priv;
+  GcmPrefsDeviceRows *rows;
+  gpointer row;
+
+  if (!g_cancellable_is_cancelled (load->cancellable))
+    {
+      priv = load->prefs->priv;
+
+      /* forget about profiles that did not make it to the list */
+      rows = gcm_prefs_lookup_device_rows (load->prefs, load->device);
+      if (rows != NULL && load->profile_path != NULL &&
+          g_hash_table_lookup_extended (rows->profile_rows, load->profile_path, NULL, &row) &&
+          row == NULL)
+        g_hash_table_remove (rows->profile_rows, load->profile_path);
+
+      /* only decide on the 'No devices detected' entry and on
+       * expanding the only device once everything is there */
+      if (--priv->n_loading == 0)
+        gcm_prefs_update_device_list_extra_entry (load->prefs);
+    }
+
+  g_object_unref (load->cancellable);
+  g_object_unref (load->device);
+  g_free (load->profile_path);
+  g_free (load);
+}
 
 static void
 gcm_prefs_combobox_add_profile (CcColorPanel *prefs,
@@ -738,30 +844,116 @@ gcm_prefs_combo_sort_func_cb (GtkTreeModel *model,
   return retval;
 }
 
-static gboolean
-gcm_prefs_profile_exists_in_array (GPtrArray *array, CdProfile *profile)
+/* Filling the list of profiles that can be assigned to a device */
+typedef struct
 {
+  CcColorPanel  *prefs;
+  GCancellable  *cancellable;
+  CdDevice      *device;
+  GHashTable    *device_profiles;
+  guint          pending;
+} GcmPrefsAssign;
+
+static void
+gcm_prefs_assign_unref (GcmPrefsAssign *assign)
+{
+  if (--assign->pending > 0)
+    return;
+
+  g_object_unref (assign->cancellable);
+  g_object_unref (assign->device);
+  g_hash_table_destroy (assign->device_profiles);
+  g_free (assign);
+}
+
+static void
+gcm_prefs_assign_profile_connect_cb (GObject *object,
+                                     GAsyncResult *res,
+                                     gpointer user_data)
+{
+  GcmPrefsAssign *assign = user_data;
+  CdProfile *profile;
+  GError *error = NULL;
+  GtkTreeIter iter;
+
+  profile = cc_color_profile_connect_cached_finish (res, &error);
+  if (g_cancellable_is_cancelled (assign->cancellable))
+    goto out;
+  if (profile == NULL)
+    {
+      g_warning ("failed to get profile: %s", error->message);
+      goto out;
+    }
+
+  /* only add correct types */
+  if (!gcm_prefs_is_profile_suitable_for_device (profile, assign->device))
+    goto out;
+
+#if CD_CHECK_VERSION(0,1,13)
+  /* ignore profiles from other user accounts */
+  if (!cd_profile_has_access (profile))
+    goto out;
+#endif
+
+  /* add */
+  gcm_prefs_combobox_add_profile (assign->prefs, profile, &iter);
+out:
+  g_clear_error (&error);
+  g_clear_object (&profile);
+  gcm_prefs_assign_unref (assign);
+}
+
+static void
+gcm_prefs_assign_get_profiles_cb (GObject *object,
+                                  GAsyncResult *res,
+                                  gpointer user_data)
+{
+  GcmPrefsAssign *assign = user_data;
   CdProfile *profile_tmp;
+  GError *error = NULL;
+  GPtrArray *profile_array;
   guint i;
 
-  for (i = 0; i < array->len; i++)
+  profile_array = cd_client_get_profiles_finish (CD_CLIENT (object), res, &error);
+  if (g_cancellable_is_cancelled (assign->cancellable))
+    goto out;
+  if (profile_array == NULL)
     {
-      profile_tmp = g_ptr_array_index (array, i);
-      if (cd_profile_equal (profile, profile_tmp))
-         return TRUE;
+      g_warning ("failed to get profiles: %s",
+           error->message);
+      goto out;
     }
-  return FALSE;
+
+  /* connect to all the profiles at once, and add them as they arrive */
+  for (i = 0; i < profile_array->len; i++)
+    {
+      profile_tmp = g_ptr_array_index (profile_array, i);
+
+      /* don't add any of the already added profiles, which
+       * needs comparing object paths as they are not connected yet */
+      if (g_hash_table_contains (assign->device_profiles,
+                                 cd_profile_get_object_path (profile_tmp)))
+        continue;
+
+      assign->pending++;
+      cc_color_profile_connect_cached (assign->prefs->priv->client,
+                                       profile_tmp,
+                                       assign->cancellable,
+                                       gcm_prefs_assign_profile_connect_cb,
+                                       assign);
+    }
+out:
+  g_clear_error (&error);
+  if (profile_array != NULL)
+    g_ptr_array_unref (profile_array);
+  gcm_prefs_assign_unref (assign);
 }
 
 static void
 gcm_prefs_add_profiles_suitable_for_devices (CcColorPanel *prefs,
                                              GPtrArray *profiles)
 {
-  CdProfile *profile_tmp;
-  gboolean ret;
-  GError *error = NULL;
-  GPtrArray *profile_array = NULL;
-  GtkTreeIter iter;
+  GcmPrefsAssign *assign;
   GtkListStore *list_store;
   GtkWidget *widget;
   guint i;
@@ -782,61 +974,32 @@ gcm_prefs_add_profiles_suitable_for_devices (CcColorPanel *prefs,
                                                "label_assign_warning"));
   gtk_widget_hide (widget);
 
-  /* get profiles */
-  profile_array = cd_client_get_profiles_sync (priv->client,
-                                               priv->cancellable,
-                                               &error);
-  if (profile_array == NULL)
+  /* stop filling the list for a previous device */
+  if (priv->assign_cancellable != NULL)
     {
-      g_warning ("failed to get profiles: %s",
-           error->message);
-      g_error_free (error);
-      goto out;
+      g_cancellable_cancel (priv->assign_cancellable);
+      g_object_unref (priv->assign_cancellable);
     }
-
-  /* add profiles of the right kind */
-  for (i = 0; i < profile_array->len; i++)
+  priv->assign_cancellable = g_cancellable_new ();
+
+  assign = g_new0 (GcmPrefsAssign, 1);
+  assign->prefs = prefs;
+  assign->cancellable = g_object_ref (priv->assign_cancellable);
+  assign->device = g_object_ref (priv->current_device);
+  assign->device_profiles = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                   g_free, NULL);
+  for (i = 0; profiles != NULL && i < profiles->len; i++)
     {
-      profile_tmp = g_ptr_array_index (profile_array, i);
-
-      /* get properties */
-      ret = cd_profile_connect_sync (profile_tmp,
-                                     priv->cancellable,
-                                     &error);
-      if (!ret)
-        {
-          g_warning ("failed to get profile: %s", error->message);
-          g_error_free (error);
-          goto out;
-        }
-
-      /* don't add any of the already added profiles */
-      if (profiles != NULL)
-        {
-          if (gcm_prefs_profile_exists_in_array (profiles, profile_tmp))
-            continue;
-        }
-
-      /* only add correct types */
-      ret = gcm_prefs_is_profile_suitable_for_device (profile_tmp,
-                                                      priv->current_device);
-      if (!ret)
-        continue;
-
-#if CD_CHECK_VERSION(0,1,13)
-      /* ignore profiles from other user accounts */
-      if (!cd_profile_has_access (profile_tmp))
-        continue;
-#endif
-
-      /* add */
-      gcm_prefs_combobox_add_profile (prefs,
-                                      profile_tmp,
-                                      &iter);
+      g_hash_table_add (assign->device_profiles,
+                        g_strdup (cd_profile_get_object_path (g_ptr_array_index (profiles, i))));
     }
-out:
-  if (profile_array != NULL)
-    g_ptr_array_unref (profile_array);
+  assign->pending = 1;
+
+  /* get profiles */
+  cd_client_get_profiles (priv->client,
+                          assign->cancellable,
+                          gcm_prefs_assign_get_profiles_cb,
+                          assign);
 }
 
 static void
@@ -1519,48 +1682,135 @@ out:
     g_object_unref (profile);
 }
 
+/* Connecting to the sensors, which is started over when they change */
+typedef struct
+{
+  CcColorPanel  *prefs;
+  GCancellable  *cancellable;
+  GPtrArray     *sensors;
+  guint          pending;
+} GcmPrefsSensors;
+
 static void
-gcm_prefs_sensor_coldplug (CcColorPanel *prefs)
+gcm_prefs_sensors_free (GcmPrefsSensors *load)
 {
-  CcColorPanelPrivate *priv = prefs->priv;
+  g_object_unref (load->cancellable);
+  if (load->sensors != NULL)
+    g_ptr_array_unref (load->sensors);
+  g_free (load);
+}
+
+static void
+gcm_prefs_sensors_loaded (GcmPrefsSensors *load)
+{
+  CcColorPanelPrivate *priv = load->prefs->priv;
   CdSensor *sensor_tmp;
-  gboolean ret;
-  GError *error = NULL;
-  GPtrArray *sensors;
   guint i;
 
-  /* unref old */
+  /* save a copy of the sensors we could connect to, in order */
   g_clear_pointer (&priv->sensors, g_ptr_array_unref);
-
-  /* no present */
-  sensors = cd_client_get_sensors_sync (priv->client, NULL, &error);
-  if (sensors == NULL)
+  if (load->sensors != NULL)
     {
-      g_warning ("%s", error->message);
-      g_error_free (error);
-      goto out;
+      for (i = 0; i < load->sensors->len; i++)
+        {
+          sensor_tmp = g_ptr_array_index (load->sensors, i);
+          if (!cd_sensor_get_connected (sensor_tmp))
+            continue;
+          if (priv->sensors == NULL)
+            priv->sensors = g_ptr_array_new_with_free_func (g_object_unref);
+          g_ptr_array_add (priv->sensors, g_object_ref (sensor_tmp));
+        }
     }
-  if (sensors->len == 0)
-    goto out;
 
-  /* save a copy of the sensor list */
-  priv->sensors = g_ptr_array_ref (sensors);
+  gcm_prefs_set_calibrate_button_sensitivity (load->prefs);
+  gcm_prefs_sensors_free (load);
+}
 
-  /* connect to each sensor */
-  for (i = 0; i < sensors->len; i++)
+static void
+gcm_prefs_sensor_connect_cb (GObject *object,
+                             GAsyncResult *res,
+                             gpointer user_data)
+{
+  GcmPrefsSensors *load = user_data;
+  GError *error = NULL;
+
+  if (!cd_sensor_connect_finish (CD_SENSOR (object), res, &error) &&
+      !g_cancellable_is_cancelled (load->cancellable))
+    g_warning ("%s", error->message);
+  g_clear_error (&error);
+
+  if (--load->pending > 0)
+    return;
+
+  if (g_cancellable_is_cancelled (load->cancellable))
+    gcm_prefs_sensors_free (load);
+  else
+    gcm_prefs_sensors_loaded (load);
+}
+
+static void
+gcm_prefs_get_sensors_cb (GObject *object,
+                          GAsyncResult *res,
+                          gpointer user_data)
+{
+  GcmPrefsSensors *load = user_data;
+  CdSensor *sensor_tmp;
+  GError *error = NULL;
+  guint i;
+
+  load->sensors = cd_client_get_sensors_finish (CD_CLIENT (object), res, &error);
+  if (g_cancellable_is_cancelled (load->cancellable))
     {
-      sensor_tmp = g_ptr_array_index (sensors, i);
-      ret = cd_sensor_connect_sync (sensor_tmp, NULL, &error);
-      if (!ret)
+      g_clear_error (&error);
+      gcm_prefs_sensors_free (load);
+      return;
+    }
+
+  /* no present */
+  if (load->sensors == NULL || load->sensors->len == 0)
+    {
+      if (load->sensors == NULL)
         {
           g_warning ("%s", error->message);
           g_error_free (error);
-          goto out;
         }
+      gcm_prefs_sensors_loaded (load);
+      return;
     }
-out:
-  if (sensors != NULL)
-    g_ptr_array_unref (sensors);
+
+  /* connect to each sensor at once */
+  load->pending = load->sensors->len;
+  for (i = 0; i < load->sensors->len; i++)
+    {
+      sensor_tmp = g_ptr_array_index (load->sensors, i);
+      cd_sensor_connect (sensor_tmp,
+                         load->cancellable,
+                         gcm_prefs_sensor_connect_cb,
+                         load);
+    }
+}
+
+static void
+gcm_prefs_sensor_coldplug (CcColorPanel *prefs)
+{
+  CcColorPanelPrivate *priv = prefs->priv;
+  GcmPrefsSensors *load;
+
+  /* forget about any previous coldplug */
+  if (priv->sensors_cancellable != NULL)
+    {
+      g_cancellable_cancel (priv->sensors_cancellable);
+      g_object_unref (priv->sensors_cancellable);
+    }
+  priv->sensors_cancellable = g_cancellable_new ();
+
+  load = g_new0 (GcmPrefsSensors, 1);
+  load->prefs = prefs;
+  load->cancellable = g_object_ref (priv->sensors_cancellable);
+  cd_client_get_sensors (priv->client,
+                         load->cancellable,
+                         gcm_prefs_get_sensors_cb,
+                         load);
 }
 
 static void
@@ -1568,32 +1818,40 @@ gcm_prefs_client_sensor_changed_cb (CdClient *client,
                                     CdSensor *sensor,
                                     CcColorPanel *prefs)
 {
+  /* this sets the calibrate button sensitivity when done */
   gcm_prefs_sensor_coldplug (prefs);
-  gcm_prefs_set_calibrate_button_sensitivity (prefs);
 }
 
 static void
-gcm_prefs_add_device_profile (CcColorPanel *prefs,
-                              CdDevice *device,
-                              CdProfile *profile,
-                              gboolean is_default)
+gcm_prefs_device_profile_connect_cb (GObject *object,
+                                     GAsyncResult *res,
+                                     gpointer user_data)
 {
-  CcColorPanelPrivate *priv = prefs->priv;
-  gboolean ret;
+  GcmPrefsLoad *load = user_data;
+  CcColorPanelPrivate *priv;
+  GcmPrefsDeviceRows *rows;
+  CdProfile *profile;
   GError *error = NULL;
   GtkWidget *widget;
 
-  /* get properties */
-  ret = cd_profile_connect_sync (profile,
-                                 priv->cancellable,
-                                 &error);
-  if (!ret)
+  profile = cc_color_profile_connect_cached_finish (res, &error);
+  if (g_cancellable_is_cancelled (load->cancellable))
+    goto out;
+  priv = load->prefs->priv;
+  if (profile == NULL)
     {
       g_warning ("failed to get profile: %s", error->message);
-      g_error_free (error);
       goto out;
     }
 
+  /* the device or profile may have gone while connecting */
+  rows = gcm_prefs_lookup_device_rows (load->prefs, load->device);
+  if (rows == NULL ||
+      !g_hash_table_lookup_extended (rows->profile_rows, load->profile_path,
+                                     NULL, (gpointer *) &widget) ||
+      widget != NULL)
+    goto out;
+
   /* ignore profiles from other user accounts */
   if (!cd_profile_has_access (profile))
     {
@@ -1612,12 +1870,42 @@ gcm_prefs_add_device_profile (CcColorPanel *prefs,
     }
 
   /* add to listbox */
-  widget = cc_color_profile_new (device, profile, is_default);
+  widget = cc_color_profile_new (load->device, profile, load->is_default);
+  g_hash_table_insert (rows->profile_rows, g_strdup (load->profile_path), widget);
   gtk_widget_show (widget);
   gtk_container_add (GTK_CONTAINER (priv->list_box), widget);
   gtk_size_group_add_widget (priv->list_box_size, widget);
+  gtk_list_box_invalidate_sort (priv->list_box);
 out:
-  return;
+  g_clear_error (&error);
+  g_clear_object (&profile);
+  gcm_prefs_load_free (load);
+}
+
+static void
+gcm_prefs_add_device_profile (CcColorPanel *prefs,
+                              CdDevice *device,
+                              CdProfile *profile,
+                              gboolean is_default)
+{
+  CcColorPanelPrivate *priv = prefs->priv;
+  GcmPrefsDeviceRows *rows;
+  GcmPrefsLoad *load;
+
+  rows = gcm_prefs_lookup_device_rows (prefs, device);
+  g_return_if_fail (rows != NULL);
+
+  /* get properties, the row is added when they arrive */
+  load = gcm_prefs_load_new (prefs, device);
+  load->profile_path = g_strdup (cd_profile_get_object_path (profile));
+  load->is_default = is_default;
+  g_hash_table_insert (rows->profile_rows, g_strdup (load->profile_path), NULL);
+
+  cc_color_profile_connect_cached (priv->client,
+                                   profile,
+                                   load->cancellable,
+                                   gcm_prefs_device_profile_connect_cb,
+                                   load);
 }
 
 static void
@@ -1641,108 +1929,58 @@ out:
     g_ptr_array_unref (profiles);
 }
 
-/* find the profile in the array -- for flicker-free changes */
-static gboolean
-gcm_prefs_find_profile_by_object_path (GPtrArray *profiles,
-                                       const gchar *object_path)
-{
-  CdProfile *profile_tmp;
-  guint i;
-
-  for (i = 0; i < profiles->len; i++)
-    {
-      profile_tmp = g_ptr_array_index (profiles, i);
-      if (g_strcmp0 (cd_profile_get_object_path (profile_tmp), object_path) == 0)
-        return TRUE;
-    }
-  return FALSE;
-}
-
-/* find the profile in the list view -- for flicker-free changes */
-static gboolean
-gcm_prefs_find_widget_by_object_path (GList *list,
-                                      const gchar *object_path_device,
-                                      const gchar *object_path_profile)
-{
-  GList *l;
-  CdDevice *device_tmp;
-  CdProfile *profile_tmp;
-
-  for (l = list; l != NULL; l = l->next)
-    {
-      if (!CC_IS_COLOR_PROFILE (l->data))
-        continue;
-
-      /* correct device ? */
-      device_tmp = cc_color_profile_get_device (CC_COLOR_PROFILE (l->data));
-      if (g_strcmp0 (object_path_device,
-                     cd_device_get_object_path (device_tmp)) != 0)
-        {
-          continue;
-        }
-
-      /* this profile */
-      profile_tmp = cc_color_profile_get_profile (CC_COLOR_PROFILE (l->data));
-      if (g_strcmp0 (object_path_profile,
-                     cd_profile_get_object_path (profile_tmp)) == 0)
-        {
-          return TRUE;
-        }
-    }
-  return FALSE;
-}
-
 static void
 gcm_prefs_device_changed_cb (CdDevice *device, CcColorPanel *prefs)
 {
   CcColorPanelPrivate *priv = prefs->priv;
-  CdDevice *device_tmp;
+  GcmPrefsDeviceRows *rows;
   CdProfile *profile_tmp;
-  gboolean ret;
-  GList *l;
-  GList *list;
+  GHashTable *profile_paths;
+  GHashTableIter iter;
   GPtrArray *profiles;
+  gpointer key, row;
   guint i;
 
-  /* remove anything in the list view that's not in Device.Profiles */
+  rows = gcm_prefs_lookup_device_rows (prefs, device);
   profiles = cd_device_get_profiles (device);
-  list = gtk_container_get_children (GTK_CONTAINER (priv->list_box));
-  for (l = list; l != NULL; l = l->next)
+  if (rows == NULL || profiles == NULL)
+    goto out;
+
+  profile_paths = g_hash_table_new (g_str_hash, g_str_equal);
+  for (i = 0; i < profiles->len; i++)
     {
-      if (!CC_IS_COLOR_PROFILE (l->data))
-        continue;
+      profile_tmp = g_ptr_array_index (profiles, i);
+      g_hash_table_add (profile_paths, (gpointer) cd_profile_get_object_path (profile_tmp));
+    }
 
-      /* correct device ? */
-      device_tmp = cc_color_profile_get_device (CC_COLOR_PROFILE (l->data));
-      if (g_strcmp0 (cd_device_get_id (device),
-                     cd_device_get_id (device_tmp)) != 0)
+  /* remove anything in the list view that's not in Device.Profiles,
+   * including profiles still on their way there */
+  g_hash_table_iter_init (&iter, rows->profile_rows);
+  while (g_hash_table_iter_next (&iter, &key, &row))
+    {
+      if (g_hash_table_contains (profile_paths, key))
         continue;
-
-      /* if profile is not in Device.Profiles then remove */
-      profile_tmp = cc_color_profile_get_profile (CC_COLOR_PROFILE (l->data));
-      ret = gcm_prefs_find_profile_by_object_path (profiles,
-                                                   cd_profile_get_object_path (profile_tmp));
-      if (!ret) {
-        gtk_widget_destroy (GTK_WIDGET (l->data));
-        /* Don't look at the destroyed widget below */
-        l->data = NULL;
-      }
+      if (row != NULL)
+        gtk_widget_destroy (GTK_WIDGET (row));
+      g_hash_table_iter_remove (&iter);
     }
 
-  /* add anything in Device.Profiles that's not in the list view */
+  /* add anything in Device.Profiles that's not in the list view,
+   * or on its way there */
   for (i = 0; i < profiles->len; i++)
     {
       profile_tmp = g_ptr_array_index (profiles, i);
-      ret = gcm_prefs_find_widget_by_object_path (list,
-                                                  cd_device_get_object_path (device),
-                                                  cd_profile_get_object_path (profile_tmp));
-      if (!ret)
+      if (!g_hash_table_contains (rows->profile_rows,
+                                  cd_profile_get_object_path (profile_tmp)))
         gcm_prefs_add_device_profile (prefs, device, profile_tmp, i == 0);
     }
-  g_list_free (list);
+  g_hash_table_destroy (profile_paths);
 
   /* resort */
   gtk_list_box_invalidate_sort (priv->list_box);
+out:
+  if (profiles != NULL)
+    g_ptr_array_unref (profiles);
 }
 
 static void
@@ -1751,8 +1989,8 @@ gcm_prefs_device_expanded_changed_cb (CcColorDevice *widget,
                                       CcColorPanel *prefs)
 {
   CcColorPanelPrivate *priv = prefs->priv;
-  GList *l;
-  GList *list;
+  GcmPrefsDeviceRows *rows;
+  GHashTableIter iter;
 
   /* ignore internal changes */
   if (prefs->priv->model_is_changing)
@@ -1764,17 +2002,14 @@ gcm_prefs_device_expanded_changed_cb (CcColorDevice *widget,
       priv->list_box_filter = g_strdup (cd_device_get_id (cc_color_device_get_device (widget)));
 
       /* unexpand other device widgets */
-      list = gtk_container_get_children (GTK_CONTAINER (priv->list_box));
       prefs->priv->model_is_changing = TRUE;
-      for (l = list; l != NULL; l = l->next)
+      g_hash_table_iter_init (&iter, priv->device_rows);
+      while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &rows))
         {
-          if (!CC_IS_COLOR_DEVICE (l->data))
-            continue;
-          if (l->data != widget)
-            cc_color_device_set_expanded (CC_COLOR_DEVICE (l->data), FALSE);
+          if (rows->row != NULL && rows->row != GTK_WIDGET (widget))
+            cc_color_device_set_expanded (CC_COLOR_DEVICE (rows->row), FALSE);
         }
       prefs->priv->model_is_changing = FALSE;
-      g_list_free (list);
     }
   else
     {
@@ -1784,24 +2019,37 @@ gcm_prefs_device_expanded_changed_cb (CcColorDevice *widget,
 }
 
 static void
-gcm_prefs_add_device (CcColorPanel *prefs, CdDevice *device)
+gcm_prefs_device_connect_cb (GObject *object,
+                             GAsyncResult *res,
+                             gpointer user_data)
 {
-  CcColorPanelPrivate *priv = prefs->priv;
+  GcmPrefsLoad *load = user_data;
+  CcColorPanel *prefs = load->prefs;
+  CcColorPanelPrivate *priv;
+  GcmPrefsDeviceRows *rows;
+  CdDevice *device = CD_DEVICE (object);
   gboolean ret;
   GError *error = NULL;
   GtkWidget *widget;
 
-  /* get device properties */
-  ret = cd_device_connect_sync (device, priv->cancellable, &error);
+  ret = cd_device_connect_finish (device, res, &error);
+  if (g_cancellable_is_cancelled (load->cancellable))
+    goto out;
+  priv = prefs->priv;
   if (!ret)
     {
       g_warning ("failed to connect to the device: %s", error->message);
-      g_error_free (error);
       goto out;
     }
 
+  /* removed while connecting */
+  rows = gcm_prefs_lookup_device_rows (prefs, device);
+  if (rows == NULL)
+    goto out;
+
   /* add device */
   widget = cc_color_device_new (device);
+  rows->row = widget;
   g_signal_connect (widget, "expanded-changed",
                     G_CALLBACK (gcm_prefs_device_expanded_changed_cb), prefs);
   gtk_widget_show (widget);
@@ -1812,40 +2060,62 @@ gcm_prefs_add_device (CcColorPanel *prefs, CdDevice *device)
   gcm_prefs_add_device_profiles (prefs, device);
 
   /* watch for changes */
-  g_ptr_array_add (priv->devices, g_object_ref (device));
-  g_signal_connect (device, "changed",
-                    G_CALLBACK (gcm_prefs_device_changed_cb), prefs);
+  rows->changed_id = g_signal_connect (device, "changed",
+                                       G_CALLBACK (gcm_prefs_device_changed_cb), prefs);
   gtk_list_box_invalidate_sort (priv->list_box);
 out:
-  return;
+  g_clear_error (&error);
+  gcm_prefs_load_free (load);
+}
+
+static void
+gcm_prefs_add_device (CcColorPanel *prefs, CdDevice *device)
+{
+  CcColorPanelPrivate *priv = prefs->priv;
+  GcmPrefsLoad *load;
+
+  if (g_hash_table_contains (priv->device_rows, cd_device_get_object_path (device)))
+    {
+      g_debug ("%s is already added", cd_device_get_object_path (device));
+      return;
+    }
+
+  /* get device properties, all the devices are connected to at once */
+  g_hash_table_insert (priv->device_rows,
+                       g_strdup (cd_device_get_object_path (device)),
+                       gcm_prefs_device_rows_new (device));
+  load = gcm_prefs_load_new (prefs, device);
+  cd_device_connect (device,
+                     load->cancellable,
+                     gcm_prefs_device_connect_cb,
+                     load);
 }
 
 static void
 gcm_prefs_remove_device (CcColorPanel *prefs, CdDevice *device)
 {
   CcColorPanelPrivate *priv = prefs->priv;
-  CdDevice *device_tmp;
-  GList *l;
-  GList *list;
+  GcmPrefsDeviceRows *rows;
+  GHashTableIter iter;
+  gpointer row;
+
+  rows = g_hash_table_lookup (priv->device_rows,
+                              cd_device_get_object_path (device));
+  if (rows == NULL)
+    return;
 
-  list = gtk_container_get_children (GTK_CONTAINER (priv->list_box));
-  for (l = list; l != NULL; l = l->next)
+  g_hash_table_iter_init (&iter, rows->profile_rows);
+  while (g_hash_table_iter_next (&iter, NULL, &row))
     {
-      if (CC_IS_COLOR_DEVICE (l->data))
-        device_tmp = cc_color_device_get_device (CC_COLOR_DEVICE (l->data));
-      else
-        device_tmp = cc_color_profile_get_device (CC_COLOR_PROFILE (l->data));
-      if (g_strcmp0 (cd_device_get_object_path (device),
-                     cd_device_get_object_path (device_tmp)) == 0)
-        {
-          gtk_widget_destroy (GTK_WIDGET (l->data));
-        }
+      if (row != NULL)
+        gtk_widget_destroy (GTK_WIDGET (row));
     }
-  g_list_free (list);
-  g_signal_handlers_disconnect_by_func (device,
-                                        G_CALLBACK (gcm_prefs_device_changed_cb),
-                                        prefs);
-  g_ptr_array_remove (priv->devices, device);
+  if (rows->row != NULL)
+    gtk_widget_destroy (rows->row);
+
+  /* this also stops watching the device */
+  g_hash_table_remove (priv->device_rows,
+                       cd_device_get_object_path (device));
 }
 
 static void
@@ -1877,11 +2147,9 @@ gcm_prefs_device_added_cb (CdClient *client,
                            CdDevice *device,
                            CcColorPanel *prefs)
 {
-  /* add the device */
+  /* add the device, which also ensures we're not showing the
+   * 'No devices detected' entry once it is connected */
   gcm_prefs_add_device (prefs, device);
-
-  /* ensure we're not showing the 'No devices detected' entry */
-  gcm_prefs_update_device_list_extra_entry (prefs);
 }
 
 static void
@@ -1923,8 +2191,10 @@ gcm_prefs_get_devices_cb (GObject *object,
       gcm_prefs_add_device (prefs, device);
     }
 
-  /* ensure we show the 'No devices detected' entry if empty */
-  gcm_prefs_update_device_list_extra_entry (prefs);
+  /* ensure we show the 'No devices detected' entry if empty,
+   * otherwise that happens when the devices are connected */
+  if (prefs->priv->n_loading == 0)
+    gcm_prefs_update_device_list_extra_entry (prefs);
 out:
   if (devices != NULL)
     g_ptr_array_unref (devices);
@@ -2118,8 +2388,6 @@ static void
 cc_color_panel_dispose (GObject *object)
 {
   CcColorPanelPrivate *priv = CC_COLOR_PANEL (object)->priv;
-  CdDevice *device;
-  guint i;
 
   /* stop the EggListView from firing when it gets disposed */
   if (priv->list_box_selected_id != 0)
@@ -2135,21 +2403,16 @@ cc_color_panel_dispose (GObject *object)
     }
 
   /* stop the devices from emitting after the ListBox has been disposed */
-  if (priv->devices != NULL)
-    {
-      for (i = 0; i < priv->devices->len; i++)
-        {
-          device = g_ptr_array_index (priv->devices, i);
-          g_signal_handlers_disconnect_by_func (device,
-                                                G_CALLBACK (gcm_prefs_device_changed_cb),
-                                                CC_COLOR_PANEL (object));
-        }
-      g_ptr_array_unref (priv->devices);
-      priv->devices = NULL;
-    }
+  g_clear_pointer (&priv->device_rows, g_hash_table_destroy);
 
   if (priv->cancellable != NULL)
     g_cancellable_cancel (priv->cancellable);
+  if (priv->sensors_cancellable != NULL)
+    g_cancellable_cancel (priv->sensors_cancellable);
+  if (priv->assign_cancellable != NULL)
+    g_cancellable_cancel (priv->assign_cancellable);
+  g_clear_object (&priv->sensors_cancellable);
+  g_clear_object (&priv->assign_cancellable);
   g_clear_object (&priv->settings);
   g_clear_object (&priv->settings_colord);
   g_clear_object (&priv->cancellable);
@@ -2272,7 +2535,8 @@ cc_color_panel_init (CcColorPanel *prefs)
     }
 
   priv->cancellable = g_cancellable_new ();
-  priv->devices = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+  priv->device_rows = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                             (GDestroyNotify) gcm_prefs_device_rows_free);
 
   /* can do native display calibration using colord-session */
   priv->calibrate = cc_color_calibrate_new ();
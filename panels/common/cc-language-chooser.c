@@ -31,11 +31,9 @@
 
 #include "shell/list-box-helper.h"
 #include "cc-common-language.h"
+#include "cc-locale-catalog.h"
 #include "cc-util.h"
 
-#define GNOME_DESKTOP_USE_UNSTABLE_API
-#include <libgnome-desktop/gnome-languages.h>
-
 typedef struct {
         GtkWidget *done_button;
         GtkWidget *no_results;
@@ -45,7 +43,7 @@ typedef struct {
         GtkWidget *scrolledwindow;
         gboolean showing_extra;
         gchar *language;
-        gchar **filter_words;
+        CcSearchMatcher *matcher;
 } CcLanguageChooserPrivate;
 
 #define GET_PRIVATE(chooser) ((CcLanguageChooserPrivate *) g_object_get_data (G_OBJECT (chooser), "private"))
@@ -67,23 +65,16 @@ padded_label_new (char *text, gboolean narrow)
 }
 
 static GtkWidget *
-language_widget_new (const gchar *locale_id,
-                     const gchar *current_locale_id,
-                     gboolean     is_extra)
+language_widget_new (const CcLocaleInfo *info,
+                     const gchar        *current_locale_id,
+                     gboolean            is_extra)
 {
-        gchar *locale_name;
-        gchar *locale_current_name;
-        gchar *locale_untranslated_name;
         GtkWidget *row;
         GtkWidget *check;
         GtkWidget *box;
 
-        locale_name = gnome_get_language_from_locale (locale_id, locale_id);
-        locale_current_name = gnome_get_language_from_locale (locale_id, NULL);
-        locale_untranslated_name = gnome_get_language_from_locale (locale_id, "C");
-
         row = gtk_list_box_row_new ();
-        box = padded_label_new (locale_name, is_extra);
+        box = padded_label_new (info->language_names[CC_LOCALE_NAME_NATIVE], is_extra);
         gtk_container_add (GTK_CONTAINER (row), box);
 
         /* We add a check on each side of the label to keep it centered. */
@@ -99,14 +90,16 @@ language_widget_new (const gchar *locale_id,
         gtk_widget_set_opacity (check, 0.0);
         g_object_set (check, "icon-size", GTK_ICON_SIZE_MENU, NULL);
         gtk_box_pack_start (GTK_BOX (box), check, FALSE, FALSE, 0);
-        if (g_strcmp0 (locale_id, current_locale_id) == 0)
+        if (g_strcmp0 (info->id, current_locale_id) == 0)
                 gtk_widget_set_opacity (check, 1.0);
 
+        /* The catalog's strings live as long as the session */
         g_object_set_data (G_OBJECT (row), "check", check);
-        g_object_set_data_full (G_OBJECT (row), "locale-id", g_strdup (locale_id), g_free);
-        g_object_set_data_full (G_OBJECT (row), "locale-name", locale_name, g_free);
-        g_object_set_data_full (G_OBJECT (row), "locale-current-name", locale_current_name, g_free);
-        g_object_set_data_full (G_OBJECT (row), "locale-untranslated-name", locale_untranslated_name, g_free);
+        g_object_set_data (G_OBJECT (row), "locale-id", info->id);
+        g_object_set_data (G_OBJECT (row), "locale-name", info->language_names[CC_LOCALE_NAME_NATIVE]);
+        g_object_set_data (G_OBJECT (row), "locale-current-name", info->language_names[CC_LOCALE_NAME_CURRENT]);
+        g_object_set_data (G_OBJECT (row), "locale-untranslated-name", info->language_names[CC_LOCALE_NAME_UNTRANSLATED]);
+        g_object_set_data (G_OBJECT (row), "locale-keys", info->language_keys);
         g_object_set_data (G_OBJECT (row), "is-extra", GUINT_TO_POINTER (is_extra));
 
         return row;
@@ -144,24 +137,22 @@ no_results_widget_new (void)
 
 static void
 add_languages (GtkDialog   *chooser,
-               gchar      **locale_ids,
+               GPtrArray   *locales,
                GHashTable  *initial)
 {
         CcLanguageChooserPrivate *priv = GET_PRIVATE (chooser);
+        guint i;
 
-        while (*locale_ids) {
-                gchar *locale_id;
+        for (i = 0; i < locales->len; i++) {
+                const CcLocaleInfo *info = locales->pdata[i];
                 gboolean is_initial;
                 GtkWidget *widget;
 
-                locale_id = *locale_ids;
-                locale_ids ++;
-
-                if (!cc_common_language_has_font (locale_id))
+                if (!info->has_font)
                         continue;
 
-                is_initial = (g_hash_table_lookup (initial, locale_id) != NULL);
-                widget = language_widget_new (locale_id, priv->language, !is_initial);
+                is_initial = (g_hash_table_lookup (initial, info->id) != NULL);
+                widget = language_widget_new (info, priv->language, !is_initial);
                 gtk_container_add (GTK_CONTAINER (priv->language_list), widget);
         }
 
@@ -173,27 +164,16 @@ add_languages (GtkDialog   *chooser,
 static void
 add_all_languages (GtkDialog *chooser)
 {
-        gchar **locale_ids;
         GHashTable *initial;
+        GPtrArray *locales;
+
+        /* Callers wait for the catalog with cc_locale_catalog_wait_ready() */
+        locales = cc_locale_catalog_get ();
+        g_return_if_fail (locales != NULL);
 
-        locale_ids = gnome_get_all_locales ();
         initial = cc_common_language_get_initial_languages ();
-        add_languages (chooser, locale_ids, initial);
+        add_languages (chooser, locales, initial);
         g_hash_table_destroy (initial);
-        g_strfreev (locale_ids);
-}
-
-static gboolean
-match_all (gchar       **words,
-           const gchar  *str)
-{
-        gchar **w;
-
-        for (w = words; *w; ++w)
-                if (!strstr (str, *w))
-                        return FALSE;
-
-        return TRUE;
 }
 
 static gboolean
@@ -202,11 +182,8 @@ language_visible (GtkListBoxRow *row,
 {
         GtkDialog *chooser = user_data;
         CcLanguageChooserPrivate *priv = GET_PRIVATE (chooser);
-        gchar *locale_name = NULL;
-        gchar *locale_current_name = NULL;
-        gchar *locale_untranslated_name = NULL;
+        const gchar * const *keys;
         gboolean is_extra;
-        gboolean visible;
 
         if (row == priv->more_item)
                 return !priv->showing_extra;
@@ -216,32 +193,10 @@ language_visible (GtkListBoxRow *row,
         if (!priv->showing_extra && is_extra)
                 return FALSE;
 
-        if (!priv->filter_words)
-                return TRUE;
-
-        visible = FALSE;
-
-        locale_name =
-                cc_util_normalize_casefold_and_unaccent (g_object_get_data (G_OBJECT (row), "locale-name"));
-        visible = match_all (priv->filter_words, locale_name);
-        if (visible)
-                goto out;
-
-        locale_current_name =
-                cc_util_normalize_casefold_and_unaccent (g_object_get_data (G_OBJECT (row), "locale-current-name"));
-        visible = match_all (priv->filter_words, locale_current_name);
-        if (visible)
-                goto out;
+        /* The keys are normalized already, once for all rows */
+        keys = g_object_get_data (G_OBJECT (row), "locale-keys");
 
-        locale_untranslated_name =
-                cc_util_normalize_casefold_and_unaccent (g_object_get_data (G_OBJECT (row), "locale-untranslated-name"));
-        visible = match_all (priv->filter_words, locale_untranslated_name);
-
-out:
-        g_free (locale_untranslated_name);
-        g_free (locale_current_name);
-        g_free (locale_name);
-        return visible;
+        return cc_search_matcher_match (priv->matcher, row, keys, CC_LOCALE_N_NAMES);
 }
 
 static gint
@@ -267,20 +222,13 @@ static void
 filter_changed (GtkDialog *chooser)
 {
         CcLanguageChooserPrivate *priv = GET_PRIVATE (chooser);
-        gchar *filter_contents = NULL;
-
-        g_clear_pointer (&priv->filter_words, g_strfreev);
 
-        filter_contents =
-                cc_util_normalize_casefold_and_unaccent (gtk_entry_get_text (GTK_ENTRY (priv->filter_entry)));
-        if (!filter_contents) {
-                gtk_list_box_invalidate_filter (GTK_LIST_BOX (priv->language_list));
+        cc_search_matcher_set_query (priv->matcher,
+                                     gtk_entry_get_text (GTK_ENTRY (priv->filter_entry)));
+        if (cc_search_matcher_is_empty (priv->matcher))
                 gtk_list_box_set_placeholder (GTK_LIST_BOX (priv->language_list), NULL);
-                return;
-        }
-        priv->filter_words = g_strsplit_set (g_strstrip (filter_contents), " ", 0);
-        g_free (filter_contents);
-        gtk_list_box_set_placeholder (GTK_LIST_BOX (priv->language_list), priv->no_results);
+        else
+                gtk_list_box_set_placeholder (GTK_LIST_BOX (priv->language_list), priv->no_results);
         gtk_list_box_invalidate_filter (GTK_LIST_BOX (priv->language_list));
 }
 
@@ -394,7 +342,7 @@ cc_language_chooser_private_free (gpointer data)
         CcLanguageChooserPrivate *priv = data;
 
         g_clear_object (&priv->no_results);
-        g_strfreev (priv->filter_words);
+        cc_search_matcher_free (priv->matcher);
         g_free (priv->language);
         g_free (priv);
 }
@@ -421,6 +369,7 @@ cc_language_chooser_new (GtkWidget *parent)
 
         chooser = WID ("language-dialog");
         priv = g_new0 (CcLanguageChooserPrivate, 1);
+        priv->matcher = cc_search_matcher_new ();
         g_object_set_data_full (G_OBJECT (chooser), "private", priv, cc_language_chooser_private_free);
         g_object_set_data_full (G_OBJECT (chooser), "builder", builder, g_object_unref);
 
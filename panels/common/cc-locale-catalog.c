@@ -0,0 +1,599 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2013 Red Hat, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include <fontconfig/fontconfig.h>
+
+#define GNOME_DESKTOP_USE_UNSTABLE_API
+#include <libgnome-desktop/gnome-languages.h>
+
+#include "cc-locale-catalog.h"
+#include "cc-util.h"
+
+/* The catalog is cached as: format version, the session's languages
+ * (which the current names are translated to), a checksum of the
+ * installed locales, a stamp of the font directories, and the
+ * entries themselves, sorted by locale id. */
+#define CATALOG_CACHE_VERSION 1
+#define CATALOG_ENTRY_TYPE "(ssms(msmsms)(msmsms)(msmsms)(msmsms)b)"
+#define CATALOG_CACHE_FORMAT "(ussta" CATALOG_ENTRY_TYPE ")"
+#define CATALOG_ENTRY_FORMAT "(ssms@(msmsms)@(msmsms)@(msmsms)@(msmsms)b)"
+
+/* Number of locales whose names are looked up per main loop iteration */
+#define NAMES_PER_BATCH 25
+
+G_STATIC_ASSERT (CC_LOCALE_N_NAMES == 3);
+
+typedef struct {
+        gchar     **locale_ids;
+        gchar      *languages;
+        gchar      *locales_checksum;
+        guint64     fonts_stamp;
+        FcLangSet  *langs;
+        GPtrArray  *infos;
+        guint       next;
+} BuildData;
+
+static GPtrArray *catalog;
+static GHashTable *catalog_by_id;
+static BuildData *building;
+static GList *waiters;
+
+static void
+build_data_free (BuildData *data)
+{
+        g_strfreev (data->locale_ids);
+        g_free (data->languages);
+        g_free (data->locales_checksum);
+        if (data->langs != NULL)
+                FcLangSetDestroy (data->langs);
+        if (data->infos != NULL)
+                g_ptr_array_unref (data->infos);
+        g_free (data);
+}
+
+static gint
+compare_locale_ids (gconstpointer a,
+                    gconstpointer b)
+{
+        return strcmp (*(const gchar **) a, *(const gchar **) b);
+}
+
+static gint
+compare_locale_infos (gconstpointer a,
+                      gconstpointer b)
+{
+        const CcLocaleInfo *ia = *(const CcLocaleInfo **) a;
+        const CcLocaleInfo *ib = *(const CcLocaleInfo **) b;
+
+        return strcmp (ia->id, ib->id);
+}
+
+static gchar *
+get_cache_file (void)
+{
+        return g_build_filename (g_get_user_cache_dir (),
+                                 "gnome-control-center",
+                                 "locales.cache",
+                                 NULL);
+}
+
+/* Installing or removing fonts touches their directories */
+static guint64
+get_fonts_stamp (void)
+{
+        FcStrList *dirs;
+        FcChar8 *dir;
+        guint64 stamp = 0;
+
+        dirs = FcConfigGetFontDirs (NULL);
+        if (dirs == NULL)
+                return 0;
+
+        while ((dir = FcStrListNext (dirs)) != NULL) {
+                GStatBuf buf;
+
+                if (g_stat ((const gchar *) dir, &buf) == 0)
+                        stamp = stamp * 31 + (guint64) buf.st_mtime;
+                else
+                        stamp = stamp * 31;
+        }
+        FcStrListDone (dirs);
+
+        return stamp;
+}
+
+/* One query for the languages that any font covers, instead of
+ * one FcFontList() per locale as in cc_common_language_has_font() */
+static FcLangSet *
+get_covered_languages (void)
+{
+        FcPattern *pattern;
+        FcObjectSet *object_set;
+        FcFontSet *font_set;
+        FcLangSet *langs;
+        int i;
+
+        langs = FcLangSetCreate ();
+
+        pattern = FcPatternCreate ();
+        object_set = FcObjectSetBuild (FC_LANG, NULL);
+        font_set = FcFontList (NULL, pattern, object_set);
+
+        for (i = 0; font_set != NULL && i < font_set->nfont; i++) {
+                FcLangSet *font_langs, *all_langs;
+
+                if (FcPatternGetLangSet (font_set->fonts[i], FC_LANG, 0, &font_langs) != FcResultMatch)
+                        continue;
+
+                all_langs = FcLangSetUnion (langs, font_langs);
+                FcLangSetDestroy (langs);
+                langs = all_langs;
+        }
+
+        if (font_set != NULL)
+                FcFontSetDestroy (font_set);
+        FcObjectSetDestroy (object_set);
+        FcPatternDestroy (pattern);
+
+        return langs;
+}
+
+static gboolean
+language_has_font (FcLangSet   *langs,
+                   const gchar *language_code)
+{
+        /* fontconfig does not know about this language */
+        if (FcLangGetCharSet ((FcChar8 *) language_code) == NULL)
+                return TRUE;
+
+        return FcLangSetHasLang (langs, (FcChar8 *) language_code) != FcLangDifferentLang;
+}
+
+static void
+locale_info_free (CcLocaleInfo *info)
+{
+        gint i;
+
+        for (i = 0; i < CC_LOCALE_N_NAMES; i++) {
+                g_free (info->language_names[i]);
+                g_free (info->language_keys[i]);
+                g_free (info->country_names[i]);
+                g_free (info->country_keys[i]);
+        }
+        g_free (info->id);
+        g_free (info->language_code);
+        g_free (info->country_code);
+        g_free (info);
+}
+
+/* gnome-languages translates the names by switching LC_MESSAGES for
+ * the whole process, so this must only ever run on the main thread */
+static CcLocaleInfo *
+locale_info_new (const gchar *locale_id)
+{
+        CcLocaleInfo *info;
+        const gchar *translations[CC_LOCALE_N_NAMES];
+        gint i;
+
+        info = g_new0 (CcLocaleInfo, 1);
+        if (!gnome_parse_locale (locale_id, &info->language_code, &info->country_code, NULL, NULL)) {
+                locale_info_free (info);
+                return NULL;
+        }
+
+        info->id = g_strdup (locale_id);
+
+        translations[CC_LOCALE_NAME_NATIVE] = locale_id;
+        translations[CC_LOCALE_NAME_CURRENT] = NULL;
+        translations[CC_LOCALE_NAME_UNTRANSLATED] = "C";
+
+        for (i = 0; i < CC_LOCALE_N_NAMES; i++) {
+                info->language_names[i] = gnome_get_language_from_locale (locale_id, translations[i]);
+
+                if (info->country_code == NULL)
+                        continue;
+
+                info->country_names[i] = gnome_get_country_from_locale (locale_id, translations[i]);
+        }
+
+        return info;
+}
+
+/* The rest only needs fontconfig and GLib, and runs in the thread */
+static void
+locale_info_finish (CcLocaleInfo *info,
+                    FcLangSet    *langs)
+{
+        gint i;
+
+        info->has_font = language_has_font (langs, info->language_code);
+
+        for (i = 0; i < CC_LOCALE_N_NAMES; i++) {
+                info->language_keys[i] = cc_util_normalize_casefold_and_unaccent (info->language_names[i]);
+
+                if (info->country_code == NULL)
+                        continue;
+
+                info->country_keys[i] = cc_util_normalize_casefold_and_unaccent (info->country_names[i]);
+        }
+}
+
+static GVariant *
+names_to_variant (gchar **names)
+{
+        return g_variant_new ("(msmsms)", names[0], names[1], names[2]);
+}
+
+/* Takes ownership of @variant */
+static void
+names_from_variant (GVariant  *variant,
+                    gchar    **names)
+{
+        g_variant_get (variant, "(msmsms)", &names[0], &names[1], &names[2]);
+        g_variant_unref (variant);
+}
+
+static GPtrArray *
+load_from_cache (const gchar *languages,
+                 const gchar *locales_checksum,
+                 guint64      fonts_stamp)
+{
+        gchar *cache_file;
+        GMappedFile *mapped;
+        GBytes *bytes;
+        GVariant *cache;
+        GVariantIter *entries;
+        guint32 version;
+        const gchar *cached_languages, *cached_checksum;
+        guint64 cached_fonts_stamp;
+        GVariant *language_names, *language_keys, *country_names, *country_keys;
+        gchar *id, *language_code, *country_code;
+        gboolean has_font;
+        GPtrArray *infos;
+
+        cache_file = get_cache_file ();
+        mapped = g_mapped_file_new (cache_file, FALSE, NULL);
+        g_free (cache_file);
+        if (!mapped)
+                return NULL;
+
+        bytes = g_mapped_file_get_bytes (mapped);
+        g_mapped_file_unref (mapped);
+        cache = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (CATALOG_CACHE_FORMAT),
+                                                              bytes, FALSE));
+        g_bytes_unref (bytes);
+
+        g_variant_get (cache, "(u&s&sta" CATALOG_ENTRY_TYPE ")",
+                       &version, &cached_languages, &cached_checksum, &cached_fonts_stamp,
+                       &entries);
+
+        infos = NULL;
+
+        if (version != CATALOG_CACHE_VERSION ||
+            g_strcmp0 (cached_languages, languages) != 0 ||
+            g_strcmp0 (cached_checksum, locales_checksum) != 0 ||
+            cached_fonts_stamp != fonts_stamp ||
+            g_variant_iter_n_children (entries) == 0)
+                goto out;
+
+        infos = g_ptr_array_new_full (g_variant_iter_n_children (entries),
+                                      (GDestroyNotify) locale_info_free);
+
+        while (g_variant_iter_next (entries, CATALOG_ENTRY_FORMAT,
+                                    &id, &language_code, &country_code,
+                                    &language_names, &language_keys,
+                                    &country_names, &country_keys,
+                                    &has_font)) {
+                CcLocaleInfo *info;
+
+                info = g_new0 (CcLocaleInfo, 1);
+                info->id = id;
+                info->language_code = language_code;
+                info->country_code = country_code;
+                names_from_variant (language_names, info->language_names);
+                names_from_variant (language_keys, info->language_keys);
+                names_from_variant (country_names, info->country_names);
+                names_from_variant (country_keys, info->country_keys);
+                info->has_font = has_font;
+
+                g_ptr_array_add (infos, info);
+        }
+
+out:
+        g_variant_iter_free (entries);
+        g_variant_unref (cache);
+
+        return infos;
+}
+
+static void
+save_to_cache (GPtrArray   *infos,
+               const gchar *languages,
+               const gchar *locales_checksum,
+               guint64      fonts_stamp)
+{
+        GVariantBuilder entries;
+        GVariant *cache;
+        gchar *cache_file, *cache_dir;
+        GError *error = NULL;
+        guint i;
+
+        g_variant_builder_init (&entries, G_VARIANT_TYPE ("a" CATALOG_ENTRY_TYPE));
+        for (i = 0; i < infos->len; i++) {
+                CcLocaleInfo *info = infos->pdata[i];
+
+                g_variant_builder_add (&entries, CATALOG_ENTRY_FORMAT,
+                                       info->id,
+                                       info->language_code,
+                                       info->country_code,
+                                       names_to_variant (info->language_names),
+                                       names_to_variant (info->language_keys),
+                                       names_to_variant (info->country_names),
+                                       names_to_variant (info->country_keys),
+                                       info->has_font);
+        }
+
+        cache = g_variant_ref_sink (g_variant_new (CATALOG_CACHE_FORMAT,
+                                                   (guint32) CATALOG_CACHE_VERSION,
+                                                   languages,
+                                                   locales_checksum,
+                                                   fonts_stamp,
+                                                   &entries));
+
+        cache_file = get_cache_file ();
+        cache_dir = g_path_get_dirname (cache_file);
+        g_mkdir_with_parents (cache_dir, 0700);
+
+        if (!g_file_set_contents (cache_file,
+                                  g_variant_get_data (cache),
+                                  g_variant_get_size (cache),
+                                  &error)) {
+                g_debug ("Could not write locale cache: %s", error->message);
+                g_error_free (error);
+        }
+
+        g_free (cache_dir);
+        g_free (cache_file);
+        g_variant_unref (cache);
+}
+
+static void
+publish_catalog (GPtrArray *infos)
+{
+        GList *list, *l;
+        guint i;
+
+        catalog = infos;
+        catalog_by_id = g_hash_table_new (g_str_hash, g_str_equal);
+        for (i = 0; i < infos->len; i++) {
+                CcLocaleInfo *info = infos->pdata[i];
+
+                g_hash_table_insert (catalog_by_id, info->id, info);
+        }
+
+        g_clear_pointer (&building, build_data_free);
+
+        list = waiters;
+        waiters = NULL;
+        for (l = list; l != NULL; l = l->next) {
+                g_task_return_boolean (l->data, TRUE);
+                g_object_unref (l->data);
+        }
+        g_list_free (list);
+}
+
+static void
+finish_catalog_thread (GTask        *task,
+                       gpointer      source_object,
+                       gpointer      task_data,
+                       GCancellable *cancellable)
+{
+        BuildData *data = task_data;
+        guint i;
+
+        for (i = 0; i < data->infos->len; i++)
+                locale_info_finish (data->infos->pdata[i], data->langs);
+
+        g_ptr_array_sort (data->infos, compare_locale_infos);
+        save_to_cache (data->infos, data->languages, data->locales_checksum, data->fonts_stamp);
+
+        g_task_return_boolean (task, TRUE);
+}
+
+static void
+finish_catalog_cb (GObject      *source_object,
+                   GAsyncResult *res,
+                   gpointer      user_data)
+{
+        BuildData *data = user_data;
+
+        publish_catalog (g_steal_pointer (&data->infos));
+}
+
+static gboolean
+lookup_names_idle (gpointer user_data)
+{
+        BuildData *data = user_data;
+        GTask *task;
+        guint n;
+
+        for (n = 0; n < NAMES_PER_BATCH && data->locale_ids[data->next] != NULL; n++) {
+                CcLocaleInfo *info;
+
+                info = locale_info_new (data->locale_ids[data->next++]);
+                if (info != NULL)
+                        g_ptr_array_add (data->infos, info);
+        }
+
+        if (data->locale_ids[data->next] != NULL)
+                return G_SOURCE_CONTINUE;
+
+        task = g_task_new (NULL, NULL, finish_catalog_cb, data);
+        g_task_set_task_data (task, data, NULL);
+        g_task_run_in_thread (task, finish_catalog_thread);
+        g_object_unref (task);
+
+        return G_SOURCE_REMOVE;
+}
+
+static void
+load_catalog_thread (GTask        *task,
+                     gpointer      source_object,
+                     gpointer      task_data,
+                     GCancellable *cancellable)
+{
+        BuildData *data = task_data;
+        GPtrArray *infos;
+        gchar *joined_ids;
+
+        joined_ids = g_strjoinv ("\n", data->locale_ids);
+        data->locales_checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, joined_ids, -1);
+        g_free (joined_ids);
+
+        data->fonts_stamp = get_fonts_stamp ();
+
+        infos = load_from_cache (data->languages, data->locales_checksum, data->fonts_stamp);
+        if (infos == NULL)
+                data->langs = get_covered_languages ();
+
+        g_task_return_pointer (task, infos, (GDestroyNotify) g_ptr_array_unref);
+}
+
+static void
+load_catalog_cb (GObject      *source_object,
+                 GAsyncResult *res,
+                 gpointer      user_data)
+{
+        BuildData *data = user_data;
+        GPtrArray *infos;
+
+        infos = g_task_propagate_pointer (G_TASK (res), NULL);
+        if (infos != NULL) {
+                publish_catalog (infos);
+                return;
+        }
+
+        /* Look the names up a few locales at a time, so that the
+         * panel stays responsive, then finish off in a thread */
+        data->infos = g_ptr_array_new_with_free_func ((GDestroyNotify) locale_info_free);
+        g_idle_add (lookup_names_idle, data);
+}
+
+/**
+ * cc_locale_catalog_prefetch:
+ *
+ * Starts building the catalog, unless that already happened during
+ * this session.  Panels that will show one of the choosers call this
+ * when they are created, so that the catalog is usually ready by the
+ * time it is needed.  Must be called from the main thread.
+ */
+void
+cc_locale_catalog_prefetch (void)
+{
+        GTask *task;
+
+        if (catalog != NULL || building != NULL)
+                return;
+
+        building = g_new0 (BuildData, 1);
+        building->locale_ids = gnome_get_all_locales ();
+        qsort (building->locale_ids, g_strv_length (building->locale_ids),
+               sizeof (gchar *), compare_locale_ids);
+        building->languages = g_strjoinv (":", (gchar **) g_get_language_names ());
+
+        task = g_task_new (NULL, NULL, load_catalog_cb, building);
+        g_task_set_task_data (task, building, NULL);
+        g_task_run_in_thread (task, load_catalog_thread);
+        g_object_unref (task);
+}
+
+/**
+ * cc_locale_catalog_wait_ready:
+ *
+ * Starts building the catalog if needed, and calls @callback once
+ * it is ready.  Open the choosers from @callback rather than waiting
+ * for the catalog on the main thread.
+ */
+void
+cc_locale_catalog_wait_ready (GCancellable        *cancellable,
+                              GAsyncReadyCallback  callback,
+                              gpointer             user_data)
+{
+        GTask *task;
+
+        task = g_task_new (NULL, cancellable, callback, user_data);
+
+        if (catalog != NULL) {
+                g_task_return_boolean (task, TRUE);
+                g_object_unref (task);
+                return;
+        }
+
+        waiters = g_list_prepend (waiters, task);
+        cc_locale_catalog_prefetch ();
+}
+
+gboolean
+cc_locale_catalog_wait_ready_finish (GAsyncResult  *res,
+                                     GError       **error)
+{
+        return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+gboolean
+cc_locale_catalog_is_ready (void)
+{
+        return catalog != NULL;
+}
+
+/**
+ * cc_locale_catalog_get:
+ *
+ * Never blocks: until the catalog is ready, this returns %NULL and
+ * starts building it.
+ *
+ * Returns: the installed locales as #CcLocaleInfo, sorted by id.  The
+ * array and its contents are owned by the catalog and live for the
+ * whole session.
+ */
+GPtrArray *
+cc_locale_catalog_get (void)
+{
+        if (catalog == NULL)
+                cc_locale_catalog_prefetch ();
+
+        return catalog;
+}
+
+const CcLocaleInfo *
+cc_locale_catalog_lookup (const gchar *locale_id)
+{
+        if (catalog_by_id == NULL)
+                return NULL;
+
+        return g_hash_table_lookup (catalog_by_id, locale_id);
+}
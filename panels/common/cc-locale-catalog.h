@@ -0,0 +1,61 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2013 Red Hat, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CC_LOCALE_CATALOG_H__
+#define __CC_LOCALE_CATALOG_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+        CC_LOCALE_NAME_NATIVE,          /* In the locale itself */
+        CC_LOCALE_NAME_CURRENT,         /* In the session's language */
+        CC_LOCALE_NAME_UNTRANSLATED,    /* In the C locale */
+        CC_LOCALE_N_NAMES
+} CcLocaleNameType;
+
+/* Everything the language, format and input choosers need to know
+ * about an installed locale.  The keys are the names run through
+ * cc_util_normalize_casefold_and_unaccent(), ready for searching.
+ * The country names and keys are NULL for locales without a country.
+ */
+typedef struct {
+        gchar    *id;
+        gchar    *language_code;
+        gchar    *country_code;
+        gchar    *language_names[CC_LOCALE_N_NAMES];
+        gchar    *language_keys[CC_LOCALE_N_NAMES];
+        gchar    *country_names[CC_LOCALE_N_NAMES];
+        gchar    *country_keys[CC_LOCALE_N_NAMES];
+        gboolean  has_font;
+} CcLocaleInfo;
+
+void                cc_locale_catalog_prefetch          (void);
+void                cc_locale_catalog_wait_ready        (GCancellable        *cancellable,
+                                                         GAsyncReadyCallback  callback,
+                                                         gpointer             user_data);
+gboolean            cc_locale_catalog_wait_ready_finish (GAsyncResult        *res,
+                                                         GError             **error);
+gboolean            cc_locale_catalog_is_ready          (void);
+GPtrArray          *cc_locale_catalog_get               (void);
+const CcLocaleInfo *cc_locale_catalog_lookup            (const gchar         *locale_id);
+
+G_END_DECLS
+
+#endif /* __CC_LOCALE_CATALOG_H__ */
@@ -38,73 +38,322 @@
 
 #define IS_SOFT_HYPHEN(c) ((c) == 0x00AD)
 
-/* Copied from tracker/src/libtracker-fts/tracker-parser-glib.c under the GPL
- * And then from gnome-shell/src/shell-util.c
+/* Each 64-bit word holds 8 bytes of the string; these masks and
+ * adds work on all of them at once, without carries from one byte
+ * into the next as long as all bytes are ASCII.
+ */
+#define BYTES_ONES  G_GUINT64_CONSTANT (0x0101010101010101)
+#define BYTES_HIGHS G_GUINT64_CONSTANT (0x8080808080808080)
+
+/* Shorter ASCII stretches within other text are not worth leaving
+ * the slow path for */
+#define MIN_ASCII_STRETCH 16
+
+static inline guint64
+ascii_word_fold (guint64 word)
+{
+  guint64 at_least_a, above_z;
+
+  /* The high bit of each byte tells whether it is >= 'A', > 'Z' */
+  at_least_a = word + BYTES_ONES * (0x80 - 'A');
+  above_z = word + BYTES_ONES * (0x7F - 'Z');
+
+  /* Set 0x20 in uppercase letters */
+  return word | ((at_least_a & ~above_z & BYTES_HIGHS) >> 2);
+}
+
+/* Appends the run at @str, @len bytes long, returning FALSE if it is
+ * not valid UTF-8.  ASCII characters have no decomposition and never
+ * get reordered with combining marks, so the runs between them can be
+ * normalized separately.
+ */
+static gboolean
+append_folded_run (GString    *buffer,
+                  const char *str,
+                  gssize      len)
+{
+  char *normalized, *folded;
+  const char *p, *start;
+
+  normalized = g_utf8_normalize (str, len, G_NORMALIZE_NFKD);
+  if (normalized == NULL)
+    return FALSE;
+
+  folded = g_utf8_casefold (normalized, -1);
+  g_free (normalized);
+
+  /* Drop combining diacritical marks.  They and the soft hyphen all
+   * start with one of a few lead bytes, so only those need decoding.
+   */
+  for (p = start = folded; *p != '\0'; )
+    {
+      guchar lead = *p;
+      const char *next;
+      gunichar unichar;
+
+      if (lead != 0xC2 && lead != 0xCC && lead != 0xCD &&
+          lead != 0xE1 && lead != 0xE2 && lead != 0xEF)
+        {
+          p++;
+          continue;
+        }
+
+      unichar = g_utf8_get_char (p);
+      next = g_utf8_next_char (p);
+
+      if (IS_CDM_UCS4 (unichar) || IS_SOFT_HYPHEN (unichar))
+        {
+          g_string_append_len (buffer, start, p - start);
+          start = next;
+        }
+
+      p = next;
+    }
+  g_string_append_len (buffer, start, p - start);
+
+  g_free (folded);
+
+  return TRUE;
+}
+
+/* Same as cc_util_normalize_casefold_and_unaccent(), writing into
+ * @buffer, which can be reused across calls to avoid allocations.
+ * ASCII text, the common case, is lowercased in place 8 bytes at a
+ * time; only the runs of other characters go through GLib's
+ * normalization and case folding.
  *
- * Originally written by Aleksander Morgado <aleksander@gnu.org>
+ * Returns @buffer's contents, or %NULL if @str is %NULL.
  */
-char *
-cc_util_normalize_casefold_and_unaccent (const char *str)
+const char *
+cc_util_normalize_casefold_and_unaccent_to_buffer (const char *str,
+                                                   GString    *buffer)
 {
-  char *normalized, *tmp;
-  int i = 0, j = 0, ilen;
+  const char *p;
+  gsize len, i;
+
+  g_string_truncate (buffer, 0);
 
   if (str == NULL)
     return NULL;
 
-  normalized = g_utf8_normalize (str, -1, G_NORMALIZE_NFKD);
-  tmp = g_utf8_casefold (normalized, -1);
-  g_free (normalized);
-
-  ilen = strlen (tmp);
+  len = strlen (str);
+  g_string_set_size (buffer, len);
 
-  while (i < ilen)
+  i = 0;
+  p = str;
+  while (p < str + len)
     {
-      gunichar unichar;
-      gchar *next_utf8;
-      gint utf8_len;
+      const char *run;
 
-      /* Get next character of the word as UCS4 */
-      unichar = g_utf8_get_char_validated (&tmp[i], -1);
+      /* Plain ASCII, a word at a time */
+      while (p + sizeof (guint64) <= str + len)
+        {
+          guint64 word;
+
+          memcpy (&word, p, sizeof (guint64));
+          if (word & BYTES_HIGHS)
+            break;
+
+          word = ascii_word_fold (word);
+          memcpy (buffer->str + i, &word, sizeof (guint64));
+          p += sizeof (guint64);
+          i += sizeof (guint64);
+        }
 
-      /* Invalid UTF-8 character or end of original string. */
-      if (unichar == (gunichar) -1 ||
-          unichar == (gunichar) -2)
+      /* Then byte by byte until the next non-ASCII character */
+      while (p < str + len && !(*p & 0x80))
         {
-          break;
+          buffer->str[i++] = g_ascii_tolower (*p);
+          p++;
         }
 
-      /* Find next UTF-8 character */
-      next_utf8 = g_utf8_next_char (&tmp[i]);
-      utf8_len = next_utf8 - &tmp[i];
+      if (p == str + len)
+        break;
 
-      if (IS_CDM_UCS4 (unichar) || IS_SOFT_HYPHEN (unichar))
+      /* Short ASCII gaps, like spaces between words, stay in the
+       * run, as each run costs a couple of allocations. */
+      run = p;
+      while (p < str + len)
         {
-          /* If the given unichar is a combining diacritical mark,
-           * just update the original index, not the output one */
-          i += utf8_len;
-          continue;
+          const char *gap;
+
+          if (*p & 0x80)
+            {
+              p++;
+              continue;
+            }
+
+          for (gap = p; gap < str + len && !(*gap & 0x80); gap++)
+            if (gap - p >= MIN_ASCII_STRETCH)
+              break;
+
+          if (gap == str + len || !(*gap & 0x80))
+            break;
+
+          p = gap;
         }
 
-      /* If already found a previous combining
-       * diacritical mark, indexes are different so
-       * need to copy characters. As output and input
-       * buffers may overlap, need to use memmove
-       * instead of memcpy */
-      if (i != j)
+      /* Decomposing and folding can change the length */
+      g_string_truncate (buffer, i);
+      if (!append_folded_run (buffer, run, p - run))
         {
-          memmove (&tmp[j], &tmp[i], utf8_len);
+          /* Invalid UTF-8, stop there */
+          i = buffer->len;
+          break;
         }
+      i = buffer->len;
+      g_string_set_size (buffer, i + (str + len - p));
+    }
+
+  g_string_truncate (buffer, i);
 
-      /* Update both indexes */
-      i += utf8_len;
-      j += utf8_len;
+  return buffer->str;
+}
+
+char *
+cc_util_normalize_casefold_and_unaccent (const char *str)
+{
+  GString *buffer;
+
+  if (str == NULL)
+    return NULL;
+
+  buffer = g_string_sized_new (strlen (str) + 1);
+  cc_util_normalize_casefold_and_unaccent_to_buffer (str, buffer);
+
+  return g_string_free (buffer, FALSE);
+}
+
+/* Matches items against every word of a search query, each item
+ * having a few keys that were run through
+ * cc_util_normalize_casefold_and_unaccent() beforehand.
+ *
+ * While the user keeps typing, each query starts with the previous
+ * one, so whatever did not match before cannot match now.  Those
+ * items are remembered and skipped until the query changes some
+ * other way.
+ */
+struct _CcSearchMatcher
+{
+  char       *query;
+  char      **words;
+  GHashTable *rejected;
+};
+
+CcSearchMatcher *
+cc_search_matcher_new (void)
+{
+  CcSearchMatcher *matcher;
+
+  matcher = g_new0 (CcSearchMatcher, 1);
+  matcher->rejected = g_hash_table_new (NULL, NULL);
+
+  return matcher;
+}
+
+void
+cc_search_matcher_free (CcSearchMatcher *matcher)
+{
+  if (matcher == NULL)
+    return;
+
+  g_hash_table_destroy (matcher->rejected);
+  g_strfreev (matcher->words);
+  g_free (matcher->query);
+  g_free (matcher);
+}
+
+/* Returns TRUE if the new query can only match fewer items */
+gboolean
+cc_search_matcher_set_query (CcSearchMatcher *matcher,
+                             const char      *query)
+{
+  char *normalized;
+  gboolean narrowed;
+
+  normalized = cc_util_normalize_casefold_and_unaccent (query);
+  if (normalized != NULL)
+    g_strstrip (normalized);
+
+  if (normalized == NULL || *normalized == '\0')
+    {
+      g_clear_pointer (&normalized, g_free);
+      narrowed = FALSE;
     }
+  else
+    {
+      narrowed = matcher->query != NULL && g_str_has_prefix (normalized, matcher->query);
+    }
+
+  if (!narrowed)
+    g_hash_table_remove_all (matcher->rejected);
+
+  g_strfreev (matcher->words);
+  matcher->words = normalized ? g_strsplit_set (normalized, " ", 0) : NULL;
+  g_free (matcher->query);
+  matcher->query = normalized;
+
+  return narrowed;
+}
+
+gboolean
+cc_search_matcher_is_empty (CcSearchMatcher *matcher)
+{
+  return matcher->words == NULL;
+}
+
+/* The words of the normalized query, or NULL if it is empty */
+const char * const *
+cc_search_matcher_get_words (CcSearchMatcher *matcher)
+{
+  return (const char * const *) matcher->words;
+}
+
+static gboolean
+match_all (char       **words,
+           const char  *key)
+{
+  char **w;
 
-  /* Force proper string end */
-  tmp[j] = '\0';
+  for (w = words; *w; ++w)
+    if (!strstr (key, *w))
+      return FALSE;
 
-  return tmp;
+  return TRUE;
+}
+
+/* @item identifies the item across queries, @keys may contain NULLs */
+gboolean
+cc_search_matcher_match (CcSearchMatcher    *matcher,
+                         gconstpointer       item,
+                         const char * const *keys,
+                         guint               n_keys)
+{
+  guint i;
+
+  if (matcher->words == NULL)
+    return TRUE;
+
+  if (g_hash_table_contains (matcher->rejected, item))
+    return FALSE;
+
+  for (i = 0; i < n_keys; i++)
+    {
+      if (keys[i] != NULL && match_all (matcher->words, keys[i]))
+        return TRUE;
+    }
+
+  g_hash_table_add (matcher->rejected, (gpointer) item);
+
+  return FALSE;
+}
+
+/* To be called when the keys of @item change, or when @item goes away */
+void
+cc_search_matcher_forget (CcSearchMatcher *matcher,
+                          gconstpointer    item)
+{
+  g_hash_table_remove (matcher->rejected, item);
 }
 
 char *
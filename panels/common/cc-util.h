@@ -23,7 +23,25 @@
 
 #include <glib.h>
 
-char * cc_util_normalize_casefold_and_unaccent (const char *str);
-char * cc_util_get_smart_date                  (GDateTime *date);
+char       * cc_util_normalize_casefold_and_unaccent           (const char *str);
+const char * cc_util_normalize_casefold_and_unaccent_to_buffer (const char *str,
+                                                                GString    *buffer);
+char       * cc_util_get_smart_date                            (GDateTime  *date);
+
+typedef struct _CcSearchMatcher CcSearchMatcher;
+
+CcSearchMatcher *cc_search_matcher_new       (void);
+void             cc_search_matcher_free      (CcSearchMatcher    *matcher);
+gboolean         cc_search_matcher_set_query (CcSearchMatcher    *matcher,
+                                              const char         *query);
+gboolean         cc_search_matcher_is_empty  (CcSearchMatcher    *matcher);
+const char * const *
+                 cc_search_matcher_get_words (CcSearchMatcher    *matcher);
+gboolean         cc_search_matcher_match     (CcSearchMatcher    *matcher,
+                                              gconstpointer       item,
+                                              const char * const *keys,
+                                              guint               n_keys);
+void             cc_search_matcher_forget    (CcSearchMatcher    *matcher,
+                                              gconstpointer       item);
 
 #endif
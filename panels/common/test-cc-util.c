@@ -0,0 +1,275 @@
+/*
+ * Tests for the helpers in cc-util.c
+ *
+ * The Control Center is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * The Control Center is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with the Control Center; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <locale.h>
+#include <string.h>
+#include <glib.h>
+
+#include "cc-util.h"
+
+#define N_RANDOM_STRINGS 100000
+#define N_PERF_ROUNDS    100000
+
+#define IS_CDM_UCS4(c) (((c) >= 0x0300 && (c) <= 0x036F)  || \
+                        ((c) >= 0x1DC0 && (c) <= 0x1DFF)  || \
+                        ((c) >= 0x20D0 && (c) <= 0x20FF)  || \
+                        ((c) >= 0xFE20 && (c) <= 0xFE2F))
+
+#define IS_SOFT_HYPHEN(c) ((c) == 0x00AD)
+
+/* The straightforward implementation, which the fast one has to
+ * match byte for byte.
+ */
+static char *
+reference_normalize_casefold_and_unaccent (const char *str)
+{
+  char *normalized, *tmp;
+  int i = 0, j = 0, ilen;
+
+  normalized = g_utf8_normalize (str, -1, G_NORMALIZE_NFKD);
+  tmp = g_utf8_casefold (normalized, -1);
+  g_free (normalized);
+
+  ilen = strlen (tmp);
+
+  while (i < ilen)
+    {
+      gunichar unichar;
+      gint utf8_len;
+
+      unichar = g_utf8_get_char_validated (&tmp[i], -1);
+      if (unichar == (gunichar) -1 ||
+          unichar == (gunichar) -2)
+        break;
+
+      utf8_len = g_utf8_next_char (&tmp[i]) - &tmp[i];
+
+      if (IS_CDM_UCS4 (unichar) || IS_SOFT_HYPHEN (unichar))
+        {
+          i += utf8_len;
+          continue;
+        }
+
+      if (i != j)
+        memmove (&tmp[j], &tmp[i], utf8_len);
+
+      i += utf8_len;
+      j += utf8_len;
+    }
+
+  tmp[j] = '\0';
+
+  return tmp;
+}
+
+static void
+assert_same_as_reference (const char *str,
+                          GString    *buffer)
+{
+  char *expected, *result;
+
+  expected = reference_normalize_casefold_and_unaccent (str);
+  result = cc_util_normalize_casefold_and_unaccent (str);
+  g_assert_cmpstr (result, ==, expected);
+  g_assert_cmpstr (cc_util_normalize_casefold_and_unaccent_to_buffer (str, buffer), ==, expected);
+
+  g_free (result);
+  g_free (expected);
+}
+
+static void
+test_null (void)
+{
+  GString *buffer;
+
+  buffer = g_string_new ("stale");
+  g_assert_null (cc_util_normalize_casefold_and_unaccent (NULL));
+  g_assert_null (cc_util_normalize_casefold_and_unaccent_to_buffer (NULL, buffer));
+  g_assert_cmpuint (buffer->len, ==, 0);
+  g_string_free (buffer, TRUE);
+}
+
+static void
+test_examples (void)
+{
+  const char *examples[][2] = {
+    { "", "" },
+    { "Keyboard", "keyboard" },
+    { "Région et Langue", "region et langue" },
+    { "Straße", "strasse" },
+    { "ﬁle", "file" },
+    { "Ｆｕｌｌ", "full" },
+    { "soft\xc2\xadhyphen", "softhyphen" },
+    { "ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`@", "abcdefghijklmnopqrstuvwxyz[\\]^_`@" },
+  };
+  GString *buffer;
+  guint i;
+
+  buffer = g_string_new (NULL);
+  for (i = 0; i < G_N_ELEMENTS (examples); i++)
+    {
+      char *result;
+
+      result = cc_util_normalize_casefold_and_unaccent (examples[i][0]);
+      g_assert_cmpstr (result, ==, examples[i][1]);
+      g_free (result);
+
+      assert_same_as_reference (examples[i][0], buffer);
+    }
+  g_string_free (buffer, TRUE);
+}
+
+/* Every character on its own, and between ASCII text and combining
+ * marks, which NFKD reorders.
+ */
+static void
+test_all_characters (void)
+{
+  GString *buffer;
+  gunichar c;
+
+  buffer = g_string_new (NULL);
+  for (c = 1; c <= 0x10FFFF; c++)
+    {
+      char utf8[7], str[64];
+      gint len;
+
+      if (c >= 0xD800 && c <= 0xDFFF)
+        continue;
+
+      len = g_unichar_to_utf8 (c, utf8);
+      utf8[len] = '\0';
+
+      assert_same_as_reference (utf8, buffer);
+
+      g_snprintf (str, sizeof (str), "Hello%sWORLD\xcc\x81x", utf8);
+      assert_same_as_reference (str, buffer);
+
+      g_snprintf (str, sizeof (str), "ABCDEFGHIJKLMNOPQRS%s\xcc\xa3\xcc\x81Zz", utf8);
+      assert_same_as_reference (str, buffer);
+    }
+  g_string_free (buffer, TRUE);
+}
+
+static gunichar
+random_character (void)
+{
+  gunichar c;
+
+  switch (g_test_rand_int_range (0, 4))
+    {
+    case 0:
+      c = g_test_rand_int_range (0x20, 0x7F);
+      break;
+    case 1:
+      c = g_test_rand_int_range (0x0300, 0x0370);
+      break;
+    case 2:
+      c = g_test_rand_int_range (0x80, 0x2100);
+      break;
+    default:
+      c = g_test_rand_int_range (1, 0x110000);
+      break;
+    }
+
+  if (c >= 0xD800 && c <= 0xDFFF)
+    c = ' ';
+
+  return c;
+}
+
+static void
+test_random_strings (void)
+{
+  GString *buffer, *str;
+  guint i;
+
+  buffer = g_string_new (NULL);
+  str = g_string_new (NULL);
+  for (i = 0; i < N_RANDOM_STRINGS; i++)
+    {
+      gint j, len;
+
+      g_string_truncate (str, 0);
+      len = g_test_rand_int_range (0, 40);
+      for (j = 0; j < len; j++)
+        g_string_append_unichar (str, random_character ());
+
+      assert_same_as_reference (str->str, buffer);
+    }
+  g_string_free (str, TRUE);
+  g_string_free (buffer, TRUE);
+}
+
+static void
+test_throughput (void)
+{
+  const char *texts[] = {
+    "Keyboard Shortcuts and Input Sources for the Desktop",
+    "Français (Canada) — Région et langue",
+    "Русский язык Россия",
+  };
+  GString *buffer;
+  guint i, round;
+
+  buffer = g_string_new (NULL);
+  for (i = 0; i < G_N_ELEMENTS (texts); i++)
+    {
+      gsize len = strlen (texts[i]);
+      double reference, elapsed;
+
+      g_test_timer_start ();
+      for (round = 0; round < N_PERF_ROUNDS; round++)
+        g_free (reference_normalize_casefold_and_unaccent (texts[i]));
+      reference = g_test_timer_elapsed ();
+
+      g_test_timer_start ();
+      for (round = 0; round < N_PERF_ROUNDS; round++)
+        cc_util_normalize_casefold_and_unaccent_to_buffer (texts[i], buffer);
+      elapsed = g_test_timer_elapsed ();
+
+      g_test_maximized_result (len * N_PERF_ROUNDS / elapsed / 1e6,
+                               "\"%s\": %.1f MB/s, reference %.1f MB/s",
+                               texts[i],
+                               len * N_PERF_ROUNDS / elapsed / 1e6,
+                               len * N_PERF_ROUNDS / reference / 1e6);
+    }
+  g_string_free (buffer, TRUE);
+}
+
+int
+main (int argc, char **argv)
+{
+  setlocale (LC_ALL, "");
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/common/util/normalize/null", test_null);
+  g_test_add_func ("/common/util/normalize/examples", test_examples);
+  g_test_add_func ("/common/util/normalize/random-strings", test_random_strings);
+
+  /* Run with -m slow, this goes through every code point */
+  if (g_test_slow ())
+    g_test_add_func ("/common/util/normalize/all-characters", test_all_characters);
+
+  /* Run with -m perf */
+  if (g_test_perf ())
+    g_test_add_func ("/common/util/normalize/throughput", test_throughput);
+
+  return g_test_run ();
+}
@@ -36,6 +36,15 @@ G_DEFINE_TYPE (CcTimezoneMap, cc_timezone_map, GTK_TYPE_WIDGET)
 
 #define DATETIME_RESOURCE_PATH "/org/gnome/control-center/datetime"
 
+/* Locations are bucketed on a LOCATION_GRID_SIZE x LOCATION_GRID_SIZE
+ * grid over the projected map so that a click only has to look at the
+ * few cells around it */
+#define LOCATION_GRID_SIZE 32
+
+/* Number of scaled hilight layers kept around, the selected one
+ * being the first */
+#define HILIGHT_CACHE_SIZE 4
+
 typedef struct
 {
   gdouble offset;
@@ -45,13 +54,19 @@ typedef struct
   guchar alpha;
 } CcTimezoneMapOffset;
 
+typedef struct
+{
+  gchar *file;
+  cairo_surface_t *surface;
+} CcTimezoneMapHilight;
+
 struct _CcTimezoneMapPrivate
 {
   GdkPixbuf *orig_background;
   GdkPixbuf *orig_background_dim;
   GdkPixbuf *orig_color_map;
 
-  GdkPixbuf *background;
+  cairo_surface_t *background;
   GdkPixbuf *color_map;
   GdkPixbuf *pin;
 
@@ -60,8 +75,14 @@ struct _CcTimezoneMapPrivate
 
   gdouble selected_offset;
 
+  /* Layers scaled to the current allocation */
+  gint surface_width;
+  gint surface_height;
+  CcTimezoneMapHilight hilights[HILIGHT_CACHE_SIZE];
+
   TzDB *tzdb;
   TzLocation *location;
+  GPtrArray **location_grid;
 
   gchar *bubble_text;
 };
@@ -119,6 +140,119 @@ static CcTimezoneMapOffset color_codes[] =
 };
 
 
+static void
+clear_hilights (CcTimezoneMap *map)
+{
+  CcTimezoneMapPrivate *priv = map->priv;
+  gint i;
+
+  for (i = 0; i < HILIGHT_CACHE_SIZE; i++)
+    {
+      g_clear_pointer (&priv->hilights[i].file, g_free);
+      g_clear_pointer (&priv->hilights[i].surface, cairo_surface_destroy);
+    }
+}
+
+static cairo_surface_t *
+create_scaled_surface (GdkPixbuf *pixbuf,
+                       gint       width,
+                       gint       height)
+{
+  cairo_surface_t *surface;
+  GdkPixbuf *scaled;
+  cairo_t *cr;
+
+  scaled = gdk_pixbuf_scale_simple (pixbuf, width, height, GDK_INTERP_BILINEAR);
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+  cr = cairo_create (surface);
+  gdk_cairo_set_source_pixbuf (cr, scaled, 0, 0);
+  cairo_paint (cr);
+  cairo_destroy (cr);
+
+  g_object_unref (scaled);
+
+  return surface;
+}
+
+static void
+update_background (CcTimezoneMap *map)
+{
+  CcTimezoneMapPrivate *priv = map->priv;
+  GdkPixbuf *pixbuf;
+
+  g_clear_pointer (&priv->background, cairo_surface_destroy);
+
+  if (priv->surface_width <= 0 || priv->surface_height <= 0)
+    return;
+
+  if (!gtk_widget_is_sensitive (GTK_WIDGET (map)))
+    pixbuf = priv->orig_background_dim;
+  else
+    pixbuf = priv->orig_background;
+
+  if (pixbuf)
+    priv->background = create_scaled_surface (pixbuf,
+                                              priv->surface_width,
+                                              priv->surface_height);
+}
+
+static cairo_surface_t *
+get_hilight (CcTimezoneMap *map)
+{
+  CcTimezoneMapPrivate *priv = map->priv;
+  CcTimezoneMapHilight hilight;
+  GdkPixbuf *orig_hilight;
+  GError *err = NULL;
+  char file[256];
+  char buf[16];
+  gint i;
+
+  if (priv->surface_width <= 0 || priv->surface_height <= 0)
+    return NULL;
+
+  g_snprintf (file, sizeof (file), DATETIME_RESOURCE_PATH "/timezone_%s%s.png",
+              g_ascii_formatd (buf, sizeof (buf), "%g", priv->selected_offset),
+              gtk_widget_is_sensitive (GTK_WIDGET (map)) ? "" : "_dim");
+
+  for (i = 0; i < HILIGHT_CACHE_SIZE; i++)
+    {
+      if (g_strcmp0 (priv->hilights[i].file, file) != 0)
+        continue;
+
+      /* Move it to the front */
+      hilight = priv->hilights[i];
+      memmove (&priv->hilights[1], &priv->hilights[0], i * sizeof (CcTimezoneMapHilight));
+      priv->hilights[0] = hilight;
+
+      return hilight.surface;
+    }
+
+  orig_hilight = gdk_pixbuf_new_from_resource (file, &err);
+  if (!orig_hilight)
+    {
+      g_warning ("Could not load hilight: %s",
+                 (err) ? err->message : "Unknown Error");
+      if (err)
+        g_clear_error (&err);
+      return NULL;
+    }
+
+  /* Drop the least recently used one */
+  i = HILIGHT_CACHE_SIZE - 1;
+  g_free (priv->hilights[i].file);
+  g_clear_pointer (&priv->hilights[i].surface, cairo_surface_destroy);
+  memmove (&priv->hilights[1], &priv->hilights[0], i * sizeof (CcTimezoneMapHilight));
+
+  priv->hilights[0].file = g_strdup (file);
+  priv->hilights[0].surface = create_scaled_surface (orig_hilight,
+                                                     priv->surface_width,
+                                                     priv->surface_height);
+  g_object_unref (orig_hilight);
+
+  return priv->hilights[0].surface;
+}
+
 static void
 cc_timezone_map_dispose (GObject *object)
 {
@@ -127,7 +261,8 @@ cc_timezone_map_dispose (GObject *object)
   g_clear_object (&priv->orig_background);
   g_clear_object (&priv->orig_background_dim);
   g_clear_object (&priv->orig_color_map);
-  g_clear_object (&priv->background);
+  g_clear_pointer (&priv->background, cairo_surface_destroy);
+  clear_hilights (CC_TIMEZONE_MAP (object));
   g_clear_object (&priv->pin);
   g_clear_pointer (&priv->bubble_text, g_free);
 
@@ -153,6 +288,15 @@ cc_timezone_map_finalize (GObject *object)
       priv->tzdb = NULL;
     }
 
+  if (priv->location_grid)
+    {
+      gint i;
+
+      for (i = 0; i < LOCATION_GRID_SIZE * LOCATION_GRID_SIZE; i++)
+        if (priv->location_grid[i])
+          g_ptr_array_free (priv->location_grid[i], TRUE);
+      g_clear_pointer (&priv->location_grid, g_free);
+    }
 
   G_OBJECT_CLASS (cc_timezone_map_parent_class)->finalize (object);
 }
@@ -195,20 +339,17 @@ cc_timezone_map_size_allocate (GtkWidget     *widget,
                                GtkAllocation *allocation)
 {
   CcTimezoneMapPrivate *priv = CC_TIMEZONE_MAP (widget)->priv;
-  GdkPixbuf *pixbuf;
-
-  if (priv->background)
-    g_object_unref (priv->background);
 
-  if (!gtk_widget_is_sensitive (widget))
-    pixbuf = priv->orig_background_dim;
-  else
-    pixbuf = priv->orig_background;
+  if (priv->surface_width != allocation->width ||
+      priv->surface_height != allocation->height ||
+      priv->background == NULL)
+    {
+      priv->surface_width = allocation->width;
+      priv->surface_height = allocation->height;
 
-  priv->background = gdk_pixbuf_scale_simple (pixbuf,
-                                              allocation->width,
-                                              allocation->height,
-                                              GDK_INTERP_BILINEAR);
+      clear_hilights (CC_TIMEZONE_MAP (widget));
+      update_background (CC_TIMEZONE_MAP (widget));
+    }
 
   if (priv->color_map)
     g_object_unref (priv->color_map);
@@ -366,55 +507,25 @@ cc_timezone_map_draw (GtkWidget *widget,
                       cairo_t   *cr)
 {
   CcTimezoneMapPrivate *priv = CC_TIMEZONE_MAP (widget)->priv;
-  GdkPixbuf *hilight, *orig_hilight;
+  cairo_surface_t *hilight;
   GtkAllocation alloc;
-  gchar *file;
-  GError *err = NULL;
   gdouble pointx, pointy;
-  char buf[16];
 
   gtk_widget_get_allocation (widget, &alloc);
 
   /* paint background */
-  gdk_cairo_set_source_pixbuf (cr, priv->background, 0, 0);
-  cairo_paint (cr);
-
-  /* paint hilight */
-  if (gtk_widget_is_sensitive (widget))
-    {
-      file = g_strdup_printf (DATETIME_RESOURCE_PATH "/timezone_%s.png",
-                              g_ascii_formatd (buf, sizeof (buf),
-                                               "%g", priv->selected_offset));
-    }
-  else
+  if (priv->background)
     {
-      file = g_strdup_printf (DATETIME_RESOURCE_PATH "/timezone_%s_dim.png",
-                              g_ascii_formatd (buf, sizeof (buf),
-                                               "%g", priv->selected_offset));
-
+      cairo_set_source_surface (cr, priv->background, 0, 0);
+      cairo_paint (cr);
     }
 
-  orig_hilight = gdk_pixbuf_new_from_resource (file, &err);
-  g_free (file);
-  file = NULL;
-
-  if (!orig_hilight)
-    {
-      g_warning ("Could not load hilight: %s",
-                 (err) ? err->message : "Unknown Error");
-      if (err)
-        g_clear_error (&err);
-    }
-  else
+  /* paint hilight */
+  hilight = get_hilight (CC_TIMEZONE_MAP (widget));
+  if (hilight)
     {
-
-      hilight = gdk_pixbuf_scale_simple (orig_hilight, alloc.width,
-                                         alloc.height, GDK_INTERP_BILINEAR);
-      gdk_cairo_set_source_pixbuf (cr, hilight, 0, 0);
-
+      cairo_set_source_surface (cr, hilight, 0, 0);
       cairo_paint (cr);
-      g_object_unref (hilight);
-      g_object_unref (orig_hilight);
     }
 
   if (priv->location)
@@ -466,8 +577,14 @@ static void
 cc_timezone_map_state_flags_changed (GtkWidget     *widget,
                                      GtkStateFlags  prev_state)
 {
+  gboolean was_sensitive;
+
   update_cursor (widget);
 
+  was_sensitive = !(prev_state & GTK_STATE_FLAG_INSENSITIVE);
+  if (was_sensitive != gtk_widget_is_sensitive (widget))
+    update_background (CC_TIMEZONE_MAP (widget));
+
   if (GTK_WIDGET_CLASS (cc_timezone_map_parent_class)->state_flags_changed)
     GTK_WIDGET_CLASS (cc_timezone_map_parent_class)->state_flags_changed (widget, prev_state);
 }
@@ -504,16 +621,106 @@ cc_timezone_map_class_init (CcTimezoneMapClass *klass)
 
 
 static gint
-sort_locations (TzLocation *a,
-                TzLocation *b)
+location_grid_cell (gdouble pos)
 {
-  if (a->dist > b->dist)
-    return 1;
+  return CLAMP ((gint) (pos * LOCATION_GRID_SIZE), 0, LOCATION_GRID_SIZE - 1);
+}
 
-  if (a->dist < b->dist)
-    return -1;
+static void
+build_location_grid (CcTimezoneMap *map)
+{
+  CcTimezoneMapPrivate *priv = map->priv;
+  GPtrArray *locations;
+  guint i;
+
+  priv->location_grid = g_new0 (GPtrArray *, LOCATION_GRID_SIZE * LOCATION_GRID_SIZE);
+
+  if (!priv->tzdb)
+    return;
 
-  return 0;
+  locations = tz_get_locations (priv->tzdb);
+
+  for (i = 0; i < locations->len; i++)
+    {
+      TzLocation *loc = locations->pdata[i];
+      GPtrArray **cell;
+      gint cx, cy;
+
+      /* The projection doesn't depend on the allocation other than by
+       * scaling, so bucket on the unit-sized map */
+      cx = location_grid_cell (convert_longitude_to_x (loc->longitude, 1));
+      cy = location_grid_cell (convert_latitude_to_y (loc->latitude, 1));
+
+      cell = &priv->location_grid[cy * LOCATION_GRID_SIZE + cx];
+      if (*cell == NULL)
+        *cell = g_ptr_array_new ();
+      g_ptr_array_add (*cell, loc);
+    }
+}
+
+static TzLocation *
+find_nearest_location (CcTimezoneMap *map,
+                       gdouble        x,
+                       gdouble        y,
+                       gint           width,
+                       gint           height)
+{
+  CcTimezoneMapPrivate *priv = map->priv;
+  TzLocation *nearest = NULL;
+  gdouble cell_size;
+  gint cx, cy, ring;
+
+  cx = location_grid_cell (x / width);
+  cy = location_grid_cell (y / height);
+  cell_size = MIN (width, height) / (gdouble) LOCATION_GRID_SIZE;
+
+  for (ring = 0; ring < LOCATION_GRID_SIZE; ring++)
+    {
+      gint i, j;
+
+      /* Anything in this ring or further away is at least (ring - 1)
+       * full cells away from the clicked point */
+      if (nearest && nearest->dist <= pow ((ring - 1) * cell_size, 2))
+        break;
+
+      for (j = cy - ring; j <= cy + ring; j++)
+        {
+          if (j < 0 || j >= LOCATION_GRID_SIZE)
+            continue;
+
+          for (i = cx - ring; i <= cx + ring; i++)
+            {
+              GPtrArray *cell;
+              guint k;
+
+              if (i < 0 || i >= LOCATION_GRID_SIZE)
+                continue;
+
+              /* Only the border of the ring, the inside was already done */
+              if (ABS (i - cx) != ring && ABS (j - cy) != ring)
+                continue;
+
+              cell = priv->location_grid[j * LOCATION_GRID_SIZE + i];
+              if (cell == NULL)
+                continue;
+
+              for (k = 0; k < cell->len; k++)
+                {
+                  TzLocation *loc = cell->pdata[k];
+                  gdouble dx, dy;
+
+                  dx = convert_longitude_to_x (loc->longitude, width) - x;
+                  dy = convert_latitude_to_y (loc->latitude, height) - y;
+
+                  loc->dist = dx * dx + dy * dy;
+                  if (nearest == NULL || loc->dist < nearest->dist)
+                    nearest = loc;
+                }
+            }
+        }
+    }
+
+  return nearest;
 }
 
 static void
@@ -521,18 +728,18 @@ set_location (CcTimezoneMap *map,
               TzLocation    *location)
 {
   CcTimezoneMapPrivate *priv = map->priv;
-  TzInfo *info;
+  gboolean daylight;
+  glong offset;
 
   priv->location = location;
 
-  info = tz_info_from_location (priv->location);
+  offset = tz_location_get_utc_offset_at_time (priv->location,
+                                               g_get_real_time () / G_USEC_PER_SEC,
+                                               &daylight);
 
-  priv->selected_offset = tz_location_get_utc_offset (priv->location)
-    / (60.0*60.0) + ((info->daylight) ? -1.0 : 0.0);
+  priv->selected_offset = offset / (60.0*60.0) + (daylight ? -1.0 : 0.0);
 
   g_signal_emit (map, signals[LOCATION_CHANGED], 0, priv->location);
-
-  tz_info_free (info);
 }
 
 static gboolean
@@ -546,9 +753,7 @@ button_press_event (GtkWidget      *widget,
   gint rowstride;
   gint i;
 
-  const GPtrArray *array;
-  gint width, height;
-  GList *distances = NULL;
+  TzLocation *location;
   GtkAllocation alloc;
 
   x = event->x;
@@ -577,33 +782,12 @@ button_press_event (GtkWidget      *widget,
 
   /* work out the co-ordinates */
 
-  array = tz_get_locations (priv->tzdb);
-
   gtk_widget_get_allocation (widget, &alloc);
-  width = alloc.width;
-  height = alloc.height;
-
-  for (i = 0; i < array->len; i++)
-    {
-      gdouble pointx, pointy, dx, dy;
-      TzLocation *loc = array->pdata[i];
-
-      pointx = convert_longitude_to_x (loc->longitude, width);
-      pointy = convert_latitude_to_y (loc->latitude, height);
-
-      dx = pointx - x;
-      dy = pointy - y;
-
-      loc->dist = dx * dx + dy * dy;
-      distances = g_list_prepend (distances, loc);
-
-    }
-  distances = g_list_sort (distances, (GCompareFunc) sort_locations);
-
-
-  set_location (CC_TIMEZONE_MAP (widget), (TzLocation*) distances->data);
 
-  g_list_free (distances);
+  location = find_nearest_location (CC_TIMEZONE_MAP (widget),
+                                    x, y, alloc.width, alloc.height);
+  if (location)
+    set_location (CC_TIMEZONE_MAP (widget), location);
 
   return TRUE;
 }
@@ -655,6 +839,7 @@ cc_timezone_map_init (CcTimezoneMap *self)
     }
 
   priv->tzdb = tz_load_db ();
+  build_location_grid (self);
 
   g_signal_connect (self, "button-press-event", G_CALLBACK (button_press_event),
                     NULL);
@@ -1,8 +1,15 @@
 #include <config.h>
 #include <locale.h>
+#include <math.h>
+#include <utime.h>
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
 
+#include "cc-timezone-map.h"
 #include "tz.h"
 
+#define N_DRAWS 200
+
 static void
 test_timezone_gfx (gconstpointer data)
 {
@@ -40,9 +47,274 @@ test_timezone_gfx (gconstpointer data)
 	tz_db_free (db);
 }
 
+static void
+test_timezone_map_draw (void)
+{
+	GtkWidget *window;
+	CcTimezoneMap *map;
+	GtkAllocation alloc;
+	cairo_surface_t *surface;
+	cairo_t *cr;
+	gdouble elapsed;
+	guint i;
+
+	/* Let the offscreen window do a proper size request and allocation */
+	window = gtk_offscreen_window_new ();
+	map = cc_timezone_map_new ();
+	gtk_widget_set_size_request (GTK_WIDGET (map), 800, 400);
+	gtk_container_add (GTK_CONTAINER (window), GTK_WIDGET (map));
+	gtk_widget_show_all (window);
+	gtk_widget_get_allocation (GTK_WIDGET (map), &alloc);
+	cc_timezone_map_set_timezone (map, "Europe/London");
+	cc_timezone_map_set_bubble_text (map, "<b>GMT (UTC+00)</b>\n<small>London, United Kingdom</small>\n<b>12:00</b>");
+
+	surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, alloc.width, alloc.height);
+	cr = cairo_create (surface);
+
+	g_test_timer_start ();
+	for (i = 0; i < N_DRAWS; i++)
+		gtk_widget_draw (GTK_WIDGET (map), cr);
+	elapsed = g_test_timer_elapsed ();
+
+	g_test_minimized_result (elapsed * 1000.0 / N_DRAWS,
+				 "Drawing the timezone map took %.3f ms per frame",
+				 elapsed * 1000.0 / N_DRAWS);
+
+	cairo_destroy (cr);
+	cairo_surface_destroy (surface);
+	gtk_widget_destroy (window);
+}
+
+static void
+test_timezone_names (void)
+{
+	TzLocation loc = { 0, };
+	TzInfo *info;
+
+	loc.zone = (gchar *) "Europe/London";
+
+	/* 2015-01-15 12:00 UTC, in winter */
+	info = tz_info_from_location_at_time (&loc, 1421323200);
+	g_assert (!info->daylight);
+	g_assert_cmpstr (info->tzname_normal, ==, "GMT");
+	g_assert_cmpstr (info->tzname_daylight, ==, "BST");
+	tz_info_free (info);
+
+	/* 2015-07-15 12:00 UTC, in summer */
+	info = tz_info_from_location_at_time (&loc, 1436961600);
+	g_assert (info->daylight);
+	g_assert_cmpstr (info->tzname_normal, ==, "GMT");
+	g_assert_cmpstr (info->tzname_daylight, ==, "BST");
+	tz_info_free (info);
+
+	/* Doesn't switch */
+	loc.zone = (gchar *) "Asia/Tokyo";
+	info = tz_info_from_location_at_time (&loc, 1436961600);
+	g_assert (!info->daylight);
+	g_assert_cmpstr (info->tzname_normal, ==, "JST");
+	g_assert_cmpstr (info->tzname_daylight, ==, NULL);
+	tz_info_free (info);
+}
+
+#define N_CLICKS 500
+
+/* Same projection as cc-timezone-map.c */
+static gdouble
+convert_longitude_to_x (gdouble longitude, gint map_width)
+{
+	const gdouble xdeg_offset = -6;
+
+	return (map_width * (180.0 + longitude) / 360.0)
+		+ (map_width * xdeg_offset / 180.0);
+}
+
+static gdouble
+convert_latitude_to_y (gdouble latitude, gdouble map_height)
+{
+	gdouble bottom_lat = -59;
+	gdouble top_lat = 81;
+	gdouble top_per, y, full_range, top_offset, map_range;
+
+	top_per = top_lat / 180.0;
+	y = 1.25 * log (tan (G_PI_4 + 0.4 * (latitude / 360.0) * G_PI * 2));
+	full_range = 4.6068250867599998;
+	top_offset = full_range * top_per;
+	map_range = fabs (1.25 * log (tan (G_PI_4 + 0.4 * (bottom_lat / 360.0) * G_PI * 2)) - top_offset);
+	y = fabs (y - top_offset);
+	y = y / map_range;
+	y = y * map_height;
+	return y;
+}
+
+static gdouble
+location_distance (TzLocation *loc, gint x, gint y, gint width, gint height)
+{
+	gdouble dx, dy;
+
+	dx = convert_longitude_to_x (loc->longitude, width) - x;
+	dy = convert_latitude_to_y (loc->latitude, height) - y;
+
+	return dx * dx + dy * dy;
+}
+
+static void
+test_timezone_map_nearest (void)
+{
+	GtkWidget *window;
+	CcTimezoneMap *map;
+	GtkAllocation alloc;
+	GPtrArray *locs;
+	TzDB *db;
+	guint i, j;
+
+	window = gtk_offscreen_window_new ();
+	map = cc_timezone_map_new ();
+	gtk_widget_set_size_request (GTK_WIDGET (map), 800, 400);
+	gtk_container_add (GTK_CONTAINER (window), GTK_WIDGET (map));
+	gtk_widget_show_all (window);
+	gtk_widget_get_allocation (GTK_WIDGET (map), &alloc);
+
+	db = tz_load_db ();
+	locs = tz_get_locations (db);
+
+	for (i = 0; i < N_CLICKS; i++) {
+		GdkEvent *event;
+		TzLocation *loc;
+		gdouble best = G_MAXDOUBLE;
+		gint x, y;
+
+		x = g_test_rand_int_range (0, alloc.width);
+		y = g_test_rand_int_range (0, alloc.height);
+
+		event = gdk_event_new (GDK_BUTTON_PRESS);
+		event->button.window = g_object_ref (gtk_widget_get_window (GTK_WIDGET (map)));
+		event->button.x = x;
+		event->button.y = y;
+		event->button.button = 1;
+		gtk_widget_event (GTK_WIDGET (map), event);
+		gdk_event_free (event);
+
+		/* The grid lookup has to find a location as close as
+		 * going through all of them would */
+		for (j = 0; j < locs->len; j++)
+			best = MIN (best, location_distance (locs->pdata[j], x, y, alloc.width, alloc.height));
+
+		loc = cc_timezone_map_get_location (map);
+		g_assert (loc != NULL);
+		g_assert_cmpfloat (location_distance (loc, x, y, alloc.width, alloc.height), <=, best + 1e-6);
+	}
+
+	tz_db_free (db);
+	gtk_widget_destroy (window);
+}
+
+static void
+write_zone_tab (const char *path,
+		const char *contents,
+		time_t      mtime)
+{
+	struct utimbuf times;
+
+	g_assert (g_file_set_contents (path, contents, -1, NULL));
+
+	times.actime = mtime;
+	times.modtime = mtime;
+	g_assert_cmpint (g_utime (path, &times), ==, 0);
+}
+
+static void
+assert_zones (TzDB *db, const char * const *zones)
+{
+	GPtrArray *locs;
+	guint i;
+
+	g_assert (db != NULL);
+	locs = tz_get_locations (db);
+	g_assert_cmpuint (locs->len, ==, g_strv_length ((char **) zones));
+
+	/* Locations are sorted by zone */
+	for (i = 0; i < locs->len; i++)
+		g_assert_cmpstr (tz_location_get_zone (locs->pdata[i]), ==, zones[i]);
+}
+
+static void
+test_timezone_cache (gconstpointer data)
+{
+	const char *cache_dir = data;
+	const char * const old_zones[] = { "Europe/London", "Europe/Paris", NULL };
+	const char * const new_zones[] = { "Europe/Berlin", "Europe/London", "Europe/Paris", NULL };
+	char *zone_tab, *cache_file, *default_cache_file;
+	time_t mtime = 1000000000;
+	TzDB *db;
+
+	zone_tab = g_build_filename (cache_dir, "zone.tab", NULL);
+	cache_file = g_build_filename (cache_dir, "zone.tab.cache", NULL);
+	tz_set_data_file (zone_tab);
+	tz_set_cache_file (cache_file);
+
+	write_zone_tab (zone_tab,
+			"# comment\n"
+			"GB\t+513030-0000731\tEurope/London\n"
+			"FR\t+4852+00220\tEurope/Paris\n",
+			mtime);
+	db = tz_load_db ();
+	assert_zones (db, old_zones);
+	tz_db_free (db);
+	g_assert (g_file_test (cache_file, G_FILE_TEST_IS_REGULAR));
+
+	/* Same size and mtime: the cache wins over the file */
+	write_zone_tab (zone_tab,
+			"# comment\n"
+			"GB\t+513030-0000731\tEurope/London\n"
+			"FR\t+4852+00220\tEurope/Pariz\n",
+			mtime);
+	db = tz_load_db ();
+	assert_zones (db, old_zones);
+	tz_db_free (db);
+
+	/* tzdata got upgraded */
+	write_zone_tab (zone_tab,
+			"# comment\n"
+			"DE\t+5230+01322\tEurope/Berlin\n"
+			"GB\t+513030-0000731\tEurope/London\n"
+			"FR\t+4852+00220\tEurope/Paris\n",
+			mtime + 60);
+	db = tz_load_db ();
+	assert_zones (db, new_zones);
+	tz_db_free (db);
+
+	/* And again, to something of the same size */
+	write_zone_tab (zone_tab,
+			"# comment\n"
+			"DE\t+5230+01322\tEurope/Berlin\n"
+			"GB\t+513030-0000731\tEurope/London\n"
+			"FR\t+4852+00220\tEurope/Pariz\n",
+			mtime + 120);
+	db = tz_load_db ();
+	g_assert_cmpstr (tz_location_get_zone (tz_get_locations (db)->pdata[2]), ==, "Europe/Pariz");
+	tz_db_free (db);
+
+	g_remove (cache_file);
+	g_remove (zone_tab);
+	g_free (cache_file);
+	g_free (zone_tab);
+
+	default_cache_file = g_build_filename (cache_dir, "timezones.cache", NULL);
+	tz_set_data_file (NULL);
+	tz_set_cache_file (default_cache_file);
+	g_free (default_cache_file);
+}
+
 int main (int argc, char **argv)
 {
-	char *pixmap_dir;
+	char *pixmap_dir, *cache_dir, *cache_file;
+	int ret;
+
+	/* Keep the timezone cache out of the user's home directory */
+	cache_dir = g_dir_make_tmp ("test-timezone-gfx-XXXXXX", NULL);
+	g_assert (cache_dir != NULL);
+	cache_file = g_build_filename (cache_dir, "timezones.cache", NULL);
+	tz_set_cache_file (cache_file);
 
         setlocale (LC_ALL, "");
 	g_test_init (&argc, &argv, NULL);
@@ -55,10 +327,29 @@ int main (int argc, char **argv)
 		pixmap_dir = g_strdup (SRCDIR "/data/");
 	} else {
 		g_message ("Usage: %s [PIXMAP DIRECTORY]", argv[0]);
+		g_rmdir (cache_dir);
 		return 1;
 	}
 
 	g_test_add_data_func ("/datetime/timezone-gfx", pixmap_dir, test_timezone_gfx);
+	g_test_add_data_func ("/datetime/timezone-cache", cache_dir, test_timezone_cache);
+	g_test_add_func ("/datetime/timezone-names", test_timezone_names);
+
+	if (gtk_init_check (NULL, NULL)) {
+		g_test_add_func ("/datetime/timezone-map-nearest", test_timezone_map_nearest);
+
+		/* Run with -m perf */
+		if (g_test_perf ())
+			g_test_add_func ("/datetime/timezone-map-draw", test_timezone_map_draw);
+	}
+
+	ret = g_test_run ();
+
+	g_remove (cache_file);
+	g_rmdir (cache_dir);
+	g_free (cache_file);
+	g_free (cache_dir);
+	g_free (pixmap_dir);
 
-	return g_test_run ();
+	return ret;
 }
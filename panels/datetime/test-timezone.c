@@ -1,5 +1,6 @@
 #include <locale.h>
 #include <gtk/gtk.h>
+#include <glib/gstdio.h>
 #include "cc-timezone-map.h"
 
 #define TZ_DIR "/usr/share/zoneinfo/"
@@ -100,6 +101,15 @@ test_timezone (void)
 
 int main (int argc, char **argv)
 {
+	char *cache_dir, *cache_file;
+	int ret;
+
+	/* Keep the timezone cache out of the user's home directory */
+	cache_dir = g_dir_make_tmp ("test-timezone-XXXXXX", NULL);
+	g_assert (cache_dir != NULL);
+	cache_file = g_build_filename (cache_dir, "timezones.cache", NULL);
+	tz_set_cache_file (cache_file);
+
 	setlocale (LC_ALL, "");
 	gtk_init (NULL, NULL);
 	g_test_init (&argc, &argv, NULL);
@@ -108,5 +118,12 @@ int main (int argc, char **argv)
 
 	g_test_add_func ("/datetime/timezone", test_timezone);
 
-	return g_test_run ();
+	ret = g_test_run ();
+
+	g_remove (cache_file);
+	g_rmdir (cache_dir);
+	g_free (cache_file);
+	g_free (cache_dir);
+
+	return ret;
 }
@@ -29,6 +29,7 @@
 #include <time.h>
 #include <math.h>
 #include <string.h>
+#include <sys/stat.h>
 #include "tz.h"
 #include "cc-datetime-resources.h"
 
@@ -40,6 +41,8 @@ static int compare_country_names (const void *a, const void *b);
 static void sort_locations_by_country (GPtrArray *locations);
 static gchar * tz_data_file_get (void);
 static void load_backward_tz (TzDB *tz_db);
+static TzDB * tz_db_load_from_cache (const gchar *tz_data_file);
+static void tz_db_save_to_cache (TzDB *tz_db, const gchar *tz_data_file);
 
 /* ---------------- *
  * Public interface *
@@ -57,6 +60,15 @@ tz_load_db (void)
 		g_warning ("Could not get the TimeZone data file name");
 		return NULL;
 	}
+
+	/* Skip parsing entirely if the tzdata didn't change since
+	 * the last time we saw it */
+	tz_db = tz_db_load_from_cache (tz_data_file);
+	if (tz_db) {
+		g_free (tz_data_file);
+		return tz_db;
+	}
+
 	tzfile = fopen (tz_data_file, "r");
 	if (!tzfile) {
 		g_warning ("Could not open *%s*\n", tz_data_file);
@@ -85,7 +97,7 @@ tz_load_db (void)
 		*p = '\0';
 		
 		loc = g_new0 (TzLocation, 1);
-		loc->country = g_strdup (tmpstrarr[0]);
+		loc->country = (gchar *) g_intern_string (tmpstrarr[0]);
 		loc->zone = g_strdup (tmpstrarr[2]);
 		loc->latitude  = convert_pos (latstr, 2);
 		loc->longitude = convert_pos (lngstr, 3);
@@ -99,7 +111,7 @@ tz_load_db (void)
 
 			/* duplicate entry */
 			locgrp = g_new0 (TzLocation, 1);
-			locgrp->country = g_strdup (tmpstrarr[0]);
+			locgrp->country = (gchar *) g_intern_string (tmpstrarr[0]);
 			locgrp->zone = g_strdup (tmpstrarr[3]);
 			locgrp->latitude  = convert_pos (latstr, 2);
 			locgrp->longitude = convert_pos (lngstr, 3);
@@ -123,18 +135,20 @@ tz_load_db (void)
 	/* now sort by country */
 	sort_locations_by_country (tz_db->locations);
 	
-	g_free (tz_data_file);
-
 	/* Load up the hashtable of backward links */
 	load_backward_tz (tz_db);
 
+	tz_db_save_to_cache (tz_db, tz_data_file);
+
+	g_free (tz_data_file);
+
 	return tz_db;
 }
 
 static void
 tz_location_free (TzLocation *loc)
 {
-	g_free (loc->country);
+	/* loc->country is interned */
 	g_free (loc->zone);
 	g_free (loc->comment);
 
@@ -185,66 +199,128 @@ tz_location_get_position (TzLocation *loc, double *longitude, double *latitude)
 	*latitude = loc->latitude;
 }
 
+/* GTimeZone reads the TZif data itself and is immutable, so unlike
+ * localtime() with a swapped $TZ, it can be used from any thread.
+ * Keep one per zone around so that its transitions are only parsed
+ * once. */
+G_LOCK_DEFINE_STATIC (time_zones);
+static GHashTable *time_zones = NULL;
+
+static GTimeZone *
+tz_location_get_time_zone (TzLocation *loc)
+{
+	GTimeZone *tz;
+
+	G_LOCK (time_zones);
+
+	if (time_zones == NULL)
+		time_zones = g_hash_table_new_full (g_str_hash, g_str_equal,
+						    g_free,
+						    (GDestroyNotify) g_time_zone_unref);
+
+	tz = g_hash_table_lookup (time_zones, loc->zone);
+	if (tz == NULL) {
+		tz = g_time_zone_new (loc->zone);
+		g_hash_table_insert (time_zones, g_strdup (loc->zone), tz);
+	}
+	g_time_zone_ref (tz);
+
+	G_UNLOCK (time_zones);
+
+	return tz;
+}
+
 glong
 tz_location_get_utc_offset (TzLocation *loc)
 {
-	TzInfo *tz_info;
+	return tz_location_get_utc_offset_at_time (loc, g_get_real_time () / G_USEC_PER_SEC, NULL);
+}
+
+glong
+tz_location_get_utc_offset_at_time (TzLocation *loc,
+				    gint64      time,
+				    gboolean   *daylight)
+{
+	GTimeZone *tz;
+	gint interval;
 	glong offset;
 
-	tz_info = tz_info_from_location (loc);
-	offset = tz_info->utc_offset;
-	tz_info_free (tz_info);
+	g_return_val_if_fail (loc != NULL, 0);
+	g_return_val_if_fail (loc->zone != NULL, 0);
+
+	tz = tz_location_get_time_zone (loc);
+	interval = g_time_zone_find_interval (tz, G_TIME_TYPE_UNIVERSAL, time);
+	offset = g_time_zone_get_offset (tz, interval);
+	if (daylight)
+		*daylight = g_time_zone_is_dst (tz, interval);
+	g_time_zone_unref (tz);
+
 	return offset;
 }
 
+/* Returns @interval, the one @time falls in, if its daylight savings
+ * state is @dst, or else the first interval in the following year
+ * whose state is. GTimeZone can't list its transitions, so this probes
+ * a month at a time. */
+static gint
+tz_find_interval_with_dst (GTimeZone *tz,
+			   gint       interval,
+			   gint64     time,
+			   gboolean   dst)
+{
+	gint i;
+
+	if (!g_time_zone_is_dst (tz, interval) == !dst)
+		return interval;
+
+	for (i = 1; i <= 12; i++) {
+		interval = g_time_zone_find_interval (tz, G_TIME_TYPE_UNIVERSAL,
+						      time + i * 31 * 24 * 60 * 60);
+		if (interval >= 0 && !g_time_zone_is_dst (tz, interval) == !dst)
+			return interval;
+	}
+
+	return -1;
+}
+
 TzInfo *
 tz_info_from_location (TzLocation *loc)
+{
+	return tz_info_from_location_at_time (loc, g_get_real_time () / G_USEC_PER_SEC);
+}
+
+TzInfo *
+tz_info_from_location_at_time (TzLocation *loc,
+			       gint64      time)
 {
 	TzInfo *tzinfo;
-	time_t curtime;
-	struct tm *curzone;
-	gchar *tz_env_value;
-	
+	GTimeZone *tz;
+	gint interval, normal_interval, daylight_interval;
+
 	g_return_val_if_fail (loc != NULL, NULL);
 	g_return_val_if_fail (loc->zone != NULL, NULL);
-	
-	tz_env_value = g_strdup (getenv ("TZ"));
-	setenv ("TZ", loc->zone, 1);
-	
-#if 0
-	tzset ();
-#endif
-	tzinfo = g_new0 (TzInfo, 1);
 
-	curtime = time (NULL);
-	curzone = localtime (&curtime);
+	tz = tz_location_get_time_zone (loc);
+	interval = g_time_zone_find_interval (tz, G_TIME_TYPE_UNIVERSAL, time);
 
-#ifndef __sun
-	/* Currently this solution doesnt seem to work - I get that */
-	/* America/Phoenix uses daylight savings, which is wrong    */
-	tzinfo->tzname_normal = g_strdup (curzone->tm_zone);
-	if (curzone->tm_isdst) 
-		tzinfo->tzname_daylight =
-			g_strdup (&curzone->tm_zone[curzone->tm_isdst]);
+	tzinfo = g_new0 (TzInfo, 1);
+	tzinfo->daylight = g_time_zone_is_dst (tz, interval);
+	tzinfo->utc_offset = g_time_zone_get_offset (tz, interval);
+
+	/* Zones that never switch only have a normal name */
+	normal_interval = tz_find_interval_with_dst (tz, interval, time, FALSE);
+	if (normal_interval < 0)
+		normal_interval = interval;
+	tzinfo->tzname_normal = g_strdup (g_time_zone_get_abbreviation (tz, normal_interval));
+
+	daylight_interval = tz_find_interval_with_dst (tz, interval, time, TRUE);
+	if (daylight_interval >= 0)
+		tzinfo->tzname_daylight = g_strdup (g_time_zone_get_abbreviation (tz, daylight_interval));
 	else
 		tzinfo->tzname_daylight = NULL;
 
-	tzinfo->utc_offset = curzone->tm_gmtoff;
-#else
-	tzinfo->tzname_normal = NULL;
-	tzinfo->tzname_daylight = NULL;
-	tzinfo->utc_offset = 0;
-#endif
-
-	tzinfo->daylight = curzone->tm_isdst;
-
-	if (tz_env_value)
-		setenv ("TZ", tz_env_value, 1);
-	else
-		unsetenv ("TZ");
+	g_time_zone_unref (tz);
 
-	g_free (tz_env_value);
-	
 	return tzinfo;
 }
 
@@ -259,6 +335,26 @@ tz_info_free (TzInfo *tzinfo)
 	g_free (tzinfo);
 }
 
+/* The tests use these so that they neither depend on the system's
+ * tzdata nor write to the user's cache directory. NULL goes back to
+ * the defaults. */
+static gchar *tz_data_file_override = NULL;
+static gchar *tz_cache_file_override = NULL;
+
+void
+tz_set_data_file (const gchar *tz_data_file)
+{
+	g_free (tz_data_file_override);
+	tz_data_file_override = g_strdup (tz_data_file);
+}
+
+void
+tz_set_cache_file (const gchar *cache_file)
+{
+	g_free (tz_cache_file_override);
+	tz_cache_file_override = g_strdup (cache_file);
+}
+
 struct {
 	const char *orig;
 	const char *dest;
@@ -356,11 +452,187 @@ tz_info_get_clean_name (TzDB *tz_db,
  * Private functions *
  * ----------------- */
 
+#define BACKWARD_RESOURCE	"/org/gnome/control-center/datetime/backward"
+
+/* The cache is the serialised form of the TzDB, stamped with what
+ * it was generated from so that it is thrown away as soon as tzdata
+ * is upgraded. GVariant is native-endian, which is fine for a file
+ * that lives in the user's cache directory. */
+#define TZ_CACHE_VERSION	1
+#define TZ_CACHE_FORMAT		"(uttta(sddsms)a{ss})"
+
+static gchar *
+tz_cache_file_get (void)
+{
+	if (tz_cache_file_override)
+		return g_strdup (tz_cache_file_override);
+
+	return g_build_filename (g_get_user_cache_dir (),
+				 "gnome-control-center",
+				 "timezones.cache",
+				 NULL);
+}
+
+static gboolean
+tz_cache_get_stamps (const gchar *tz_data_file,
+		     guint64     *mtime,
+		     guint64     *size,
+		     guint64     *backward_size)
+{
+	struct stat st;
+	gsize res_size;
+
+	if (stat (tz_data_file, &st) != 0)
+		return FALSE;
+
+	if (!g_resources_get_info (BACKWARD_RESOURCE,
+				   G_RESOURCE_LOOKUP_FLAGS_NONE,
+				   &res_size, NULL, NULL))
+		return FALSE;
+
+	*mtime = st.st_mtime;
+	*size = st.st_size;
+	*backward_size = res_size;
+
+	return TRUE;
+}
+
+static TzDB *
+tz_db_load_from_cache (const gchar *tz_data_file)
+{
+	gchar *cache_file;
+	GMappedFile *mapped;
+	GBytes *bytes;
+	GVariant *cache;
+	GVariantIter *locations, *backward;
+	guint32 version;
+	guint64 mtime, size, backward_size;
+	guint64 cached_mtime, cached_size, cached_backward_size;
+	const gchar *country, *zone, *comment, *alias, *real;
+	gdouble latitude, longitude;
+	TzDB *tz_db;
+
+	if (!tz_cache_get_stamps (tz_data_file, &mtime, &size, &backward_size))
+		return NULL;
+
+	cache_file = tz_cache_file_get ();
+	mapped = g_mapped_file_new (cache_file, FALSE, NULL);
+	g_free (cache_file);
+	if (!mapped)
+		return NULL;
+
+	bytes = g_mapped_file_get_bytes (mapped);
+	g_mapped_file_unref (mapped);
+	cache = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (TZ_CACHE_FORMAT),
+							      bytes, FALSE));
+	g_bytes_unref (bytes);
+
+	g_variant_get (cache, TZ_CACHE_FORMAT,
+		       &version, &cached_mtime, &cached_size, &cached_backward_size,
+		       &locations, &backward);
+
+	tz_db = NULL;
+
+	if (version != TZ_CACHE_VERSION ||
+	    cached_mtime != mtime ||
+	    cached_size != size ||
+	    cached_backward_size != backward_size ||
+	    g_variant_iter_n_children (locations) == 0)
+		goto out;
+
+	tz_db = g_new0 (TzDB, 1);
+	tz_db->locations = g_ptr_array_sized_new (g_variant_iter_n_children (locations));
+	tz_db->backward = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	/* Locations were stored already sorted */
+	while (g_variant_iter_next (locations, "(&sdd&sm&s)",
+				    &country, &latitude, &longitude, &zone, &comment)) {
+		TzLocation *loc;
+
+		loc = g_new0 (TzLocation, 1);
+		loc->country = (gchar *) g_intern_string (country);
+		loc->latitude = latitude;
+		loc->longitude = longitude;
+		loc->zone = g_strdup (zone);
+		loc->comment = g_strdup (comment);
+
+		g_ptr_array_add (tz_db->locations, loc);
+	}
+
+	while (g_variant_iter_next (backward, "{&s&s}", &alias, &real))
+		g_hash_table_insert (tz_db->backward, g_strdup (alias), g_strdup (real));
+
+out:
+	g_variant_iter_free (locations);
+	g_variant_iter_free (backward);
+	g_variant_unref (cache);
+
+	return tz_db;
+}
+
+static void
+tz_db_save_to_cache (TzDB        *tz_db,
+		     const gchar *tz_data_file)
+{
+	GVariantBuilder locations, backward;
+	GHashTableIter iter;
+	gpointer alias, real;
+	guint64 mtime, size, backward_size;
+	GVariant *cache;
+	gchar *cache_file, *cache_dir;
+	GError *error = NULL;
+	guint i;
+
+	if (!tz_cache_get_stamps (tz_data_file, &mtime, &size, &backward_size))
+		return;
+
+	g_variant_builder_init (&locations, G_VARIANT_TYPE ("a(sddsms)"));
+	for (i = 0; i < tz_db->locations->len; i++) {
+		TzLocation *loc = tz_db->locations->pdata[i];
+
+		g_variant_builder_add (&locations, "(sddsms)",
+				       loc->country,
+				       loc->latitude,
+				       loc->longitude,
+				       loc->zone,
+				       loc->comment);
+	}
+
+	g_variant_builder_init (&backward, G_VARIANT_TYPE ("a{ss}"));
+	g_hash_table_iter_init (&iter, tz_db->backward);
+	while (g_hash_table_iter_next (&iter, &alias, &real))
+		g_variant_builder_add (&backward, "{ss}", alias, real);
+
+	cache = g_variant_ref_sink (g_variant_new (TZ_CACHE_FORMAT,
+						   (guint32) TZ_CACHE_VERSION,
+						   mtime, size, backward_size,
+						   &locations, &backward));
+
+	cache_file = tz_cache_file_get ();
+	cache_dir = g_path_get_dirname (cache_file);
+	g_mkdir_with_parents (cache_dir, 0700);
+
+	if (!g_file_set_contents (cache_file,
+				  g_variant_get_data (cache),
+				  g_variant_get_size (cache),
+				  &error)) {
+		g_debug ("Could not write timezone cache: %s", error->message);
+		g_error_free (error);
+	}
+
+	g_free (cache_dir);
+	g_free (cache_file);
+	g_variant_unref (cache);
+}
+
 static gchar *
 tz_data_file_get (void)
 {
 	gchar *file;
 
+	if (tz_data_file_override)
+		return g_strdup (tz_data_file_override);
+
 	file = g_strdup (TZ_DATA_FILE);
 
 	return file;
@@ -434,7 +706,7 @@ load_backward_tz (TzDB *tz_db)
 
   tz_db->backward = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 
-  bytes = g_resources_lookup_data ("/org/gnome/control-center/datetime/backward",
+  bytes = g_resources_lookup_data (BACKWARD_RESOURCE,
                                    G_RESOURCE_LOOKUP_FLAGS_NONE, NULL);
   contents = (const char *) g_bytes_get_data (bytes, NULL);
 
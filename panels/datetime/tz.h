@@ -81,8 +81,16 @@ char      *tz_location_get_country    (TzLocation *loc);
 gchar     *tz_location_get_zone       (TzLocation *loc);
 gchar     *tz_location_get_comment    (TzLocation *loc);
 glong      tz_location_get_utc_offset (TzLocation *loc);
+glong      tz_location_get_utc_offset_at_time (TzLocation *loc,
+					       gint64      time,
+					       gboolean   *daylight);
 gint       tz_location_set_locally    (TzLocation *loc);
 TzInfo    *tz_info_from_location      (TzLocation *loc);
+TzInfo    *tz_info_from_location_at_time (TzLocation *loc,
+					  gint64      time);
 void       tz_info_free               (TzInfo *tz_info);
 
+void       tz_set_data_file           (const gchar *tz_data_file);
+void       tz_set_cache_file          (const gchar *cache_file);
+
 #endif
@@ -22,6 +22,7 @@
 
 #include <gtk/gtk.h>
 #include "scrollarea.h"
+#include "cc-display-snap.h"
 #define GNOME_DESKTOP_USE_UNSTABLE_API
 #include <libgnome-desktop/gnome-rr.h>
 #include <libgnome-desktop/gnome-rr-config.h>
@@ -67,6 +68,14 @@ struct _CcDisplayPanelPrivate
   GnomeRRConfig     *current_configuration;
   GnomeRROutputInfo *current_output;
 
+  /* What the screen is actually set to, only refreshed when it changes.
+   * The full configuration is only needed when an edited one hashes the
+   * same, so it is built on demand */
+  GnomeRRConfig     *applied_configuration;
+  GHashTable        *applied_primaries;
+  gboolean           applied_clone;
+  guint              applied_hash;
+
   GnomeBG *background;
   GnomeDesktopThumbnailFactory *thumbnail_factory;
 
@@ -102,6 +111,7 @@ typedef struct
   int grab_y;
   int output_x;
   int output_y;
+  CcDisplaySnap *snap;
 } GrabInfo;
 
 static GHashTable *output_ids;
@@ -238,6 +248,8 @@ cc_display_panel_dispose (GObject *object)
     }
 
   g_clear_object (&priv->screen);
+  g_clear_object (&priv->applied_configuration);
+  g_clear_pointer (&priv->applied_primaries, g_hash_table_destroy);
   g_clear_object (&priv->up_client);
   g_clear_object (&priv->background);
   g_clear_object (&priv->thumbnail_factory);
@@ -436,6 +448,128 @@ paint_output (CcDisplayPanel    *panel,
     }
 }
 
+typedef struct
+{
+  cairo_surface_t *surface;
+  gint             width;
+  gint             height;
+  gint             scale_factor;
+  gint             output_width;
+  gint             output_height;
+  GnomeRRRotation  rotation;
+  gint             num;
+  gboolean         active;
+  gboolean         primary;
+  gboolean         clone;
+} PreviewTile;
+
+#define MAX_PREVIEW_TILES 32
+
+static void
+preview_tile_free (gpointer data)
+{
+  PreviewTile *tile = data;
+
+  cairo_surface_destroy (tile->surface);
+  g_free (tile);
+}
+
+/* Rendering a preview means scaling the background down, so each
+ * widget keeps the previews it has drawn, keyed on everything
+ * paint_output() looks at.
+ */
+static void
+paint_output_cached (CcDisplayPanel    *panel,
+                     GtkWidget         *widget,
+                     cairo_t           *cr,
+                     GnomeRRConfig     *configuration,
+                     GnomeRROutputInfo *output,
+                     gint               num,
+                     gint               allocated_width,
+                     gint               allocated_height)
+{
+  GPtrArray *tiles;
+  PreviewTile *tile = NULL;
+  gboolean active, primary, clone;
+  gint output_width, output_height;
+  GnomeRRRotation rotation;
+  gint scale_factor;
+  guint i;
+
+  if (allocated_width <= 0 || allocated_height <= 0)
+    return;
+
+  /* The tiles are rendered at the scale of the monitor the window is on */
+  scale_factor = gtk_widget_get_scale_factor (widget);
+
+  /* The rotated size of the output sets the aspect ratio of the preview */
+  get_geometry (output, NULL, NULL, &output_width, &output_height);
+  rotation = gnome_rr_output_info_get_rotation (output);
+
+  active = gnome_rr_output_info_is_active (output);
+  primary = gnome_rr_output_info_get_primary (output);
+  clone = gnome_rr_config_get_clone (configuration);
+
+  tiles = g_object_get_data (G_OBJECT (widget), "preview-tiles");
+  if (tiles == NULL)
+    {
+      tiles = g_ptr_array_new_with_free_func (preview_tile_free);
+      g_object_set_data_full (G_OBJECT (widget), "preview-tiles",
+                              tiles, (GDestroyNotify) g_ptr_array_unref);
+    }
+
+  for (i = 0; i < tiles->len; i++)
+    {
+      PreviewTile *t = g_ptr_array_index (tiles, i);
+
+      if (t->width == allocated_width && t->height == allocated_height &&
+          t->scale_factor == scale_factor &&
+          t->output_width == output_width && t->output_height == output_height &&
+          t->rotation == rotation &&
+          t->num == num && t->active == active &&
+          t->primary == primary && t->clone == clone)
+        {
+          tile = t;
+          break;
+        }
+    }
+
+  if (tile == NULL)
+    {
+      cairo_t *tile_cr;
+
+      if (tiles->len >= MAX_PREVIEW_TILES)
+        g_ptr_array_set_size (tiles, 0);
+
+      tile = g_new0 (PreviewTile, 1);
+      tile->width = allocated_width;
+      tile->height = allocated_height;
+      tile->scale_factor = scale_factor;
+      tile->output_width = output_width;
+      tile->output_height = output_height;
+      tile->rotation = rotation;
+      tile->num = num;
+      tile->active = active;
+      tile->primary = primary;
+      tile->clone = clone;
+      tile->surface = gdk_window_create_similar_image_surface (gtk_widget_get_window (widget),
+                                                               CAIRO_FORMAT_ARGB32,
+                                                               allocated_width * scale_factor,
+                                                               allocated_height * scale_factor,
+                                                               scale_factor);
+
+      tile_cr = cairo_create (tile->surface);
+      paint_output (panel, tile_cr, configuration, output, num,
+                    allocated_width, allocated_height);
+      cairo_destroy (tile_cr);
+
+      g_ptr_array_add (tiles, tile);
+    }
+
+  cairo_set_source_surface (cr, tile->surface, 0, 0);
+  cairo_paint (cr);
+}
+
 static gboolean
 display_preview_draw (GtkWidget      *widget,
                       cairo_t        *cr,
@@ -452,7 +586,7 @@ display_preview_draw (GtkWidget      *widget,
   width = gtk_widget_get_allocated_width (widget);
   height = gtk_widget_get_allocated_height (widget);
 
-  paint_output (panel, cr, config, output, num, width, height);
+  paint_output_cached (panel, widget, cr, config, output, num, width, height);
 
   return TRUE;
 }
@@ -484,6 +618,71 @@ display_preview_new (CcDisplayPanel    *panel,
   return area;
 }
 
+/* Only covers what update_apply_button() compares, so that equal
+ * configurations always hash the same */
+static guint
+config_hash (GnomeRRConfig *config)
+{
+  GnomeRROutputInfo **outputs;
+  guint hash;
+  int i;
+
+  hash = gnome_rr_config_get_clone (config);
+
+  outputs = gnome_rr_config_get_outputs (config);
+  for (i = 0; outputs[i]; i++)
+    {
+      guint h;
+
+      h = g_str_hash (gnome_rr_output_info_get_name (outputs[i]));
+      h = h * 31 + gnome_rr_output_info_get_primary (outputs[i]);
+      h = h * 31 + gnome_rr_output_info_is_active (outputs[i]);
+
+      if (gnome_rr_output_info_is_active (outputs[i]))
+        {
+          int x, y, width, height;
+
+          gnome_rr_output_info_get_geometry (outputs[i], &x, &y, &width, &height);
+          h = h * 31 + x;
+          h = h * 31 + y;
+          h = h * 31 + width;
+          h = h * 31 + height;
+          h = h * 31 + gnome_rr_output_info_get_refresh_rate (outputs[i]);
+          h = h * 31 + gnome_rr_output_info_get_rotation (outputs[i]);
+        }
+
+      /* Don't depend on the order of the outputs */
+      hash += h;
+    }
+
+  return hash;
+}
+
+static void
+update_applied_configuration (CcDisplayPanel *panel,
+                              GnomeRRConfig  *applied)
+{
+  CcDisplayPanelPrivate *priv = panel->priv;
+  GnomeRROutputInfo **outputs;
+  int i;
+
+  g_clear_object (&priv->applied_configuration);
+
+  if (priv->applied_primaries == NULL)
+    priv->applied_primaries = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  else
+    g_hash_table_remove_all (priv->applied_primaries);
+
+  outputs = gnome_rr_config_get_outputs (applied);
+  for (i = 0; outputs[i]; i++)
+    g_hash_table_insert (priv->applied_primaries,
+                         g_strdup (gnome_rr_output_info_get_name (outputs[i])),
+                         GINT_TO_POINTER (gnome_rr_output_info_get_primary (outputs[i])));
+
+  priv->applied_clone = gnome_rr_config_get_clone (applied);
+  priv->applied_hash = config_hash (applied);
+}
+
 static void
 on_screen_changed (CcDisplayPanel *panel)
 {
@@ -501,6 +700,10 @@ on_screen_changed (CcDisplayPanel *panel)
   gnome_rr_screen_refresh (priv->screen, NULL);
 
   current = gnome_rr_config_new_current (priv->screen, NULL);
+
+  /* Before it gets edited, this is what the screen is set to */
+  update_applied_configuration (panel, current);
+
   gnome_rr_config_ensure_primary (current);
 
   gtk_container_foreach (GTK_CONTAINER (priv->displays_listbox),
@@ -812,339 +1015,68 @@ compute_scale (CcDisplayPanel *self, FooScrollArea *area)
   return MIN ((double)available_w / total_w, (double)available_h / total_h);
 }
 
-typedef struct Edge
-{
-  GnomeRROutputInfo *output;
-  int x1, y1;
-  int x2, y2;
-} Edge;
-
-typedef struct Snap
-{
-  Edge *snapper;              /* Edge that should be snapped */
-  Edge *snappee;
-  int dy, dx;
-} Snap;
-
-static void
-add_edge (GnomeRROutputInfo *output, int x1, int y1, int x2, int y2, GArray *edges)
-{
-  Edge e;
-
-  e.x1 = x1;
-  e.x2 = x2;
-  e.y1 = y1;
-  e.y2 = y2;
-  e.output = output;
-
-  g_array_append_val (edges, e);
-}
-
-static void
-list_edges_for_output (GnomeRROutputInfo *output, GArray *edges)
+/* How the arrangement preview maps outputs onto the canvas */
+typedef struct
 {
-  int x, y, w, h;
-
-  get_geometry (output, &x, &y, &w, &h);
-
-  /* Top, Bottom, Left, Right */
-  add_edge (output, x, y, x + w, y, edges);
-  add_edge (output, x, y + h, x + w, y + h, edges);
-  add_edge (output, x, y, x, y + h, edges);
-  add_edge (output, x + w, y, x + w, y + h, edges);
-}
+  double       scale;
+  int          total_w;
+  int          total_h;
+  GdkRectangle viewport;
+} PreviewLayout;
 
 static void
-list_edges (GnomeRRConfig *config, GArray *edges)
+get_preview_layout (CcDisplayPanel *self,
+                    FooScrollArea  *area,
+                    PreviewLayout  *layout)
 {
-  int i;
-  GnomeRROutputInfo **outputs = gnome_rr_config_get_outputs (config);
-
-  for (i = 0; outputs[i]; ++i)
-    {
-      if (gnome_rr_output_info_is_connected (outputs[i]))
-	{
-	  if (!gnome_rr_output_info_is_primary_tile (outputs[i]))
-	    continue;
-	  list_edges_for_output (outputs[i], edges);
-	}
-    }
-}
+  GList *connected_outputs;
 
-static gboolean
-overlap (int s1, int e1, int s2, int e2)
-{
-  return (!(e1 < s2 || s1 >= e2));
-}
+  layout->scale = compute_scale (self, area);
 
-static gboolean
-horizontal_overlap (Edge *snapper, Edge *snappee)
-{
-  if (snapper->y1 != snapper->y2 || snappee->y1 != snappee->y2)
-    return FALSE;
+  connected_outputs = list_connected_outputs (self, &layout->total_w, &layout->total_h);
+  g_list_free (connected_outputs);
 
-  return overlap (snapper->x1, snapper->x2, snappee->x1, snappee->x2);
+  foo_scroll_area_get_viewport (area, &layout->viewport);
+  layout->viewport.height -= 2 * MARGIN;
+  layout->viewport.width -= 2 * MARGIN;
 }
 
 static gboolean
-vertical_overlap (Edge *snapper, Edge *snappee)
+preview_layout_equal (const PreviewLayout *a,
+                      const PreviewLayout *b)
 {
-  if (snapper->x1 != snapper->x2 || snappee->x1 != snappee->x2)
-    return FALSE;
-
-  return overlap (snapper->y1, snapper->y2, snappee->y1, snappee->y2);
-}
-
-static void
-add_snap (GArray *snaps, Snap snap)
-{
-  if (ABS (snap.dx) <= 200 || ABS (snap.dy) <= 200)
-    g_array_append_val (snaps, snap);
-}
-
-static void
-add_edge_snaps (Edge *snapper, Edge *snappee, GArray *snaps)
-{
-  Snap snap;
-
-  snap.snapper = snapper;
-  snap.snappee = snappee;
-
-  if (horizontal_overlap (snapper, snappee))
-    {
-      snap.dx = 0;
-      snap.dy = snappee->y1 - snapper->y1;
-
-      add_snap (snaps, snap);
-    }
-  else if (vertical_overlap (snapper, snappee))
-    {
-      snap.dy = 0;
-      snap.dx = snappee->x1 - snapper->x1;
-
-      add_snap (snaps, snap);
-    }
-
-  /* Corner snaps */
-  /* 1->1 */
-  snap.dx = snappee->x1 - snapper->x1;
-  snap.dy = snappee->y1 - snapper->y1;
-
-  add_snap (snaps, snap);
-
-  /* 1->2 */
-  snap.dx = snappee->x2 - snapper->x1;
-  snap.dy = snappee->y2 - snapper->y1;
-
-  add_snap (snaps, snap);
-
-  /* 2->2 */
-  snap.dx = snappee->x2 - snapper->x2;
-  snap.dy = snappee->y2 - snapper->y2;
-
-  add_snap (snaps, snap);
-
-  /* 2->1 */
-  snap.dx = snappee->x1 - snapper->x2;
-  snap.dy = snappee->y1 - snapper->y2;
-
-  add_snap (snaps, snap);
-}
-
-static void
-list_snaps (GnomeRROutputInfo *output, GArray *edges, GArray *snaps)
-{
-  int i;
-
-  for (i = 0; i < edges->len; ++i)
-    {
-      Edge *output_edge = &(g_array_index (edges, Edge, i));
-
-      if (output_edge->output == output)
-        {
-          int j;
-
-          for (j = 0; j < edges->len; ++j)
-            {
-              Edge *edge = &(g_array_index (edges, Edge, j));
-
-              if (edge->output != output)
-                add_edge_snaps (output_edge, edge, snaps);
-            }
-        }
-    }
+  return a->scale == b->scale &&
+         a->total_w == b->total_w &&
+         a->total_h == b->total_h &&
+         gdk_rectangle_equal (&a->viewport, &b->viewport);
 }
 
-#if 0
 static void
-print_edge (Edge *edge)
-{
-  g_debug ("(%d %d %d %d)", edge->x1, edge->y1, edge->x2, edge->y2);
-}
-#endif
-
-static gboolean
-corner_on_edge (int x, int y, Edge *e)
+get_output_preview_position (GnomeRROutputInfo   *output,
+                             const PreviewLayout *layout,
+                             int                 *x,
+                             int                 *y)
 {
-  if (x == e->x1 && x == e->x2 && y >= e->y1 && y <= e->y2)
-    return TRUE;
-
-  if (y == e->y1 && y == e->y2 && x >= e->x1 && x <= e->x2)
-    return TRUE;
-
-  return FALSE;
-}
-
-static gboolean
-edges_align (Edge *e1, Edge *e2)
-{
-  if (corner_on_edge (e1->x1, e1->y1, e2))
-    return TRUE;
+  int output_x, output_y;
 
-  if (corner_on_edge (e2->x1, e2->y1, e1))
-    return TRUE;
-
-  return FALSE;
-}
-
-static gboolean
-output_is_aligned (GnomeRROutputInfo *output, GArray *edges)
-{
-  gboolean result = FALSE;
-  int i;
-
-  for (i = 0; i < edges->len; ++i)
-    {
-      Edge *output_edge = &(g_array_index (edges, Edge, i));
-
-      if (output_edge->output == output)
-        {
-          int j;
-
-          for (j = 0; j < edges->len; ++j)
-            {
-              Edge *edge = &(g_array_index (edges, Edge, j));
-
-              /* We are aligned if an output edge matches
-               * an edge of another output
-               */
-              if (edge->output != output_edge->output)
-                {
-                  if (edges_align (output_edge, edge))
-                    {
-                      result = TRUE;
-                      goto done;
-                    }
-                }
-            }
-        }
-    }
- done:
+  get_geometry (output, &output_x, &output_y, NULL, NULL);
 
-  return result;
+  *x = output_x * layout->scale + MARGIN + (layout->viewport.width - layout->total_w * layout->scale) / 2.0;
+  *y = output_y * layout->scale + MARGIN + (layout->viewport.height - layout->total_h * layout->scale) / 2.0;
 }
 
+/* The area of the canvas that on_area_paint() draws @output on */
 static void
-get_output_rect (GnomeRROutputInfo *output, GdkRectangle *rect)
-{
-  get_geometry (output, &rect->x, &rect->y, &rect->width, &rect->height);
-}
-
-static gboolean
-output_overlaps (GnomeRROutputInfo *output, GnomeRRConfig *config)
+get_output_preview_rect (GnomeRROutputInfo   *output,
+                         const PreviewLayout *layout,
+                         GdkRectangle        *rect)
 {
-  int i;
-  GdkRectangle output_rect;
-  GnomeRROutputInfo **outputs;
-
-  g_assert (output != NULL);
-
-  get_output_rect (output, &output_rect);
-
-  outputs = gnome_rr_config_get_outputs (config);
-  for (i = 0; outputs[i]; ++i)
-    {
-      if (!gnome_rr_output_info_is_primary_tile (outputs[i]))
-	continue;
-      if (outputs[i] != output && gnome_rr_output_info_is_connected (outputs[i]))
-	{
-	  GdkRectangle other_rect;
+  int w, h;
 
-	  get_output_rect (outputs[i], &other_rect);
-	  if (gdk_rectangle_intersect (&output_rect, &other_rect, NULL))
-	    return TRUE;
-	}
-    }
-
-  return FALSE;
-}
-
-static gboolean
-gnome_rr_config_is_aligned (GnomeRRConfig *config, GArray *edges)
-{
-  int i;
-  gboolean result = TRUE;
-  GnomeRROutputInfo **outputs;
-
-  outputs = gnome_rr_config_get_outputs (config);
-  for (i = 0; outputs[i]; ++i)
-    {
-      if (!gnome_rr_output_info_is_primary_tile (outputs[i]))
-	continue;
-      if (gnome_rr_output_info_is_connected (outputs[i]))
-	{
-	  if (!output_is_aligned (outputs[i], edges))
-	    return FALSE;
-
-	  if (output_overlaps (outputs[i], config))
-	    return FALSE;
-	}
-    }
-
-  return result;
-}
-
-static gboolean
-is_corner_snap (const Snap *s)
-{
-  return s->dx != 0 && s->dy != 0;
-}
-
-static int
-compare_snaps (gconstpointer v1, gconstpointer v2)
-{
-  const Snap *s1 = v1;
-  const Snap *s2 = v2;
-  int sv1 = MAX (ABS (s1->dx), ABS (s1->dy));
-  int sv2 = MAX (ABS (s2->dx), ABS (s2->dy));
-  int d;
-
-  d = sv1 - sv2;
-
-  /* This snapping algorithm is good enough for rock'n'roll, but
-   * this is probably a better:
-   *
-   *    First do a horizontal/vertical snap, then
-   *    with the new coordinates from that snap,
-   *    do a corner snap.
-   *
-   * Right now, it's confusing that corner snapping
-   * depends on the distance in an axis that you can't actually see.
-   *
-   */
-  if (d == 0)
-    {
-      if (is_corner_snap (s1) && !is_corner_snap (s2))
-        return -1;
-      else if (is_corner_snap (s2) && !is_corner_snap (s1))
-        return 1;
-      else
-        return 0;
-    }
-  else
-    {
-      return d;
-    }
+  get_geometry (output, NULL, NULL, &w, &h);
+  get_output_preview_position (output, layout, &rect->x, &rect->y);
+  rect->width = ceil (w * layout->scale + 0.5);
+  rect->height = ceil (h * layout->scale + 0.5);
 }
 
 /* Sets a mouse cursor for a widget's window.  As a hack, you can pass
@@ -1178,18 +1110,48 @@ grab_weak_ref_notify (gpointer  area,
   foo_scroll_area_end_grab (area, NULL);
 }
 
-static GnomeRROutputInfo *
-find_output (GnomeRROutputInfo **outputs,
-             const gchar        *name)
+static void
+grab_info_free (gpointer data)
+{
+  GrabInfo *info = data;
+
+  cc_display_snap_free (info->snap);
+  g_free (info);
+}
+
+/* The outputs that stay put while @output is dragged around */
+static CcDisplaySnap *
+create_snap_for_output (CcDisplayPanel    *self,
+                        GnomeRROutputInfo *output)
 {
+  GnomeRROutputInfo **outputs;
+  CcDisplaySnap *snap;
+  GArray *others;
+  int width, height;
   int i;
 
-  for (i = 0; outputs[i]; i++)
+  others = g_array_new (FALSE, FALSE, sizeof (GdkRectangle));
+
+  outputs = gnome_rr_config_get_outputs (self->priv->current_configuration);
+  for (i = 0; outputs[i]; ++i)
     {
-      if (g_str_equal (gnome_rr_output_info_get_name (outputs[i]), name))
-        return outputs[i];
+      GdkRectangle rect;
+
+      if (outputs[i] == output ||
+          !gnome_rr_output_info_is_connected (outputs[i]) ||
+          !gnome_rr_output_info_is_primary_tile (outputs[i]))
+        continue;
+
+      get_geometry (outputs[i], &rect.x, &rect.y, &rect.width, &rect.height);
+      g_array_append_val (others, rect);
     }
-  return NULL;
+
+  get_geometry (output, NULL, NULL, &width, &height);
+  snap = cc_display_snap_new ((GdkRectangle *) others->data, others->len, width, height);
+
+  g_array_free (others, TRUE);
+
+  return snap;
 }
 
 static void
@@ -1197,7 +1159,6 @@ update_apply_button (CcDisplayPanel *panel)
 {
   CcDisplayPanelPrivate *priv = panel->priv;
   gboolean config_equal;
-  GnomeRRConfig *current_configuration;
 
   if (!gnome_rr_config_applicable (priv->current_configuration,
                                    priv->screen, NULL))
@@ -1206,44 +1167,52 @@ update_apply_button (CcDisplayPanel *panel)
       return;
     }
 
-  current_configuration = gnome_rr_config_new_current (priv->screen, NULL);
+  /* Most edits, such as dragging an output around, will change the
+   * hash, so only do the full comparison when it looks unchanged */
+  if (config_hash (priv->current_configuration) != priv->applied_hash)
+    {
+      config_equal = FALSE;
+    }
+  else
+    {
+      if (priv->applied_configuration == NULL)
+        priv->applied_configuration = gnome_rr_config_new_current (priv->screen, NULL);
 
-  /* this checks if the same modes will be set on the outputs */
-  config_equal = gnome_rr_config_equal (priv->current_configuration,
-                                        current_configuration);
+      /* this checks if the same modes will be set on the outputs */
+      config_equal = gnome_rr_config_equal (priv->current_configuration,
+                                            priv->applied_configuration);
+    }
 
   if (config_equal)
     {
       /* check if clone state has changed */
       if (gnome_rr_config_get_clone (priv->current_configuration)
-          != gnome_rr_config_get_clone (current_configuration))
+          != priv->applied_clone)
         {
           config_equal = FALSE;
         }
       else
         {
-          GnomeRROutputInfo **new_outputs, **current_outputs;
+          GnomeRROutputInfo **new_outputs;
           int i;
 
           /* check if primary display has changed */
           new_outputs = gnome_rr_config_get_outputs (priv->current_configuration);
-          current_outputs = gnome_rr_config_get_outputs (current_configuration);
 
           for (i = 0; new_outputs[i]; i++)
             {
-              GnomeRROutputInfo *output;
-
-              output = find_output (current_outputs,
-                                    gnome_rr_output_info_get_name (new_outputs[i]));
+              gpointer primary;
 
-              if (!output)
+              if (!g_hash_table_lookup_extended (priv->applied_primaries,
+                                                 gnome_rr_output_info_get_name (new_outputs[i]),
+                                                 NULL, &primary))
                 {
                   config_equal = FALSE;
                   break;
                 }
 
               if (gnome_rr_output_info_get_primary (new_outputs[i])
-                  != gnome_rr_output_info_get_primary (output))
+                  != GPOINTER_TO_INT (primary))
                 {
                   config_equal = FALSE;
                   break;
@@ -1252,8 +1221,6 @@ update_apply_button (CcDisplayPanel *panel)
         }
     }
 
-  g_object_unref (current_configuration);
-
   gtk_dialog_set_response_sensitive (GTK_DIALOG (priv->dialog), GTK_RESPONSE_ACCEPT, !config_equal);
 }
 
@@ -1302,8 +1269,9 @@ on_output_event (FooScrollArea *area,
 	  info->grab_y = event->y;
 	  info->output_x = output_x;
 	  info->output_y = output_y;
+	  info->snap = create_snap_for_output (self, output);
 
-	  g_object_set_data (G_OBJECT (output), "grab-info", info);
+	  g_object_set_data_full (G_OBJECT (output), "grab-info", info, grab_info_free);
 	}
       foo_scroll_area_invalidate (area);
     }
@@ -1312,60 +1280,27 @@ on_output_event (FooScrollArea *area,
       if (foo_scroll_area_is_grabbed (area))
 	{
 	  GrabInfo *info = g_object_get_data (G_OBJECT (output), "grab-info");
-	  double scale = compute_scale (self, area);
-	  int old_x, old_y;
+	  PreviewLayout old_layout, new_layout;
+	  GdkRectangle old_rect, new_rect;
 	  int width, height;
 	  int new_x, new_y;
-	  int i;
-	  GArray *edges, *snaps, *new_edges;
-
-	  gnome_rr_output_info_get_geometry (output, &old_x, &old_y, &width, &height);
-	  new_x = info->output_x + (event->x - info->grab_x) / scale;
-	  new_y = info->output_y + (event->y - info->grab_y) / scale;
-
-	  gnome_rr_output_info_set_geometry (output, new_x, new_y, width, height);
-
-	  edges = g_array_new (TRUE, TRUE, sizeof (Edge));
-	  snaps = g_array_new (TRUE, TRUE, sizeof (Snap));
-	  new_edges = g_array_new (TRUE, TRUE, sizeof (Edge));
-
-	  list_edges (self->priv->current_configuration, edges);
-	  list_snaps (output, edges, snaps);
-
-	  g_array_sort (snaps, compare_snaps);
-
-	  gnome_rr_output_info_set_geometry (output, old_x, old_y, width, height);
 
-	  for (i = 0; i < snaps->len; ++i)
-	    {
-	      Snap *snap = &(g_array_index (snaps, Snap, i));
-	      GArray *new_edges = g_array_new (TRUE, TRUE, sizeof (Edge));
-
-	      gnome_rr_output_info_set_geometry (output, new_x + snap->dx, new_y + snap->dy, width, height);
-
-	      g_array_set_size (new_edges, 0);
-	      list_edges (self->priv->current_configuration, new_edges);
+	  get_preview_layout (self, area, &old_layout);
+	  get_output_preview_rect (output, &old_layout, &old_rect);
 
-	      if (gnome_rr_config_is_aligned (self->priv->current_configuration, new_edges))
-		{
-		  g_array_free (new_edges, TRUE);
-		  break;
-		}
-	      else
-		{
-		  gnome_rr_output_info_set_geometry (output, info->output_x, info->output_y, width, height);
-		}
-	    }
+	  gnome_rr_output_info_get_geometry (output, NULL, NULL, &width, &height);
+	  new_x = info->output_x + (event->x - info->grab_x) / old_layout.scale;
+	  new_y = info->output_y + (event->y - info->grab_y) / old_layout.scale;
 
-	  g_array_free (new_edges, TRUE);
-	  g_array_free (snaps, TRUE);
-	  g_array_free (edges, TRUE);
+	  if (cc_display_snap_find (info->snap, new_x, new_y, &new_x, &new_y))
+	    gnome_rr_output_info_set_geometry (output, new_x, new_y, width, height);
+	  else
+	    gnome_rr_output_info_set_geometry (output, info->output_x, info->output_y, width, height);
 
 	  if (event->type == FOO_BUTTON_RELEASE)
 	    {
 	      foo_scroll_area_end_grab (area, event);
 
-	      g_free (g_object_get_data (G_OBJECT (output), "grab-info"));
 	      g_object_set_data (G_OBJECT (output), "grab-info", NULL);
 	      g_object_weak_unref (data, grab_weak_ref_notify, area);
               update_apply_button (self);
@@ -1375,7 +1310,21 @@ on_output_event (FooScrollArea *area,
 #endif
             }
 
-          foo_scroll_area_invalidate (area);
+          /* Only the dragged output moves, unless that changed how
+           * the whole arrangement fits the preview */
+          get_preview_layout (self, area, &new_layout);
+          if (preview_layout_equal (&old_layout, &new_layout))
+            {
+              get_output_preview_rect (output, &new_layout, &new_rect);
+              gdk_rectangle_union (&old_rect, &new_rect, &new_rect);
+              foo_scroll_area_invalidate_rect (area,
+                                               new_rect.x, new_rect.y,
+                                               new_rect.width, new_rect.height);
+            }
+          else
+            {
+              foo_scroll_area_invalidate (area);
+            }
         }
     }
 }
@@ -1416,6 +1365,9 @@ on_area_paint (FooScrollArea  *area,
   CcDisplayPanel *self = data;
   GList *connected_outputs = NULL;
   GList *list;
+  PreviewLayout layout;
+  GdkRectangle clip;
+  gboolean has_clip;
 
   paint_background (area, cr);
 
@@ -1423,48 +1375,45 @@ on_area_paint (FooScrollArea  *area,
     return;
 
   connected_outputs = list_connected_outputs (self, NULL, NULL);
+  get_preview_layout (self, area, &layout);
+  has_clip = gdk_cairo_get_clip_rectangle (cr, &clip);
 
   for (list = connected_outputs; list != NULL; list = list->next)
     {
-      int w, h;
-      double scale = compute_scale (self, area);
-      gint x, y;
-      int output_x, output_y;
-      int total_w, total_h;
-      GList *connected_outputs;
       GnomeRROutputInfo *output = list->data;
-      GdkRectangle viewport;
+      GdkRectangle rect;
 
-      cairo_save (cr);
-
-      connected_outputs = list_connected_outputs (self, &total_w, &total_h);
-      g_list_free (connected_outputs);
-
-      foo_scroll_area_get_viewport (area, &viewport);
-      get_geometry (output, &output_x, &output_y, &w, &h);
+      /* Outputs outside of the area being repainted keep both their
+       * pixels and their input paths from the last time around.
+       */
+      get_output_preview_rect (output, &layout, &rect);
+      if (!has_clip || gdk_rectangle_intersect (&rect, &clip, NULL))
+        {
+          int w, h;
 
-      viewport.height -= 2 * MARGIN;
-      viewport.width -= 2 * MARGIN;
+          cairo_save (cr);
 
-      x = output_x * scale + MARGIN + (viewport.width - total_w * scale) / 2.0;
-      y = output_y * scale + MARGIN + (viewport.height - total_h * scale) / 2.0;
+          get_geometry (output, NULL, NULL, &w, &h);
 
+          cairo_set_source_rgba (cr, 0, 0, 0, 0);
+          cairo_rectangle (cr, rect.x, rect.y, w * layout.scale + 0.5, h * layout.scale + 0.5);
+          foo_scroll_area_add_input_from_fill (area, cr, on_output_event, output);
+          cairo_fill (cr);
 
-      cairo_set_source_rgba (cr, 0, 0, 0, 0);
-      cairo_rectangle (cr, x, y, w * scale + 0.5, h * scale + 0.5);
-      foo_scroll_area_add_input_from_fill (area, cr, on_output_event, output);
-      cairo_fill (cr);
+          cairo_translate (cr, rect.x, rect.y);
+          paint_output_cached (self, GTK_WIDGET (area), cr,
+                               self->priv->current_configuration, output,
+                               cc_display_panel_get_output_id (output),
+                               w * layout.scale, h * layout.scale);
 
-      cairo_translate (cr, x, y);
-      paint_output (self, cr, self->priv->current_configuration, output,
-                    cc_display_panel_get_output_id (output),
-                    w * scale, h * scale);
-
-      cairo_restore (cr);
+          cairo_restore (cr);
+        }
 
       if (gnome_rr_config_get_clone (self->priv->current_configuration))
         break;
     }
+
+  g_list_free (connected_outputs);
 }
 
 static void
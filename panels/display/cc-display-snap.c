@@ -0,0 +1,420 @@
+/*
+ * Copyright (C) 2007, 2008  Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cc-display-snap.h"
+
+/* Corner snaps are only considered when the output is this close to
+ * the corner along at least one axis.
+ */
+#define SNAP_DISTANCE 200
+
+typedef struct
+{
+  int x1, y1;
+  int x2, y2;
+} Edge;
+
+struct _CcDisplaySnap
+{
+  GdkRectangle *others;
+  guint         n_others;
+  int           width;
+  int           height;
+
+  /* Others that don't line up with any other output, so they have
+   * to line up with the dragged one.
+   */
+  gboolean     *needs_dragged;
+  gboolean      others_overlap;
+
+  /* Sorted, unique positions of the dragged output's origin that
+   * line one of its edges up with an edge of another output.
+   */
+  int          *xs;
+  guint         n_xs;
+  int          *ys;
+  guint         n_ys;
+
+  /* Scratch space for cc_display_snap_find() */
+  int          *seen_xs;
+  int          *seen_ys;
+};
+
+typedef struct
+{
+  const int *values;
+  guint      n_values;
+  int        origin;
+  guint      below;     /* values[below - 1] is the next one below origin */
+  guint      above;     /* values[above] is the next one at or above origin */
+} AxisWalk;
+
+static void
+rect_edges (const GdkRectangle *r, Edge edges[4])
+{
+  int i;
+
+  /* Top, Bottom, Left, Right */
+  for (i = 0; i < 4; i++)
+    {
+      edges[i].x1 = r->x;
+      edges[i].y1 = r->y;
+      edges[i].x2 = r->x + r->width;
+      edges[i].y2 = r->y + r->height;
+    }
+
+  edges[0].y2 = r->y;
+  edges[1].y1 = r->y + r->height;
+  edges[2].x2 = r->x;
+  edges[3].x1 = r->x + r->width;
+}
+
+static gboolean
+corner_on_edge (int x, int y, const Edge *e)
+{
+  if (x == e->x1 && x == e->x2 && y >= e->y1 && y <= e->y2)
+    return TRUE;
+
+  if (y == e->y1 && y == e->y2 && x >= e->x1 && x <= e->x2)
+    return TRUE;
+
+  return FALSE;
+}
+
+static gboolean
+rects_align (const GdkRectangle *a, const GdkRectangle *b)
+{
+  Edge edges_a[4], edges_b[4];
+  int i, j;
+
+  rect_edges (a, edges_a);
+  rect_edges (b, edges_b);
+
+  for (i = 0; i < 4; i++)
+    {
+      for (j = 0; j < 4; j++)
+        {
+          if (corner_on_edge (edges_a[i].x1, edges_a[i].y1, &edges_b[j]) ||
+              corner_on_edge (edges_b[j].x1, edges_b[j].y1, &edges_a[i]))
+            return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+/* Same as gdk_rectangle_intersect (a, b, NULL) */
+static gboolean
+rects_overlap (const GdkRectangle *a, const GdkRectangle *b)
+{
+  return a->x < b->x + b->width && b->x < a->x + a->width &&
+         a->y < b->y + b->height && b->y < a->y + a->height;
+}
+
+static int
+compare_ints (const void *p1, const void *p2)
+{
+  int i1 = *(const int *) p1;
+  int i2 = *(const int *) p2;
+
+  return (i1 > i2) - (i1 < i2);
+}
+
+static guint
+sort_unique (int *values, guint n_values)
+{
+  guint i, n;
+
+  if (n_values == 0)
+    return 0;
+
+  qsort (values, n_values, sizeof (int), compare_ints);
+
+  for (i = 1, n = 1; i < n_values; i++)
+    {
+      if (values[i] != values[n - 1])
+        values[n++] = values[i];
+    }
+
+  return n;
+}
+
+CcDisplaySnap *
+cc_display_snap_new (const GdkRectangle *others,
+                     guint               n_others,
+                     int                 width,
+                     int                 height)
+{
+  CcDisplaySnap *snap;
+  guint i, j;
+
+  snap = g_new0 (CcDisplaySnap, 1);
+  snap->others = g_new (GdkRectangle, MAX (n_others, 1));
+  if (n_others > 0)
+    memcpy (snap->others, others, n_others * sizeof (GdkRectangle));
+  snap->n_others = n_others;
+  snap->width = width;
+  snap->height = height;
+
+  snap->needs_dragged = g_new0 (gboolean, MAX (n_others, 1));
+  for (i = 0; i < n_others; i++)
+    {
+      gboolean aligned = FALSE;
+
+      for (j = 0; j < n_others; j++)
+        {
+          if (i == j)
+            continue;
+
+          if (rects_overlap (&others[i], &others[j]))
+            snap->others_overlap = TRUE;
+          if (!aligned && rects_align (&others[i], &others[j]))
+            aligned = TRUE;
+        }
+
+      snap->needs_dragged[i] = !aligned;
+    }
+
+  snap->xs = g_new (int, MAX (4 * n_others, 1));
+  snap->ys = g_new (int, MAX (4 * n_others, 1));
+  for (i = 0; i < n_others; i++)
+    {
+      const GdkRectangle *r = &others[i];
+
+      /* Our left or right edge on their left or right edge */
+      snap->xs[4 * i + 0] = r->x;
+      snap->xs[4 * i + 1] = r->x + r->width;
+      snap->xs[4 * i + 2] = r->x - width;
+      snap->xs[4 * i + 3] = r->x + r->width - width;
+
+      snap->ys[4 * i + 0] = r->y;
+      snap->ys[4 * i + 1] = r->y + r->height;
+      snap->ys[4 * i + 2] = r->y - height;
+      snap->ys[4 * i + 3] = r->y + r->height - height;
+    }
+  snap->n_xs = sort_unique (snap->xs, 4 * n_others);
+  snap->n_ys = sort_unique (snap->ys, 4 * n_others);
+
+  snap->seen_xs = g_new (int, MAX (snap->n_xs, 1));
+  snap->seen_ys = g_new (int, MAX (snap->n_ys, 1));
+
+  return snap;
+}
+
+void
+cc_display_snap_free (CcDisplaySnap *snap)
+{
+  if (snap == NULL)
+    return;
+
+  g_free (snap->others);
+  g_free (snap->needs_dragged);
+  g_free (snap->xs);
+  g_free (snap->ys);
+  g_free (snap->seen_xs);
+  g_free (snap->seen_ys);
+  g_free (snap);
+}
+
+static gboolean
+position_is_valid (CcDisplaySnap *snap, int x, int y)
+{
+  GdkRectangle rect;
+  gboolean aligned = FALSE;
+  guint i;
+
+  rect.x = x;
+  rect.y = y;
+  rect.width = snap->width;
+  rect.height = snap->height;
+
+  for (i = 0; i < snap->n_others; i++)
+    {
+      if (rects_overlap (&rect, &snap->others[i]))
+        return FALSE;
+
+      if (rects_align (&rect, &snap->others[i]))
+        aligned = TRUE;
+      else if (snap->needs_dragged[i])
+        return FALSE;
+    }
+
+  return aligned;
+}
+
+static void
+axis_walk_init (AxisWalk  *walk,
+                const int *values,
+                guint      n_values,
+                int        origin)
+{
+  guint lo = 0, hi = n_values;
+
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+
+      if (values[mid] < origin)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  walk->values = values;
+  walk->n_values = n_values;
+  walk->origin = origin;
+  walk->below = lo;
+  walk->above = lo;
+}
+
+/* Returns the distance to the next closest value, or G_MAXINT */
+static int
+axis_walk_peek (AxisWalk *walk)
+{
+  int below = G_MAXINT, above = G_MAXINT;
+
+  if (walk->below > 0)
+    below = walk->origin - walk->values[walk->below - 1];
+  if (walk->above < walk->n_values)
+    above = walk->values[walk->above] - walk->origin;
+
+  return MIN (below, above);
+}
+
+static int
+axis_walk_next (AxisWalk *walk)
+{
+  int below = G_MAXINT, above = G_MAXINT;
+
+  if (walk->below > 0)
+    below = walk->origin - walk->values[walk->below - 1];
+  if (walk->above < walk->n_values)
+    above = walk->values[walk->above] - walk->origin;
+
+  if (above <= below)
+    return walk->values[walk->above++];
+  else
+    return walk->values[--walk->below];
+}
+
+static gboolean
+try_position (CcDisplaySnap *snap,
+              int            x,
+              int            y,
+              int           *snapped_x,
+              int           *snapped_y)
+{
+  if (!position_is_valid (snap, x, y))
+    return FALSE;
+
+  *snapped_x = x;
+  *snapped_y = y;
+
+  return TRUE;
+}
+
+/* Candidates are tried in order of increasing distance, measured as
+ * the larger of the horizontal and vertical moves, with corner snaps
+ * winning over edge snaps at the same distance.  Candidate
+ * coordinates are found by binary search and then walked outwards,
+ * so only the closest ones ever get validated.
+ */
+gboolean
+cc_display_snap_find (CcDisplaySnap *snap,
+                      int            x,
+                      int            y,
+                      int           *snapped_x,
+                      int           *snapped_y)
+{
+  AxisWalk walk_x, walk_y;
+  guint n_seen_x = 0, n_seen_y = 0;
+
+  g_return_val_if_fail (snap != NULL, FALSE);
+
+  if (snap->n_others == 0)
+    {
+      *snapped_x = x;
+      *snapped_y = y;
+      return TRUE;
+    }
+
+  if (snap->others_overlap)
+    return FALSE;
+
+  axis_walk_init (&walk_x, snap->xs, snap->n_xs, x);
+  axis_walk_init (&walk_y, snap->ys, snap->n_ys, y);
+
+  for (;;)
+    {
+      guint first_x = n_seen_x, first_y = n_seen_y;
+      guint i, j;
+      int distance;
+
+      distance = MIN (axis_walk_peek (&walk_x), axis_walk_peek (&walk_y));
+      if (distance == G_MAXINT)
+        break;
+
+      while (axis_walk_peek (&walk_x) == distance)
+        snap->seen_xs[n_seen_x++] = axis_walk_next (&walk_x);
+      while (axis_walk_peek (&walk_y) == distance)
+        snap->seen_ys[n_seen_y++] = axis_walk_next (&walk_y);
+
+      /* Corners this far away pair a new coordinate with any
+       * coordinate already seen on the other axis.
+       */
+      for (i = first_x; i < n_seen_x; i++)
+        {
+          for (j = 0; j < n_seen_y; j++)
+            {
+              int sx = snap->seen_xs[i], sy = snap->seen_ys[j];
+
+              if (MIN (ABS (sx - x), ABS (sy - y)) <= SNAP_DISTANCE &&
+                  try_position (snap, sx, sy, snapped_x, snapped_y))
+                return TRUE;
+            }
+        }
+      for (j = first_y; j < n_seen_y; j++)
+        {
+          for (i = 0; i < first_x; i++)
+            {
+              int sx = snap->seen_xs[i], sy = snap->seen_ys[j];
+
+              if (MIN (ABS (sx - x), ABS (sy - y)) <= SNAP_DISTANCE &&
+                  try_position (snap, sx, sy, snapped_x, snapped_y))
+                return TRUE;
+            }
+        }
+
+      /* Then slide along a single axis */
+      for (i = first_x; i < n_seen_x; i++)
+        {
+          if (try_position (snap, snap->seen_xs[i], y, snapped_x, snapped_y))
+            return TRUE;
+        }
+      for (j = first_y; j < n_seen_y; j++)
+        {
+          if (try_position (snap, x, snap->seen_ys[j], snapped_x, snapped_y))
+            return TRUE;
+        }
+    }
+
+  return FALSE;
+}
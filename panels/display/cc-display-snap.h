@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2007, 2008  Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _CC_DISPLAY_SNAP_H
+#define _CC_DISPLAY_SNAP_H
+
+#include <gdk/gdk.h>
+
+G_BEGIN_DECLS
+
+/* Finds where an output being dragged in the arrangement preview
+ * should be dropped so that it touches, but doesn't overlap, the
+ * other outputs.  The other outputs don't move during a drag, so
+ * their edges are indexed once when the grab starts.
+ */
+typedef struct _CcDisplaySnap CcDisplaySnap;
+
+CcDisplaySnap *cc_display_snap_new  (const GdkRectangle *others,
+                                     guint               n_others,
+                                     int                 width,
+                                     int                 height);
+void           cc_display_snap_free (CcDisplaySnap      *snap);
+gboolean       cc_display_snap_find (CcDisplaySnap      *snap,
+                                     int                 x,
+                                     int                 y,
+                                     int                *snapped_x,
+                                     int                *snapped_y);
+
+G_END_DECLS
+
+#endif /* _CC_DISPLAY_SNAP_H */
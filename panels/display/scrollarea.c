@@ -26,15 +26,22 @@ static GtkWidgetClass *parent_class;
 typedef struct BackingStore BackingStore;
 
 typedef struct InputPath InputPath;
+typedef struct Box Box;
 typedef struct InputRegion InputRegion;
 typedef struct AutoScrollInfo AutoScrollInfo;
 
+struct Box
+{
+  double x1, y1, x2, y2;
+};
+
 struct InputPath
 {
   gboolean                    is_stroke;
   cairo_fill_rule_t           fill_rule;
   double                      line_width;
   cairo_path_t               *path;           /* In canvas coordinates */
+  Box                         extents;        /* Bounds of path, ditto */
 
   FooScrollAreaEventFunc      func;
   gpointer                    data;
@@ -97,6 +104,9 @@ struct FooScrollAreaPrivate
 
   cairo_surface_t            *surface;
   cairo_region_t             *update_region; /* In canvas coordinates */
+
+  /* Scratch context for hit-testing input paths */
+  cairo_t                    *hit_cr;
 };
 
 enum
@@ -173,6 +183,7 @@ foo_scroll_area_finalize (GObject *object)
   g_object_unref (scroll_area->priv->vadj);
 
   g_ptr_array_free (scroll_area->priv->input_regions, TRUE);
+  cairo_destroy (scroll_area->priv->hit_cr);
 
   g_free (scroll_area->priv);
 
@@ -315,13 +326,9 @@ foo_scroll_area_init (FooScrollArea *scroll_area)
   scroll_area->priv->input_regions = g_ptr_array_new ();
   scroll_area->priv->surface = NULL;
   scroll_area->priv->update_region = cairo_region_create ();
+  scroll_area->priv->hit_cr = NULL;
 }
 
-typedef struct
-{
-  double x1, y1, x2, y2;
-} Box;
-
 static void
 input_path_free_list (InputPath *paths)
 {
@@ -752,13 +759,47 @@ emit_input (FooScrollArea *scroll_area,
   func (scroll_area, &event, data);
 }
 
+static gboolean
+input_path_contains (FooScrollArea *scroll_area,
+                     InputPath     *path,
+                     int            x,
+                     int            y)
+{
+  cairo_t *cr;
+
+  /* Most paths are nowhere near the pointer */
+  if (x < path->extents.x1 || x > path->extents.x2 ||
+      y < path->extents.y1 || y > path->extents.y2)
+    return FALSE;
+
+  if (!scroll_area->priv->hit_cr)
+    {
+      cairo_surface_t *surface;
+
+      surface = cairo_image_surface_create (CAIRO_FORMAT_A8, 1, 1);
+      scroll_area->priv->hit_cr = cairo_create (surface);
+      cairo_surface_destroy (surface);
+    }
+
+  cr = scroll_area->priv->hit_cr;
+
+  cairo_new_path (cr);
+  cairo_set_fill_rule (cr, path->fill_rule);
+  cairo_set_line_width (cr, path->line_width);
+  cairo_append_path (cr, path->path);
+
+  if (path->is_stroke)
+    return cairo_in_stroke (cr, x, y);
+  else
+    return cairo_in_fill (cr, x, y);
+}
+
 static void
 process_event (FooScrollArea           *scroll_area,
                FooScrollAreaEventType   input_type,
                int                      x,
                int                      y)
 {
-  GtkWidget *widget = GTK_WIDGET (scroll_area);
   int i;
 
   allocation_to_canvas (scroll_area, &x, &y);
@@ -774,6 +815,10 @@ process_event (FooScrollArea           *scroll_area,
   g_print ("number of input regions: %d\n", scroll_area->priv->input_regions->len);
 #endif
 
+  /* A plain walk over the regions and their paths, not a spatial
+   * index; the extents checked in input_path_contains() only make
+   * rejecting a path cheap.  There is one region per output, so the
+   * walk stays short. */
   for (i = 0; i < scroll_area->priv->input_regions->len; ++i)
     {
       InputRegion *region = scroll_area->priv->input_regions->pdata[i];
@@ -786,44 +831,26 @@ process_event (FooScrollArea           *scroll_area,
         {
           InputPath *path;
 
-          path = region->paths;
-          while (path)
+          for (path = region->paths; path != NULL; path = path->next)
             {
-              cairo_t *cr;
-              gboolean inside;
-
-              cr = gdk_cairo_create (gtk_widget_get_window (widget));
-              cairo_set_fill_rule (cr, path->fill_rule);
-              cairo_set_line_width (cr, path->line_width);
-              cairo_append_path (cr, path->path);
+              if (!input_path_contains (scroll_area, path, x, y))
+                continue;
 
-              if (path->is_stroke)
-                inside = cairo_in_stroke (cr, x, y);
+              if (scroll_area->priv->grabbed)
+                {
+                  emit_input (scroll_area, FOO_DRAG_HOVER,
+                              x, y,
+                              path->func,
+                              path->data);
+                }
               else
-                inside = cairo_in_fill (cr, x, y);
-
-              cairo_destroy (cr);
-
-              if (inside)
                 {
-                  if (scroll_area->priv->grabbed)
-                    {
-                      emit_input (scroll_area, FOO_DRAG_HOVER,
-                                  x, y,
-                                  path->func,
-                                  path->data);
-                    }
-                  else
-                    {
-                      emit_input (scroll_area, input_type,
-                                  x, y,
-                                  path->func,
-                                  path->data);
-                    }
-                  return;
+                  emit_input (scroll_area, input_type,
+                              x, y,
+                              path->func,
+                              path->data);
                 }
-
-              path = path->next;
+              return;
             }
 
           /* Since the regions are all disjoint, no other region
@@ -1159,6 +1186,23 @@ make_path (FooScrollArea *area,
   path->fill_rule = cairo_get_fill_rule (cr);
   path->line_width = cairo_get_line_width (cr);
   path->path = cairo_copy_path (cr);
+
+  cairo_path_extents (cr,
+                      &path->extents.x1, &path->extents.y1,
+                      &path->extents.x2, &path->extents.y2);
+  if (is_stroke)
+    {
+      /* Leave room for the line width, and for miter joins, which
+       * can stick out by up to the default miter limit of 10 times
+       * half of it.
+       */
+      double pad = 5 * path->line_width;
+
+      path->extents.x1 -= pad;
+      path->extents.y1 -= pad;
+      path->extents.x2 += pad;
+      path->extents.y2 += pad;
+    }
   path->func = func;
   path->data = data;
   path->next = area->priv->current_input->paths;
@@ -0,0 +1,453 @@
+/*
+ * Tests for the output snapping in cc-display-snap.c
+ *
+ * Copyright (C) 2026  The GNOME Control Center authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <locale.h>
+#include <string.h>
+#include <glib.h>
+
+#include "cc-display-snap.h"
+
+#define WIDTH  1920
+#define HEIGHT 1080
+
+#define N_QUERIES 10000
+#define N_GRID_QUERIES 100
+
+/* Lays out @n_outputs outputs on a grid, leaving out the last cell,
+ * which is where the dragged output came from.
+ */
+static GdkRectangle *
+make_grid (guint n_outputs, guint *n_others)
+{
+  GdkRectangle *others;
+  guint columns, i;
+
+  for (columns = 1; columns * columns < n_outputs; columns++)
+    ;
+  *n_others = n_outputs - 1;
+  others = g_new (GdkRectangle, MAX (*n_others, 1));
+
+  for (i = 0; i < *n_others; i++)
+    {
+      others[i].x = (i % columns) * WIDTH;
+      others[i].y = (i / columns) * HEIGHT;
+      others[i].width = WIDTH;
+      others[i].height = HEIGHT;
+    }
+
+  return others;
+}
+
+static gboolean
+touches (const GdkRectangle *a, const GdkRectangle *b)
+{
+  if (a->x + a->width == b->x || b->x + b->width == a->x)
+    return a->y <= b->y + b->height && b->y <= a->y + a->height;
+
+  if (a->y + a->height == b->y || b->y + b->height == a->y)
+    return a->x <= b->x + b->width && b->x <= a->x + a->width;
+
+  return FALSE;
+}
+
+static void
+assert_position_valid (const GdkRectangle *others,
+                       guint               n_others,
+                       int                 x,
+                       int                 y)
+{
+  GdkRectangle rect = { x, y, WIDTH, HEIGHT };
+  gboolean touching = FALSE;
+  guint i;
+
+  for (i = 0; i < n_others; i++)
+    {
+      g_assert (!gdk_rectangle_intersect (&rect, &others[i], NULL));
+      if (touches (&rect, &others[i]))
+        touching = TRUE;
+    }
+
+  g_assert (touching);
+}
+
+/* The snapping that cc-display-panel.c did before cc-display-snap.c:
+ * every edge of the dragged output is paired with every edge of the
+ * others, the resulting moves are sorted by distance and the whole
+ * configuration is checked for each one until one is aligned.
+ */
+typedef struct
+{
+  guint output;
+  int x1, y1;
+  int x2, y2;
+} RefEdge;
+
+typedef struct
+{
+  int dx, dy;
+} RefSnap;
+
+static void
+ref_list_edges (const GdkRectangle *rects, guint n_rects, GArray *edges)
+{
+  guint i;
+
+  for (i = 0; i < n_rects; i++)
+    {
+      const GdkRectangle *r = &rects[i];
+      RefEdge e[4] = {
+        /* Top, Bottom, Left, Right */
+        { i, r->x, r->y, r->x + r->width, r->y },
+        { i, r->x, r->y + r->height, r->x + r->width, r->y + r->height },
+        { i, r->x, r->y, r->x, r->y + r->height },
+        { i, r->x + r->width, r->y, r->x + r->width, r->y + r->height },
+      };
+
+      g_array_append_vals (edges, e, 4);
+    }
+}
+
+static gboolean
+ref_overlap (int s1, int e1, int s2, int e2)
+{
+  return (!(e1 < s2 || s1 >= e2));
+}
+
+static void
+ref_add_snap (GArray *snaps, int dx, int dy)
+{
+  RefSnap snap = { dx, dy };
+
+  if (ABS (dx) <= 200 || ABS (dy) <= 200)
+    g_array_append_val (snaps, snap);
+}
+
+static void
+ref_add_edge_snaps (const RefEdge *snapper, const RefEdge *snappee, GArray *snaps)
+{
+  if (snapper->y1 == snapper->y2 && snappee->y1 == snappee->y2 &&
+      ref_overlap (snapper->x1, snapper->x2, snappee->x1, snappee->x2))
+    ref_add_snap (snaps, 0, snappee->y1 - snapper->y1);
+  else if (snapper->x1 == snapper->x2 && snappee->x1 == snappee->x2 &&
+           ref_overlap (snapper->y1, snapper->y2, snappee->y1, snappee->y2))
+    ref_add_snap (snaps, snappee->x1 - snapper->x1, 0);
+
+  ref_add_snap (snaps, snappee->x1 - snapper->x1, snappee->y1 - snapper->y1);
+  ref_add_snap (snaps, snappee->x2 - snapper->x1, snappee->y2 - snapper->y1);
+  ref_add_snap (snaps, snappee->x2 - snapper->x2, snappee->y2 - snapper->y2);
+  ref_add_snap (snaps, snappee->x1 - snapper->x2, snappee->y1 - snapper->y2);
+}
+
+static gboolean
+ref_corner_on_edge (int x, int y, const RefEdge *e)
+{
+  if (x == e->x1 && x == e->x2 && y >= e->y1 && y <= e->y2)
+    return TRUE;
+
+  if (y == e->y1 && y == e->y2 && x >= e->x1 && x <= e->x2)
+    return TRUE;
+
+  return FALSE;
+}
+
+static gboolean
+ref_is_aligned (const GdkRectangle *rects, guint n_rects)
+{
+  GArray *edges;
+  gboolean result = TRUE;
+  guint i, j, k;
+
+  edges = g_array_new (FALSE, FALSE, sizeof (RefEdge));
+  ref_list_edges (rects, n_rects, edges);
+
+  for (i = 0; i < n_rects && result; i++)
+    {
+      gboolean aligned = FALSE;
+
+      for (j = 0; j < edges->len && !aligned; j++)
+        {
+          RefEdge *e1 = &g_array_index (edges, RefEdge, j);
+
+          if (e1->output != i)
+            continue;
+
+          for (k = 0; k < edges->len && !aligned; k++)
+            {
+              RefEdge *e2 = &g_array_index (edges, RefEdge, k);
+
+              if (e2->output != i &&
+                  (ref_corner_on_edge (e1->x1, e1->y1, e2) ||
+                   ref_corner_on_edge (e2->x1, e2->y1, e1)))
+                aligned = TRUE;
+            }
+        }
+
+      if (!aligned)
+        result = FALSE;
+
+      for (j = 0; j < n_rects && result; j++)
+        {
+          if (j != i && gdk_rectangle_intersect (&rects[i], &rects[j], NULL))
+            result = FALSE;
+        }
+    }
+
+  g_array_free (edges, TRUE);
+
+  return result;
+}
+
+static int
+ref_snap_distance (const RefSnap *s)
+{
+  return MAX (ABS (s->dx), ABS (s->dy));
+}
+
+static gboolean
+ref_is_corner_snap (const RefSnap *s)
+{
+  return s->dx != 0 && s->dy != 0;
+}
+
+static int
+ref_compare_snaps (gconstpointer v1, gconstpointer v2)
+{
+  const RefSnap *s1 = v1;
+  const RefSnap *s2 = v2;
+  int d;
+
+  d = ref_snap_distance (s1) - ref_snap_distance (s2);
+  if (d != 0)
+    return d;
+
+  return ref_is_corner_snap (s2) - ref_is_corner_snap (s1);
+}
+
+static gboolean
+reference_snap_find (const GdkRectangle *others,
+                     guint               n_others,
+                     int                 x,
+                     int                 y,
+                     RefSnap            *found)
+{
+  GdkRectangle *rects;
+  GArray *edges, *snaps;
+  gboolean result = FALSE;
+  guint i, j;
+
+  rects = g_new (GdkRectangle, n_others + 1);
+  memcpy (rects, others, n_others * sizeof (GdkRectangle));
+  rects[n_others].x = x;
+  rects[n_others].y = y;
+  rects[n_others].width = WIDTH;
+  rects[n_others].height = HEIGHT;
+
+  edges = g_array_new (FALSE, FALSE, sizeof (RefEdge));
+  snaps = g_array_new (FALSE, FALSE, sizeof (RefSnap));
+  ref_list_edges (rects, n_others + 1, edges);
+
+  for (i = 0; i < edges->len; i++)
+    {
+      RefEdge *snapper = &g_array_index (edges, RefEdge, i);
+
+      if (snapper->output != n_others)
+        continue;
+
+      for (j = 0; j < edges->len; j++)
+        {
+          RefEdge *snappee = &g_array_index (edges, RefEdge, j);
+
+          if (snappee->output != n_others)
+            ref_add_edge_snaps (snapper, snappee, snaps);
+        }
+    }
+
+  g_array_sort (snaps, ref_compare_snaps);
+
+  for (i = 0; i < snaps->len; i++)
+    {
+      RefSnap *snap = &g_array_index (snaps, RefSnap, i);
+
+      rects[n_others].x = x + snap->dx;
+      rects[n_others].y = y + snap->dy;
+
+      if (ref_is_aligned (rects, n_others + 1))
+        {
+          *found = *snap;
+          result = TRUE;
+          break;
+        }
+    }
+
+  g_array_free (snaps, TRUE);
+  g_array_free (edges, TRUE);
+  g_free (rects);
+
+  return result;
+}
+
+static void
+test_no_others (void)
+{
+  CcDisplaySnap *snap;
+  int x, y;
+
+  snap = cc_display_snap_new (NULL, 0, WIDTH, HEIGHT);
+  g_assert (cc_display_snap_find (snap, 123, -45, &x, &y));
+  g_assert_cmpint (x, ==, 123);
+  g_assert_cmpint (y, ==, -45);
+  cc_display_snap_free (snap);
+}
+
+static void
+test_side_by_side (void)
+{
+  GdkRectangle other = { 0, 0, WIDTH, HEIGHT };
+  CcDisplaySnap *snap;
+  int x, y;
+
+  snap = cc_display_snap_new (&other, 1, WIDTH, HEIGHT);
+
+  /* Sliding along the right edge */
+  g_assert (cc_display_snap_find (snap, WIDTH + 10, 300, &x, &y));
+  g_assert_cmpint (x, ==, WIDTH);
+  g_assert_cmpint (y, ==, 300);
+
+  /* Corners win at the same distance */
+  g_assert (cc_display_snap_find (snap, WIDTH + 30, 30, &x, &y));
+  g_assert_cmpint (x, ==, WIDTH);
+  g_assert_cmpint (y, ==, 0);
+
+  /* Dropped on top of the other output */
+  g_assert (cc_display_snap_find (snap, 100, 0, &x, &y));
+  assert_position_valid (&other, 1, x, y);
+
+  cc_display_snap_free (snap);
+}
+
+static void
+test_overlapping_others (void)
+{
+  GdkRectangle others[2] = { { 0, 0, WIDTH, HEIGHT }, { 10, 10, WIDTH, HEIGHT } };
+  CcDisplaySnap *snap;
+  int x, y;
+
+  snap = cc_display_snap_new (others, 2, WIDTH, HEIGHT);
+  g_assert (!cc_display_snap_find (snap, WIDTH, 0, &x, &y));
+  cc_display_snap_free (snap);
+}
+
+static void
+test_grid (void)
+{
+  guint n_outputs;
+
+  for (n_outputs = 2; n_outputs <= 16; n_outputs++)
+    {
+      GdkRectangle *others;
+      CcDisplaySnap *snap;
+      guint n_others, n_found = 0, i;
+
+      others = make_grid (n_outputs, &n_others);
+      snap = cc_display_snap_new (others, n_others, WIDTH, HEIGHT);
+
+      for (i = 0; i < N_GRID_QUERIES; i++)
+        {
+          int qx, qy, x, y;
+          RefSnap expected;
+          gboolean found;
+
+          qx = g_test_rand_int_range (-WIDTH, 5 * WIDTH);
+          qy = g_test_rand_int_range (-HEIGHT, 5 * HEIGHT);
+
+          found = cc_display_snap_find (snap, qx, qy, &x, &y);
+          g_assert_cmpint (found, ==, reference_snap_find (others, n_others, qx, qy, &expected));
+          if (!found)
+            continue;
+
+          assert_position_valid (others, n_others, x, y);
+
+          /* Ties may be broken differently, but the move has to be
+           * as short as the old one, and of the same kind.
+           */
+          g_assert_cmpint (MAX (ABS (x - qx), ABS (y - qy)), ==, ref_snap_distance (&expected));
+          g_assert_cmpint (x != qx && y != qy, ==, ref_is_corner_snap (&expected));
+
+          n_found++;
+        }
+
+      /* Drops far off the corners of the grid can miss, most can't */
+      g_assert_cmpuint (n_found, >=, N_GRID_QUERIES / 4);
+
+      cc_display_snap_free (snap);
+      g_free (others);
+    }
+}
+
+static void
+test_grid_perf (void)
+{
+  guint n_outputs;
+
+  for (n_outputs = 2; n_outputs <= 16; n_outputs *= 2)
+    {
+      GdkRectangle *others;
+      CcDisplaySnap *snap;
+      guint n_others, i;
+      double elapsed;
+      int x, y;
+
+      others = make_grid (n_outputs, &n_others);
+
+      g_test_timer_start ();
+      snap = cc_display_snap_new (others, n_others, WIDTH, HEIGHT);
+      for (i = 0; i < N_QUERIES; i++)
+        cc_display_snap_find (snap,
+                              g_test_rand_int_range (-WIDTH, 5 * WIDTH),
+                              g_test_rand_int_range (-HEIGHT, 5 * HEIGHT),
+                              &x, &y);
+      cc_display_snap_free (snap);
+      elapsed = g_test_timer_elapsed ();
+
+      g_test_minimized_result (elapsed * 1000000.0 / N_QUERIES,
+                               "Snapping among %u outputs took %.2f us per motion event",
+                               n_outputs, elapsed * 1000000.0 / N_QUERIES);
+
+      g_free (others);
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+  setlocale (LC_ALL, "");
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/display/snap/no-others", test_no_others);
+  g_test_add_func ("/display/snap/side-by-side", test_side_by_side);
+  g_test_add_func ("/display/snap/overlapping-others", test_overlapping_others);
+  g_test_add_func ("/display/snap/grid", test_grid);
+
+  /* Run with -m perf */
+  if (g_test_perf ())
+    g_test_add_func ("/display/snap/grid-perf", test_grid_perf);
+
+  return g_test_run ();
+}
@@ -62,13 +62,6 @@ CC_PANEL_REGISTER (CcInfoPanel, cc_info_panel)
 #define INFO_PANEL_PRIVATE(o) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((o), CC_TYPE_INFO_PANEL, CcInfoPanelPrivate))
 
-typedef struct {
-  /* Will be the string below, or "Unknown" */
-  const char *hardware_string;
-
-  char *renderer;
-} GraphicsData;
-
 typedef struct 
 {
   const char *content_type;
@@ -83,24 +76,39 @@ struct _CcInfoPanelPrivate
 {
   GtkBuilder    *builder;
   GtkWidget     *extra_options_dialog;
-  char          *gnome_version;
-  char          *gnome_distributor;
-  char          *gnome_date;
 
   GCancellable  *cancellable;
 
-  /* Free space */
-  GList         *primary_mounts;
-  guint64        total_bytes;
-
   /* Media */
   GSettings     *media_settings;
   GtkWidget     *other_application_combo;
-
-  GraphicsData  *graphics_data;
 };
 
-static void get_primary_disc_info_start (CcInfoPanel *self);
+typedef enum
+{
+  INFO_PROBE_VERSION,
+  INFO_PROBE_MEMORY,
+  INFO_PROBE_PROCESSOR,
+  INFO_PROBE_OS_TYPE,
+  INFO_PROBE_DISK,
+  INFO_PROBE_GRAPHICS,
+  INFO_PROBE_VIRT,
+  N_INFO_PROBES
+} InfoProbe;
+
+/* None of the collected values change during a session, so they are
+ * shared by all instances of the panel and only ever probed once */
+typedef struct
+{
+  gboolean  done;
+  char     *value;
+} InfoCacheEntry;
+
+G_LOCK_DEFINE_STATIC (info_cache);
+static InfoCacheEntry info_cache[N_INFO_PROBES];
+
+/* libgtop isn't thread-safe */
+G_LOCK_DEFINE_STATIC (glibtop);
 
 typedef struct
 {
@@ -277,13 +285,6 @@ prettify_info (const char *info)
   return pretty;
 }
 
-static void
-graphics_data_free (GraphicsData *gdata)
-{
-  g_free (gdata->renderer);
-  g_slice_free (GraphicsData, gdata);
-}
-
 static char *
 get_renderer_from_session (void)
 {
@@ -322,41 +323,19 @@ get_renderer_from_session (void)
   return renderer;
 }
 
-static GraphicsData *
-get_graphics_data (void)
-{
-  GraphicsData *result;
-  GdkDisplay *display;
-
-  result = g_slice_new0 (GraphicsData);
-
-  display = gdk_display_get_default ();
-
-#ifdef GDK_WINDOWING_X11
-  if (GDK_IS_X11_DISPLAY (display))
-    {
-      result->renderer = get_renderer_from_session ();
-      result->hardware_string = result->renderer;
-    }
-  else
-#endif
-#ifdef GDK_WINDOWING_WAYLAND
-  if (GDK_IS_WAYLAND_DISPLAY (display))
-    result->hardware_string = _("Wayland");
-  else
-#endif
-    result->hardware_string = _("Unknown");
-
-  return result;
-}
-
 static void
 cc_info_panel_dispose (GObject *object)
 {
   CcInfoPanelPrivate *priv = CC_INFO_PANEL (object)->priv;
 
+  /* Probes still running will only fill in the cache */
+  if (priv->cancellable)
+    {
+      g_cancellable_cancel (priv->cancellable);
+      g_clear_object (&priv->cancellable);
+    }
+
   g_clear_object (&priv->builder);
-  g_clear_pointer (&priv->graphics_data, graphics_data_free);
   g_clear_pointer (&priv->extra_options_dialog, gtk_widget_destroy);
 
   G_OBJECT_CLASS (cc_info_panel_parent_class)->dispose (object);
@@ -367,15 +346,6 @@ cc_info_panel_finalize (GObject *object)
 {
   CcInfoPanelPrivate *priv = CC_INFO_PANEL (object)->priv;
 
-  if (priv->cancellable)
-    {
-      g_cancellable_cancel (priv->cancellable);
-      g_clear_object (&priv->cancellable);
-    }
-  g_free (priv->gnome_version);
-  g_free (priv->gnome_date);
-  g_free (priv->gnome_distributor);
-
   g_clear_object (&priv->media_settings);
 
   G_OBJECT_CLASS (cc_info_panel_parent_class)->finalize (object);
@@ -498,21 +468,38 @@ get_os_type (void)
   return result;
 }
 
+static void info_cache_store (InfoProbe  probe,
+                              char      *value);
+static void apply_probe      (CcInfoPanel *self,
+                              InfoProbe    probe);
+
+typedef struct
+{
+  CcInfoPanel *self;
+  guint        pending;
+  guint64      total_bytes;
+  gboolean     cancelled;
+} DiskData;
+
 static void
 query_done (GFile        *file,
             GAsyncResult *res,
-            CcInfoPanel  *self)
+            DiskData     *data)
 {
   GFileInfo *info;
   GError *error = NULL;
 
-  self->priv->cancellable = NULL;
   info = g_file_query_filesystem_info_finish (file, res, &error);
   if (info != NULL)
     {
-      self->priv->total_bytes += g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_FILESYSTEM_SIZE);
+      data->total_bytes += g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_FILESYSTEM_SIZE);
       g_object_unref (info);
     }
+  else if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      data->cancelled = TRUE;
+      g_error_free (error);
+    }
   else
     {
       char *path;
@@ -522,43 +509,17 @@ query_done (GFile        *file,
       g_error_free (error);
     }
 
-  /* And onto the next element */
-  get_primary_disc_info_start (self);
-}
-
-static void
-get_primary_disc_info_start (CcInfoPanel *self)
-{
-  GUnixMountEntry *mount;
-  GFile *file;
+  if (--data->pending > 0)
+    return;
 
-  if (self->priv->primary_mounts == NULL)
+  /* Only sum up complete results, a later instance will try again */
+  if (!data->cancelled)
     {
-      char *size;
-      GtkWidget *widget;
-
-      size = g_format_size (self->priv->total_bytes);
-      widget = WID ("disk_label");
-      gtk_label_set_text (GTK_LABEL (widget), size);
-      g_free (size);
-
-      return;
+      info_cache_store (INFO_PROBE_DISK, g_format_size (data->total_bytes));
+      apply_probe (data->self, INFO_PROBE_DISK);
     }
 
-  mount = self->priv->primary_mounts->data;
-  self->priv->primary_mounts = g_list_remove (self->priv->primary_mounts, mount);
-  file = g_file_new_for_path (g_unix_mount_get_mount_path (mount));
-  g_unix_mount_free (mount);
-
-  self->priv->cancellable = g_cancellable_new ();
-
-  g_file_query_filesystem_info_async (file,
-                                      G_FILE_ATTRIBUTE_FILESYSTEM_SIZE,
-                                      0,
-                                      self->priv->cancellable,
-                                      (GAsyncReadyCallback) query_done,
-                                      self);
-  g_object_unref (file);
+  g_free (data);
 }
 
 static void
@@ -566,6 +527,8 @@ get_primary_disc_info (CcInfoPanel *self)
 {
   GList        *points;
   GList        *p;
+  GList        *primary_mounts;
+  DiskData     *data;
 
   points = g_unix_mount_points_get (NULL);
 
@@ -573,6 +536,7 @@ get_primary_disc_info (CcInfoPanel *self)
   if (points == NULL)
     points = g_unix_mounts_get (NULL);
 
+  primary_mounts = NULL;
   for (p = points; p != NULL; p = p->next)
     {
       GUnixMountEntry *mount = p->data;
@@ -589,11 +553,38 @@ get_primary_disc_info (CcInfoPanel *self)
           continue;
         }
 
-      self->priv->primary_mounts = g_list_prepend (self->priv->primary_mounts, mount);
+      primary_mounts = g_list_prepend (primary_mounts, mount);
     }
   g_list_free (points);
 
-  get_primary_disc_info_start (self);
+  if (primary_mounts == NULL)
+    {
+      info_cache_store (INFO_PROBE_DISK, g_format_size (0));
+      apply_probe (self, INFO_PROBE_DISK);
+      return;
+    }
+
+  /* Query all the file systems at once, rather than one after the other */
+  data = g_new0 (DiskData, 1);
+  data->self = self;
+  data->pending = g_list_length (primary_mounts);
+
+  for (p = primary_mounts; p != NULL; p = p->next)
+    {
+      GUnixMountEntry *mount = p->data;
+      GFile *file;
+
+      file = g_file_new_for_path (g_unix_mount_get_mount_path (mount));
+      g_file_query_filesystem_info_async (file,
+                                          G_FILE_ATTRIBUTE_FILESYSTEM_SIZE,
+                                          0,
+                                          self->priv->cancellable,
+                                          (GAsyncReadyCallback) query_done,
+                                          data);
+      g_object_unref (file);
+      g_unix_mount_free (mount);
+    }
+  g_list_free (primary_mounts);
 }
 
 static char *
@@ -787,8 +778,8 @@ set_virtualization_label (CcInfoPanel  *self,
   gtk_label_set_text (GTK_LABEL (widget), display_name ? display_name : virt);
 }
 
-static void
-info_panel_setup_virt (CcInfoPanel  *self)
+static char *
+get_virtualization (void)
 {
   GError *error = NULL;
   GDBusProxy *systemd_proxy;
@@ -836,8 +827,7 @@ info_panel_setup_virt (CcInfoPanel  *self)
   g_object_unref (systemd_proxy);
 
 bail:
-  set_virtualization_label (self, str);
-  g_free (str);
+  return str;
 }
 
 static void
@@ -1481,48 +1471,234 @@ info_panel_setup_selector (CcInfoPanel  *self)
   gtk_widget_show_all (GTK_WIDGET (view));
 }
 
-static void
-info_panel_setup_overview (CcInfoPanel  *self)
+static char *
+get_gnome_version (void)
+{
+  char *version = NULL;
+
+  load_gnome_version (&version, NULL, NULL);
+
+  return version;
+}
+
+static char *
+get_memory_info (void)
 {
-  GtkWidget  *widget;
-  gboolean    res;
   glibtop_mem mem;
-  const glibtop_sysinfo *info;
-  char       *text;
 
-  res = load_gnome_version (&self->priv->gnome_version,
-                            &self->priv->gnome_distributor,
-                            &self->priv->gnome_date);
-  if (res)
+  G_LOCK (glibtop);
+  glibtop_get_mem (&mem);
+  G_UNLOCK (glibtop);
+
+  return g_format_size_full (mem.total, G_FORMAT_SIZE_IEC_UNITS);
+}
+
+static char *
+get_processor_info (void)
+{
+  char *text;
+
+  G_LOCK (glibtop);
+  text = get_cpu_info (glibtop_get_sysinfo ());
+  G_UNLOCK (glibtop);
+
+  return text;
+}
+
+static void
+set_version_label (CcInfoPanel *self,
+                   const char  *version)
+{
+  char *text;
+
+  if (version == NULL)
+    return;
+
+  text = g_strdup_printf (_("Version %s"), version);
+  gtk_label_set_text (GTK_LABEL (WID ("version_label")), text);
+  g_free (text);
+}
+
+static void
+set_memory_label (CcInfoPanel *self,
+                  const char  *memory)
+{
+  gtk_label_set_text (GTK_LABEL (WID ("memory_label")), memory ? memory : "");
+}
+
+static void
+set_processor_label (CcInfoPanel *self,
+                     const char  *processor)
+{
+  gtk_label_set_markup (GTK_LABEL (WID ("processor_label")), processor ? processor : "");
+}
+
+static void
+set_os_type_label (CcInfoPanel *self,
+                   const char  *os_type)
+{
+  gtk_label_set_text (GTK_LABEL (WID ("os_type_label")), os_type ? os_type : "");
+}
+
+static void
+set_disk_label (CcInfoPanel *self,
+                const char  *size)
+{
+  gtk_label_set_text (GTK_LABEL (WID ("disk_label")), size);
+}
+
+static void
+set_graphics_label (CcInfoPanel *self,
+                    const char  *renderer)
+{
+  gtk_label_set_markup (GTK_LABEL (WID ("graphics_label")), renderer ? renderer : _("Unknown"));
+}
+
+/* Probes without a function are not run in a thread */
+static const struct
+{
+  char * (*get)   (void);
+  void   (*apply) (CcInfoPanel *self,
+                   const char  *value);
+} info_probes[N_INFO_PROBES] = {
+  { get_gnome_version,         set_version_label },
+  { get_memory_info,           set_memory_label },
+  { get_processor_info,        set_processor_label },
+  { get_os_type,               set_os_type_label },
+  { NULL,                      set_disk_label },
+  { get_renderer_from_session, set_graphics_label },
+  { get_virtualization,        set_virtualization_label },
+};
+
+static gboolean
+info_cache_lookup (InfoProbe   probe,
+                   char      **value)
+{
+  gboolean done;
+
+  G_LOCK (info_cache);
+  done = info_cache[probe].done;
+  *value = g_strdup (info_cache[probe].value);
+  G_UNLOCK (info_cache);
+
+  return done;
+}
+
+static void
+info_cache_store (InfoProbe  probe,
+                  char      *value)
+{
+  G_LOCK (info_cache);
+  if (info_cache[probe].done)
     {
-      widget = WID ("version_label");
-      text = g_strdup_printf (_("Version %s"), self->priv->gnome_version);
-      gtk_label_set_text (GTK_LABEL (widget), text);
-      g_free (text);
+      /* Another instance of the panel got there first */
+      g_free (value);
     }
+  else
+    {
+      info_cache[probe].value = value;
+      info_cache[probe].done = TRUE;
+    }
+  G_UNLOCK (info_cache);
+}
 
-  glibtop_get_mem (&mem);
-  text = g_format_size_full (mem.total, G_FORMAT_SIZE_IEC_UNITS);
-  widget = WID ("memory_label");
-  gtk_label_set_text (GTK_LABEL (widget), text ? text : "");
-  g_free (text);
+static void
+apply_probe (CcInfoPanel *self,
+             InfoProbe    probe)
+{
+  char *value;
 
-  info = glibtop_get_sysinfo ();
+  info_cache_lookup (probe, &value);
+  info_probes[probe].apply (self, value);
+  g_free (value);
+}
 
-  widget = WID ("processor_label");
-  text = get_cpu_info (info);
-  gtk_label_set_markup (GTK_LABEL (widget), text ? text : "");
-  g_free (text);
+static void
+probe_thread (GTask        *task,
+              gpointer      source_object,
+              gpointer      task_data,
+              GCancellable *cancellable)
+{
+  InfoProbe probe = GPOINTER_TO_INT (task_data);
 
-  widget = WID ("os_type_label");
-  text = get_os_type ();
-  gtk_label_set_text (GTK_LABEL (widget), text ? text : "");
-  g_free (text);
+  info_cache_store (probe, info_probes[probe].get ());
+  g_task_return_boolean (task, TRUE);
+}
+
+static void
+probe_done (GObject      *source_object,
+            GAsyncResult *res,
+            gpointer      user_data)
+{
+  InfoProbe probe;
+
+  /* Cancelled, the panel is gone */
+  if (!g_task_propagate_boolean (G_TASK (res), NULL))
+    return;
+
+  probe = GPOINTER_TO_INT (g_task_get_task_data (G_TASK (res)));
+  apply_probe (CC_INFO_PANEL (user_data), probe);
+}
+
+static gboolean
+has_renderer (void)
+{
+#ifdef GDK_WINDOWING_X11
+  if (GDK_IS_X11_DISPLAY (gdk_display_get_default ()))
+    return TRUE;
+#endif
+  return FALSE;
+}
+
+static void
+info_panel_collect (CcInfoPanel *self)
+{
+  guint i;
+
+  /* Fire off everything at once, and fill in the labels as the
+   * values come in */
+  for (i = 0; i < N_INFO_PROBES; i++)
+    {
+      GTask *task;
+      char *value;
 
-  get_primary_disc_info (self);
+      if (i == INFO_PROBE_GRAPHICS && !has_renderer ())
+        {
+#ifdef GDK_WINDOWING_WAYLAND
+          if (GDK_IS_WAYLAND_DISPLAY (gdk_display_get_default ()))
+            set_graphics_label (self, _("Wayland"));
+          else
+#endif
+            set_graphics_label (self, NULL);
+          continue;
+        }
 
-  widget = WID ("graphics_label");
-  gtk_label_set_markup (GTK_LABEL (widget), self->priv->graphics_data->hardware_string);
+      if (info_cache_lookup (i, &value))
+        {
+          info_probes[i].apply (self, value);
+          g_free (value);
+          continue;
+        }
+
+      if (i == INFO_PROBE_DISK)
+        {
+          get_primary_disc_info (self);
+          continue;
+        }
+
+      task = g_task_new (NULL, self->priv->cancellable, probe_done, self);
+      g_task_set_task_data (task, GINT_TO_POINTER (i), NULL);
+      g_task_run_in_thread (task, probe_thread);
+      g_object_unref (task);
+    }
+}
+
+static void
+info_panel_setup_overview (CcInfoPanel  *self)
+{
+  GtkWidget  *widget;
+
+  info_panel_collect (self);
 
   widget = WID ("info_vbox");
   gtk_container_add (GTK_CONTAINER (self), widget);
@@ -1591,7 +1767,7 @@ cc_info_panel_init (CcInfoPanel *self)
 
   self->priv->extra_options_dialog = WID ("extra_options_dialog");
 
-  self->priv->graphics_data = get_graphics_data ();
+  self->priv->cancellable = g_cancellable_new ();
 
   widget = WID ("updates_button");
   if (does_gnome_software_exist () || does_gpk_update_viewer_exist ())
@@ -1607,5 +1783,4 @@ cc_info_panel_init (CcInfoPanel *self)
   info_panel_setup_overview (self);
   info_panel_setup_default_apps (self);
   info_panel_setup_media (self);
-  info_panel_setup_virt (self);
 }
@@ -60,6 +60,23 @@ static void     cc_keyboard_item_finalize       (GObject               *object);
 
 G_DEFINE_TYPE (CcKeyboardItem, cc_keyboard_item, G_TYPE_OBJECT)
 
+/*
+ * Most shortcuts live in a handful of schemas, so rather than having
+ * one GSettings object and one change handler per item, the items
+ * share one per schema and path, which routes changes to the items
+ * by key.
+ */
+typedef struct
+{
+  GSettings  *settings;
+  GHashTable *items_by_key;
+  guint       n_items;
+} SharedSettings;
+
+static GHashTable *shared_settings = NULL;
+
+static void item_disconnect_settings (CcKeyboardItem *item);
+
 static const gchar *
 get_binding_from_variant (GVariant *variant)
 {
@@ -372,7 +389,10 @@ cc_keyboard_item_finalize (GObject *object)
   g_return_if_fail (item->priv != NULL);
 
   if (item->settings != NULL)
-    g_object_unref (item->settings);
+    {
+      item_disconnect_settings (item);
+      g_object_unref (item->settings);
+    }
 
   /* Free memory */
   g_free (item->priv->binding);
@@ -422,9 +442,7 @@ settings_get_binding (GSettings  *settings,
 }
 
 static void
-binding_changed (GSettings *settings,
-		 const char *key,
-		 CcKeyboardItem *item)
+item_binding_changed (CcKeyboardItem *item)
 {
   char *value;
 
@@ -435,6 +453,110 @@ binding_changed (GSettings *settings,
   g_object_notify (G_OBJECT (item), "binding");
 }
 
+static void
+shared_settings_changed (GSettings      *settings,
+                         const char     *key,
+                         SharedSettings *shared)
+{
+  GPtrArray *items, *copy;
+  guint i;
+
+  items = g_hash_table_lookup (shared->items_by_key, key);
+  if (items == NULL)
+    return;
+
+  /* Handlers may add or remove items */
+  copy = g_ptr_array_new_with_free_func (g_object_unref);
+  for (i = 0; i < items->len; i++)
+    g_ptr_array_add (copy, g_object_ref (items->pdata[i]));
+
+  for (i = 0; i < copy->len; i++)
+    item_binding_changed (copy->pdata[i]);
+
+  g_ptr_array_unref (copy);
+}
+
+static void
+shared_settings_free (SharedSettings *shared)
+{
+  g_signal_handlers_disconnect_by_func (shared->settings, shared_settings_changed, shared);
+  g_object_unref (shared->settings);
+  g_hash_table_destroy (shared->items_by_key);
+  g_free (shared);
+}
+
+static char *
+get_shared_settings_id (const char *schema,
+                        const char *path)
+{
+  return g_strconcat (schema, ":", path, NULL);
+}
+
+/* Sets item->settings to the shared object, and routes changes to
+ * item->key to the item */
+static void
+item_connect_settings (CcKeyboardItem *item,
+                       const char     *path)
+{
+  SharedSettings *shared;
+  GPtrArray *items;
+  char *id;
+
+  if (shared_settings == NULL)
+    shared_settings = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                             g_free, (GDestroyNotify) shared_settings_free);
+
+  id = get_shared_settings_id (item->schema, path);
+  shared = g_hash_table_lookup (shared_settings, id);
+  if (shared == NULL)
+    {
+      shared = g_new0 (SharedSettings, 1);
+      if (path)
+        shared->settings = g_settings_new_with_path (item->schema, path);
+      else
+        shared->settings = g_settings_new (item->schema);
+      shared->items_by_key = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                    g_free, (GDestroyNotify) g_ptr_array_unref);
+      g_signal_connect (shared->settings, "changed",
+                        G_CALLBACK (shared_settings_changed), shared);
+      g_hash_table_insert (shared_settings, g_strdup (id), shared);
+    }
+  g_free (id);
+
+  items = g_hash_table_lookup (shared->items_by_key, item->key);
+  if (items == NULL)
+    {
+      items = g_ptr_array_new ();
+      g_hash_table_insert (shared->items_by_key, g_strdup (item->key), items);
+    }
+  g_ptr_array_add (items, item);
+  shared->n_items++;
+
+  item->settings = g_object_ref (shared->settings);
+}
+
+static void
+item_disconnect_settings (CcKeyboardItem *item)
+{
+  SharedSettings *shared;
+  GPtrArray *items;
+  char *id;
+
+  id = get_shared_settings_id (item->schema, item->gsettings_path);
+  shared = g_hash_table_lookup (shared_settings, id);
+  g_return_if_fail (shared != NULL);
+
+  items = g_hash_table_lookup (shared->items_by_key, item->key);
+  if (items && g_ptr_array_remove (items, item) && items->len == 0)
+    g_hash_table_remove (shared->items_by_key, item->key);
+
+  /* Nobody is watching these settings any more */
+  if (--shared->n_items == 0)
+    g_hash_table_remove (shared_settings, id);
+
+  g_free (id);
+}
+
 gboolean
 cc_keyboard_item_load_from_gsettings_path (CcKeyboardItem *item,
                                            const char     *path,
@@ -443,7 +565,7 @@ cc_keyboard_item_load_from_gsettings_path (CcKeyboardItem *item,
   item->schema = g_strdup (CUSTOM_KEYS_SCHEMA);
   item->gsettings_path = g_strdup (path);
   item->key = g_strdup ("binding");
-  item->settings = g_settings_new_with_path (item->schema, path);
+  item_connect_settings (item, path);
   item->editable = g_settings_is_writable (item->settings, item->key);
   item->desc_editable = g_settings_is_writable (item->settings, "name");
   item->cmd_editable = g_settings_is_writable (item->settings, "command");
@@ -464,8 +586,6 @@ cc_keyboard_item_load_from_gsettings_path (CcKeyboardItem *item,
   item->priv->binding = settings_get_binding (item->settings, item->key);
   binding_from_string (item->priv->binding, &item->keyval,
                        &item->keycode, &item->mask);
-  g_signal_connect (G_OBJECT (item->settings), "changed::binding",
-		    G_CALLBACK (binding_changed), item);
 
   return TRUE;
 }
@@ -476,24 +596,17 @@ cc_keyboard_item_load_from_gsettings (CcKeyboardItem *item,
 				      const char *schema,
 				      const char *key)
 {
-  char *signal_name;
-
   item->schema = g_strdup (schema);
   item->key = g_strdup (key);
   item->description = g_strdup (description);
 
-  item->settings = g_settings_new (item->schema);
+  item_connect_settings (item, NULL);
   g_free (item->priv->binding);
   item->priv->binding = settings_get_binding (item->settings, item->key);
   item->editable = g_settings_is_writable (item->settings, item->key);
   binding_from_string (item->priv->binding, &item->keyval,
                        &item->keycode, &item->mask);
 
-  signal_name = g_strdup_printf ("changed::%s", item->key);
-  g_signal_connect (G_OBJECT (item->settings), signal_name,
-		    G_CALLBACK (binding_changed), item);
-  g_free (signal_name);
-
   return TRUE;
 }
 
@@ -44,8 +44,15 @@ struct _CcKeyboardManager
   GHashTable         *kb_apps_sections;
   GHashTable         *kb_user_sections;
 
+  /* Items by binding, and the binding each item is indexed under */
+  GHashTable         *collision_index;
+  GHashTable         *indexed_bindings;
+
   GSettings          *binding_settings;
 
+  /* Items from before a reload that can be picked up again */
+  GHashTable         *reusable_items;
+
   gpointer            wm_changed_id;
 };
 
@@ -61,6 +68,17 @@ enum
 
 static guint signals[LAST_SIGNAL] = { 0, };
 
+typedef struct
+{
+  guint           keyval;
+  guint           keycode;
+  GdkModifierType mask;
+} CollisionKey;
+
+static void          on_item_binding_changed                     (CcKeyboardItem    *item,
+                                                                  GParamSpec        *pspec,
+                                                                  CcKeyboardManager *self);
+
 /*
  * Auxiliary methos
  */
@@ -148,24 +166,133 @@ compare_keys_for_uniqueness (CcKeyboardItem   *current_item,
   return TRUE;
 }
 
+/*
+ * Collision index
+ */
+static guint
+collision_key_hash (gconstpointer key)
+{
+  const CollisionKey *k = key;
+
+  return k->keyval ^ (k->keycode << 16) ^ ((guint) k->mask << 8);
+}
+
 static gboolean
-check_for_uniqueness (gpointer          key,
-                      GPtrArray        *keys_array,
-                      CcUniquenessData *data)
+collision_key_equal (gconstpointer a,
+                     gconstpointer b)
 {
-  guint i;
+  const CollisionKey *ka = a;
+  const CollisionKey *kb = b;
+
+  return ka->keyval == kb->keyval &&
+         ka->keycode == kb->keycode &&
+         ka->mask == kb->mask;
+}
+
+/*
+ * Shortcuts with a keyval conflict whatever their keycode, so that is
+ * only part of the key when there is no keyval. This mirrors
+ * is_shortcut_different().
+ */
+static void
+collision_key_init (CollisionKey    *key,
+                    guint            keyval,
+                    GdkModifierType  mask,
+                    guint            keycode)
+{
+  key->keyval = keyval;
+  key->keycode = keyval != 0 ? 0 : keycode;
+  key->mask = mask;
+}
+
+static void
+unindex_item (CcKeyboardManager *self,
+              CcKeyboardItem    *item)
+{
+  CollisionKey *key;
+  GPtrArray *items;
+
+  key = g_hash_table_lookup (self->indexed_bindings, item);
+  if (!key)
+    return;
 
-  for (i = 0; i < keys_array->len; i++)
+  items = g_hash_table_lookup (self->collision_index, key);
+  if (items)
     {
-      CcKeyboardItem *item;
+      g_ptr_array_remove_fast (items, item);
+      if (items->len == 0)
+        g_hash_table_remove (self->collision_index, key);
+    }
 
-      item = keys_array->pdata[i];
+  g_hash_table_remove (self->indexed_bindings, item);
+}
 
-      if (compare_keys_for_uniqueness (item, data))
-        return TRUE;
+static void
+index_item (CcKeyboardManager *self,
+            CcKeyboardItem    *item)
+{
+  CollisionKey *key;
+  GPtrArray *items;
+
+  unindex_item (self, item);
+
+  key = g_new0 (CollisionKey, 1);
+  collision_key_init (key, item->keyval, item->mask, item->keycode);
+
+  items = g_hash_table_lookup (self->collision_index, key);
+  if (!items)
+    {
+      items = g_ptr_array_new ();
+      g_hash_table_insert (self->collision_index, g_memdup (key, sizeof (CollisionKey)), items);
     }
+  g_ptr_array_add (items, item);
 
-  return FALSE;
+  g_hash_table_insert (self->indexed_bindings, item, key);
+}
+
+static void
+track_item (CcKeyboardManager *self,
+            CcKeyboardItem    *item)
+{
+  g_signal_connect (item, "notify::binding", G_CALLBACK (on_item_binding_changed), self);
+  index_item (self, item);
+}
+
+static void
+untrack_item (CcKeyboardManager *self,
+              CcKeyboardItem    *item)
+{
+  g_signal_handlers_disconnect_by_func (item, on_item_binding_changed, self);
+  unindex_item (self, item);
+}
+
+static void
+clear_collision_index (CcKeyboardManager *self)
+{
+  GHashTableIter iter;
+  gpointer item;
+
+  g_hash_table_iter_init (&iter, self->indexed_bindings);
+  while (g_hash_table_iter_next (&iter, &item, NULL))
+    g_signal_handlers_disconnect_by_func (item, on_item_binding_changed, self);
+
+  g_hash_table_remove_all (self->indexed_bindings);
+  g_hash_table_remove_all (self->collision_index);
+}
+
+static void
+on_item_binding_changed (CcKeyboardItem    *item,
+                         GParamSpec        *pspec,
+                         CcKeyboardManager *self)
+{
+  CcKeyboardItem *reverse_item;
+
+  index_item (self, item);
+
+  /* Changing an item also changes its reverse item, silently */
+  reverse_item = cc_keyboard_item_get_reverse_item (item);
+  if (reverse_item && g_hash_table_contains (self->indexed_bindings, reverse_item))
+    index_item (self, reverse_item);
 }
 
 
@@ -286,6 +413,132 @@ add_shortcuts (CcKeyboardManager *self)
     }
 }
 
+static gchar *
+get_reuse_key (CcKeyboardItemType  type,
+               const gchar        *schema,
+               const gchar        *name)
+{
+  if (type == CC_KEYBOARD_ITEM_TYPE_GSETTINGS_PATH)
+    return g_strdup (name);
+
+  return g_strdup_printf ("%s:%s", schema, name);
+}
+
+static void
+add_reusable_items (CcKeyboardManager *self,
+                    GHashTable        *sections)
+{
+  GHashTableIter iter;
+  GPtrArray *keys;
+  guint i;
+
+  g_hash_table_iter_init (&iter, sections);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &keys))
+    {
+      for (i = 0; i < keys->len; i++)
+        {
+          CcKeyboardItem *item = g_ptr_array_index (keys, i);
+
+          /* Reverse items point at each other without holding a
+           * reference, so pairs are always loaded again together */
+          if (cc_keyboard_item_get_reverse_item (item) != NULL)
+            continue;
+
+          g_hash_table_insert (self->reusable_items,
+                               get_reuse_key (item->type,
+                                              item->schema,
+                                              item->type == CC_KEYBOARD_ITEM_TYPE_GSETTINGS_PATH ?
+                                              item->gsettings_path : item->key),
+                               item);
+        }
+    }
+}
+
+static CcKeyboardItem *
+take_reusable_item (CcKeyboardManager  *self,
+                    const KeyListEntry *entry)
+{
+  CcKeyboardItem *item;
+  gchar *key;
+
+  if (self->reusable_items == NULL || entry->reverse_entry != NULL)
+    return NULL;
+
+  key = get_reuse_key (entry->type, entry->schema, entry->name);
+  item = g_hash_table_lookup (self->reusable_items, key);
+  if (item != NULL)
+    {
+      g_hash_table_remove (self->reusable_items, key);
+      g_object_ref (item);
+
+      /* The same key can be described differently for another
+       * window manager */
+      if (entry->type == CC_KEYBOARD_ITEM_TYPE_GSETTINGS &&
+          g_strcmp0 (item->description, entry->description) != 0)
+        {
+          g_free (item->description);
+          item->description = g_strdup (entry->description);
+        }
+    }
+  g_free (key);
+
+  return item;
+}
+
+static CcKeyboardItem *
+load_item (const KeyListEntry *entry,
+           GHashTable         *reverse_items)
+{
+  CcKeyboardItem *item;
+  gboolean ret;
+
+  item = cc_keyboard_item_new (entry->type);
+
+  switch (entry->type)
+    {
+    case CC_KEYBOARD_ITEM_TYPE_GSETTINGS_PATH:
+      ret = cc_keyboard_item_load_from_gsettings_path (item, entry->name, FALSE);
+      break;
+
+    case CC_KEYBOARD_ITEM_TYPE_GSETTINGS:
+      ret = cc_keyboard_item_load_from_gsettings (item,
+                                                  entry->description,
+                                                  entry->schema,
+                                                  entry->name);
+      if (ret && entry->reverse_entry != NULL)
+        {
+          CcKeyboardItem *reverse_item;
+          reverse_item = g_hash_table_lookup (reverse_items,
+                                              entry->reverse_entry);
+          if (reverse_item != NULL)
+            {
+              cc_keyboard_item_add_reverse_item (item,
+                                                 reverse_item,
+                                                 entry->is_reversed);
+            }
+          else
+            {
+              g_hash_table_insert (reverse_items,
+                                   entry->name,
+                                   item);
+            }
+        }
+      break;
+
+    default:
+      g_assert_not_reached ();
+    }
+
+  if (ret == FALSE)
+    {
+      /* We don't actually want to popup a dialog - just skip this one */
+      g_object_unref (item);
+      return NULL;
+    }
+
+  return item;
+}
+
 static void
 append_section (CcKeyboardManager  *self,
                 const gchar        *title,
@@ -322,60 +575,22 @@ append_section (CcKeyboardManager  *self,
   for (i = 0; keys_list != NULL && keys_list[i].name != NULL; i++)
     {
       CcKeyboardItem *item;
-      gboolean ret;
 
       if (have_key_for_group (self, group, keys_list[i].name))
         continue;
 
-      item = cc_keyboard_item_new (keys_list[i].type);
-
-      switch (keys_list[i].type)
-        {
-        case CC_KEYBOARD_ITEM_TYPE_GSETTINGS_PATH:
-          ret = cc_keyboard_item_load_from_gsettings_path (item, keys_list[i].name, FALSE);
-          break;
-
-        case CC_KEYBOARD_ITEM_TYPE_GSETTINGS:
-          ret = cc_keyboard_item_load_from_gsettings (item,
-                                                      keys_list[i].description,
-                                                      keys_list[i].schema,
-                                                      keys_list[i].name);
-          if (ret && keys_list[i].reverse_entry != NULL)
-            {
-              CcKeyboardItem *reverse_item;
-              reverse_item = g_hash_table_lookup (reverse_items,
-                                                  keys_list[i].reverse_entry);
-              if (reverse_item != NULL)
-                {
-                  cc_keyboard_item_add_reverse_item (item,
-                                                     reverse_item,
-                                                     keys_list[i].is_reversed);
-                }
-              else
-                {
-                  g_hash_table_insert (reverse_items,
-                                       keys_list[i].name,
-                                       item);
-                }
-            }
-          break;
-
-        default:
-          g_assert_not_reached ();
-        }
-
-      if (ret == FALSE)
-        {
-          /* We don't actually want to popup a dialog - just skip this one */
-          g_object_unref (item);
-          continue;
-        }
+      item = take_reusable_item (self, &keys_list[i]);
+      if (item == NULL)
+        item = load_item (&keys_list[i], reverse_items);
+      if (item == NULL)
+        continue;
 
       cc_keyboard_item_set_hidden (item, keys_list[i].hidden);
       item->model = shortcut_model;
       item->group = group;
 
       g_ptr_array_add (keys_array, item);
+      track_item (self, item);
     }
 
   g_hash_table_destroy (reverse_items);
@@ -402,14 +617,12 @@ append_sections_from_file (CcKeyboardManager  *self,
                            const char         *datadir,
                            gchar             **wm_keybindings)
 {
-  KeyList *keylist;
-  KeyListEntry *keys;
-  KeyListEntry key = { 0, 0, 0, 0, 0, 0, 0 };
+  const KeyList *keylist;
   const char *title;
   int group;
-  guint i;
 
-  keylist = parse_keylist_from_file (path);
+  /* Owned by the cache, which only parses the file again when it changed */
+  keylist = get_keylist_for_file (path);
 
   if (keylist == NULL)
     return;
@@ -422,21 +635,11 @@ append_sections_from_file (CcKeyboardManager  *self,
       (keylist->wm_name != NULL && !g_strv_contains (const_strv (wm_keybindings), keylist->wm_name)) ||
       keylist->name == NULL)
     {
-      g_free (keylist->name);
-      g_free (keylist->package);
-      g_free (keylist->wm_name);
-      g_array_free (keylist->entries, TRUE);
-      g_free (keylist);
       return;
     }
 
 #undef const_strv
 
-  /* Empty KeyListEntry to end the array */
-  key.name = NULL;
-  g_array_append_val (keylist->entries, key);
-
-  keys = (KeyListEntry *) g_array_free (keylist->entries, FALSE);
   if (keylist->package)
     {
       char *localedir;
@@ -455,25 +658,8 @@ append_sections_from_file (CcKeyboardManager  *self,
   else
     group = BINDING_GROUP_APPS;
 
-  append_section (self, title, keylist->name, group, keys);
-
-  g_free (keylist->name);
-  g_free (keylist->package);
-  g_free (keylist->wm_name);
-  g_free (keylist->schema);
-  g_free (keylist->group);
-
-  for (i = 0; keys[i].name != NULL; i++)
-    {
-      KeyListEntry *entry = &keys[i];
-      g_free (entry->schema);
-      g_free (entry->description);
-      g_free (entry->name);
-      g_free (entry->reverse_entry);
-    }
-
-  g_free (keylist);
-  g_free (keys);
+  /* The entries are zero-terminated */
+  append_section (self, title, keylist->name, group, (KeyListEntry *) keylist->entries->data);
 }
 
 static void
@@ -530,6 +716,7 @@ reload_sections (CcKeyboardManager *self)
 {
   GtkTreeModel *shortcut_model;
   GHashTable *loaded_files;
+  GHashTable *old_sections[3];
   GDir *dir;
   gchar *default_wm_keybindings[] = { "Mutter", "GNOME Shell", NULL };
   gchar **wm_keybindings;
@@ -541,25 +728,36 @@ reload_sections (CcKeyboardManager *self)
   /* Clear previous models and hash tables */
   gtk_list_store_clear (GTK_LIST_STORE (self->sections_store));
   gtk_list_store_clear (GTK_LIST_STORE (shortcut_model));
+  clear_collision_index (self);
+
+  /* The previous items are picked up again by schema and key, or by
+   * path; the ones that aren't go away once the new ones are loaded */
+  old_sections[0] = self->kb_system_sections;
+  old_sections[1] = self->kb_apps_sections;
+  old_sections[2] = self->kb_user_sections;
 
-  g_clear_pointer (&self->kb_system_sections, g_hash_table_destroy);
   self->kb_system_sections = g_hash_table_new_full (g_str_hash,
                                                     g_str_equal,
                                                     g_free,
                                                     (GDestroyNotify) free_key_array);
 
-  g_clear_pointer (&self->kb_apps_sections, g_hash_table_destroy);
   self->kb_apps_sections = g_hash_table_new_full (g_str_hash,
                                                   g_str_equal,
                                                   g_free,
                                                   (GDestroyNotify) free_key_array);
 
-  g_clear_pointer (&self->kb_user_sections, g_hash_table_destroy);
   self->kb_user_sections = g_hash_table_new_full (g_str_hash,
                                                   g_str_equal,
                                                   g_free,
                                                   (GDestroyNotify) free_key_array);
 
+  self->reusable_items = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  for (i = 0; i < G_N_ELEMENTS (old_sections); i++)
+    {
+      if (old_sections[i] != NULL)
+        add_reusable_items (self, old_sections[i]);
+    }
+
   /* Load WM keybindings */
 #ifdef GDK_WINDOWING_X11
   if (GDK_IS_X11_DISPLAY (gdk_display_get_default ()))
@@ -613,6 +811,10 @@ reload_sections (CcKeyboardManager *self)
 
   /* Load custom keybindings */
   append_sections_from_gsettings (self);
+
+  g_clear_pointer (&self->reusable_items, g_hash_table_destroy);
+  for (i = 0; i < G_N_ELEMENTS (old_sections); i++)
+    g_clear_pointer (&old_sections[i], g_hash_table_destroy);
 }
 
 /*
@@ -633,6 +835,9 @@ cc_keyboard_manager_finalize (GObject *object)
   g_clear_pointer (&self->kb_system_sections, g_hash_table_destroy);
   g_clear_pointer (&self->kb_apps_sections, g_hash_table_destroy);
   g_clear_pointer (&self->kb_user_sections, g_hash_table_destroy);
+  clear_collision_index (self);
+  g_clear_pointer (&self->collision_index, g_hash_table_destroy);
+  g_clear_pointer (&self->indexed_bindings, g_hash_table_destroy);
   g_clear_object (&self->binding_settings);
 
   g_clear_pointer (&self->wm_changed_id, wm_common_unregister_window_manager_change);
@@ -716,6 +921,12 @@ cc_keyboard_manager_init (CcKeyboardManager *self)
   /* Bindings */
   self->binding_settings = g_settings_new (BINDINGS_SCHEMA);
 
+  self->collision_index = g_hash_table_new_full (collision_key_hash,
+                                                 collision_key_equal,
+                                                 g_free,
+                                                 (GDestroyNotify) g_ptr_array_unref);
+  self->indexed_bindings = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+
   /* Setup the section models */
   self->sections_store = gtk_list_store_new (SECTION_N_COLUMNS,
                                              G_TYPE_STRING,
@@ -808,6 +1019,7 @@ cc_keyboard_manager_add_custom_shortcut (CcKeyboardManager *self,
     }
 
   g_ptr_array_add (keys_array, item);
+  track_item (self, item);
 
   gtk_list_store_append (self->shortcuts_model, &iter);
   gtk_list_store_set (self->shortcuts_model, &iter, DETAIL_KEYENTRY_COLUMN, item, -1);
@@ -845,6 +1057,7 @@ cc_keyboard_manager_remove_custom_shortcut  (CcKeyboardManager *self,
   GtkTreeIter iter;
   GPtrArray *keys_array;
   GVariantBuilder builder;
+  GSettings *settings;
   gboolean valid;
   char **settings_paths;
   int i;
@@ -873,12 +1086,15 @@ cc_keyboard_manager_remove_custom_shortcut  (CcKeyboardManager *self,
   g_assert (valid);
   g_assert (item->type == CC_KEYBOARD_ITEM_TYPE_GSETTINGS_PATH);
 
-  g_settings_delay (item->settings);
-  g_settings_reset (item->settings, "name");
-  g_settings_reset (item->settings, "command");
-  g_settings_reset (item->settings, "binding");
-  g_settings_apply (item->settings);
+  /* item->settings is shared, so don't switch it to delay-apply */
+  settings = g_settings_new_with_path (item->schema, item->gsettings_path);
+  g_settings_delay (settings);
+  g_settings_reset (settings, "name");
+  g_settings_reset (settings, "command");
+  g_settings_reset (settings, "binding");
+  g_settings_apply (settings);
   g_settings_sync ();
+  g_object_unref (settings);
 
   settings_paths = g_settings_get_strv (self->binding_settings, "custom-keybindings");
   g_variant_builder_init (&builder, G_VARIANT_TYPE ("as"));
@@ -895,6 +1111,7 @@ cc_keyboard_manager_remove_custom_shortcut  (CcKeyboardManager *self,
 
   keys_array = g_hash_table_lookup (get_hash_for_group (self, BINDING_GROUP_USER), CUSTOM_SHORTCUTS_ID);
   g_ptr_array_remove (keys_array, item);
+  untrack_item (self, item);
 
   gtk_list_store_remove (GTK_LIST_STORE (model), &iter);
 
@@ -902,52 +1119,92 @@ cc_keyboard_manager_remove_custom_shortcut  (CcKeyboardManager *self,
 }
 
 /**
- * cc_keyboard_manager_get_collision:
+ * cc_keyboard_manager_get_collisions:
  * @self: a #CcKeyboardManager
  * @item: (nullable): a keyboard shortcut
  * @keyval: the key value
  * @mask: a mask for the key sequence
  * @keycode: the code of the key.
  *
- * Retrieves the collision item for the given shortcut.
+ * Retrieves all the shortcuts that would collide with @item if it
+ * was given the shortcut.
  *
- * Returns: (transfer none)(nullable): the collisioned shortcut
+ * Returns: (transfer container)(element-type CcKeyboardItem): the
+ * collisioned shortcuts
  */
-CcKeyboardItem*
-cc_keyboard_manager_get_collision (CcKeyboardManager *self,
-                                   CcKeyboardItem    *item,
-                                   gint               keyval,
-                                   GdkModifierType    mask,
-                                   gint               keycode)
+GList*
+cc_keyboard_manager_get_collisions (CcKeyboardManager *self,
+                                    CcKeyboardItem    *item,
+                                    gint               keyval,
+                                    GdkModifierType    mask,
+                                    gint               keycode)
 {
   CcUniquenessData data;
-  BindingGroupType i;
+  CollisionKey key;
+  GPtrArray *items;
+  GList *collisions;
+  guint i;
 
   g_return_val_if_fail (CC_IS_KEYBOARD_MANAGER (self), NULL);
 
+  /* Any number of shortcuts can be disabled */
+  if (keyval == 0 && keycode == 0)
+    return NULL;
+
+  collision_key_init (&key, keyval, mask, keycode);
+  items = g_hash_table_lookup (self->collision_index, &key);
+  if (!items)
+    return NULL;
+
   data.orig_item = item;
   data.new_keyval = keyval;
   data.new_mask = mask;
   data.new_keycode = keycode;
-  data.conflict_item = NULL;
 
-  if (keyval == 0 && keycode == 0)
-    return NULL;
+  collisions = NULL;
 
-  /* Any number of shortcuts can be disabled */
-  for (i = BINDING_GROUP_SYSTEM; i <= BINDING_GROUP_USER && !data.conflict_item; i++)
+  /* The index narrows it down to the same binding, the rest of the
+   * rules are the same as before */
+  for (i = 0; i < items->len; i++)
     {
-      GHashTable *table;
+      data.conflict_item = NULL;
 
-      table = get_hash_for_group (self, i);
+      if (compare_keys_for_uniqueness (items->pdata[i], &data))
+        collisions = g_list_prepend (collisions, data.conflict_item);
+    }
 
-      if (!table)
-        continue;
+  return g_list_reverse (collisions);
+}
 
-      g_hash_table_find (table, (GHRFunc) check_for_uniqueness, &data);
-    }
+/**
+ * cc_keyboard_manager_get_collision:
+ * @self: a #CcKeyboardManager
+ * @item: (nullable): a keyboard shortcut
+ * @keyval: the key value
+ * @mask: a mask for the key sequence
+ * @keycode: the code of the key.
+ *
+ * Retrieves the collision item for the given shortcut.
+ *
+ * Returns: (transfer none)(nullable): the collisioned shortcut
+ */
+CcKeyboardItem*
+cc_keyboard_manager_get_collision (CcKeyboardManager *self,
+                                   CcKeyboardItem    *item,
+                                   gint               keyval,
+                                   GdkModifierType    mask,
+                                   gint               keycode)
+{
+  CcKeyboardItem *collision;
+  GList *collisions;
+
+  g_return_val_if_fail (CC_IS_KEYBOARD_MANAGER (self), NULL);
+
+  collisions = cc_keyboard_manager_get_collisions (self, item, keyval, mask, keycode);
+  collision = collisions ? collisions->data : NULL;
+  g_list_free (collisions);
 
-  return data.conflict_item;
+  return collision;
 }
 
 /**
@@ -992,20 +1249,22 @@ cc_keyboard_manager_reset_shortcut (CcKeyboardManager *self,
   if (default_binding && *default_binding != '\0')
     {
       GdkModifierType mask;
-      CcKeyboardItem *collision;
+      GList *collisions, *l;
       guint *keycodes;
       guint keyval;
 
       gtk_accelerator_parse_with_keycode (default_binding, &keyval, &keycodes, &mask);
 
-      collision = cc_keyboard_manager_get_collision (self,
-                                                     NULL,
-                                                     keyval,
-                                                     mask,
-                                                     keycodes ? keycodes[0] : 0);
+      collisions = cc_keyboard_manager_get_collisions (self,
+                                                       NULL,
+                                                       keyval,
+                                                       mask,
+                                                       keycodes ? keycodes[0] : 0);
+
+      for (l = collisions; l; l = l->next)
+        cc_keyboard_manager_disable_shortcut (self, l->data);
 
-      if (collision)
-        cc_keyboard_manager_disable_shortcut (self, collision);
+      g_list_free (collisions);
 
       g_free (keycodes);
     }
@@ -20,6 +20,7 @@
  *
  */
 
+#include <string.h>
 #include <glib/gi18n.h>
 
 #include "cc-keyboard-item.h"
@@ -33,10 +34,20 @@
 
 #include "cc-util.h"
 
+enum {
+  SEARCH_KEY_DESCRIPTION,
+  SEARCH_KEY_ACCELERATOR,
+  N_SEARCH_KEYS
+};
+
 typedef struct {
   CcKeyboardItem *item;
   gchar          *section_title;
   gchar          *section_id;
+
+  /* Normalized for searching */
+  gchar          *search_keys[N_SEARCH_KEYS];
+  guint           search_rank;
 } RowData;
 
 struct _CcKeyboardPanel
@@ -49,6 +60,7 @@ struct _CcKeyboardPanel
   GtkWidget          *search_button;
   GtkWidget          *search_entry;
   guint               search_bar_handler_id;
+  CcSearchMatcher    *matcher;
 
   /* Shortcuts */
   GtkWidget          *listbox;
@@ -94,12 +106,35 @@ row_data_new (CcKeyboardItem *item,
 static void
 row_data_free (RowData *data)
 {
+  guint i;
+
   g_object_unref (data->item);
   g_free (data->section_id);
   g_free (data->section_title);
+  for (i = 0; i < N_SEARCH_KEYS; i++)
+    g_free (data->search_keys[i]);
   g_free (data);
 }
 
+static void
+row_data_update_search_keys (RowData *data)
+{
+  gchar *accelerator;
+  guint i;
+
+  for (i = 0; i < N_SEARCH_KEYS; i++)
+    g_free (data->search_keys[i]);
+
+  accelerator = convert_keysym_state_to_string (data->item->keyval,
+                                                data->item->mask,
+                                                data->item->keycode);
+
+  data->search_keys[SEARCH_KEY_DESCRIPTION] = cc_util_normalize_casefold_and_unaccent (data->item->description);
+  data->search_keys[SEARCH_KEY_ACCELERATOR] = cc_util_normalize_casefold_and_unaccent (accelerator);
+
+  g_free (accelerator);
+}
+
 static gboolean
 transform_binding_to_accel (GBinding     *binding,
                             const GValue *from_value,
@@ -144,6 +179,26 @@ shortcut_modified_changed_cb (CcKeyboardItem *item,
   gtk_widget_set_child_visible (button, !cc_keyboard_item_is_value_default (item));
 }
 
+static void
+search_keys_changed_cb (CcKeyboardItem *item,
+                        GParamSpec     *pspec,
+                        GtkListBoxRow  *row)
+{
+  CcKeyboardPanel *self;
+  RowData *data;
+
+  data = g_object_get_data (G_OBJECT (row), "data");
+  row_data_update_search_keys (data);
+
+  self = CC_KEYBOARD_PANEL (gtk_widget_get_ancestor (GTK_WIDGET (row), CC_TYPE_KEYBOARD_PANEL));
+  if (self == NULL)
+    return;
+
+  /* It may match the current search now */
+  cc_search_matcher_forget (self->matcher, data);
+  gtk_list_box_row_changed (row);
+}
+
 static void
 reset_shortcut_cb (GtkWidget      *reset_button,
                    CcKeyboardItem *item)
@@ -162,6 +217,7 @@ add_item (CcKeyboardPanel *self,
           const gchar     *section_title)
 {
   GtkWidget *row, *box, *label, *reset_button;
+  RowData *data;
 
   /* Horizontal box */
   box = g_object_new (GTK_TYPE_BOX,
@@ -238,11 +294,26 @@ add_item (CcKeyboardPanel *self,
 
   gtk_widget_show_all (row);
 
+  data = row_data_new (item, section_id, section_title);
+  row_data_update_search_keys (data);
+
   g_object_set_data_full (G_OBJECT (row),
                           "data",
-                          row_data_new (item, section_id, section_title),
+                          data,
                           (GDestroyNotify) row_data_free);
 
+  g_signal_connect_object (item,
+                           "notify::description",
+                           G_CALLBACK (search_keys_changed_cb),
+                           row,
+                           0);
+
+  g_signal_connect_object (item,
+                           "notify::binding",
+                           G_CALLBACK (search_keys_changed_cb),
+                           row,
+                           0);
+
   gtk_container_add (GTK_CONTAINER (self->listbox), row);
 }
 
@@ -262,6 +333,7 @@ remove_item (CcKeyboardPanel *self,
 
       if (row_data->item == item)
         {
+          cc_search_matcher_forget (self->matcher, row_data);
           gtk_container_remove (GTK_CONTAINER (self->listbox), l->data);
           break;
         }
@@ -277,6 +349,7 @@ sort_function (GtkListBoxRow *a,
 {
   CcKeyboardPanel *self;
   RowData *a_data, *b_data;
+  gboolean a_custom, b_custom, searching;
   gint retval;
 
   self = user_data;
@@ -290,17 +363,23 @@ sort_function (GtkListBoxRow *a,
   a_data = g_object_get_data (G_OBJECT (a), "data");
   b_data = g_object_get_data (G_OBJECT (b), "data");
 
+  a_custom = a_data->item->type == CC_KEYBOARD_ITEM_TYPE_GSETTINGS_PATH;
+  b_custom = b_data->item->type == CC_KEYBOARD_ITEM_TYPE_GSETTINGS_PATH;
+  searching = !cc_search_matcher_is_empty (self->matcher);
+
   /* Put custom shortcuts below everything else */
-  if (a_data->item->type == CC_KEYBOARD_ITEM_TYPE_GSETTINGS_PATH)
-    return 1;
-  else if (b_data->item->type == CC_KEYBOARD_ITEM_TYPE_GSETTINGS_PATH)
-    return -1;
+  if (a_custom != b_custom || (a_custom && !searching))
+    return a_custom ? 1 : -1;
 
   retval = g_strcmp0 (a_data->section_title, b_data->section_title);
 
   if (retval != 0)
     return retval;
 
+  /* Best matches first within each section */
+  if (searching && a_data->search_rank != b_data->search_rank)
+    return a_data->search_rank > b_data->search_rank ? -1 : 1;
+
   return g_strcmp0 (a_data->item->description, b_data->item->description);
 }
 
@@ -374,16 +453,45 @@ header_function (GtkListBoxRow *row,
     }
 }
 
+/*
+ * Ranks like the shell search: rows whose description contains the
+ * earlier words of the query come first, then the ones whose
+ * accelerator contains the most words.
+ */
+static guint
+get_search_rank (CcKeyboardPanel *self,
+                 RowData         *data)
+{
+  const char * const *words;
+  guint description_matches, accelerator_matches, i;
+
+  words = cc_search_matcher_get_words (self->matcher);
+  description_matches = accelerator_matches = 0;
+
+  for (i = 0; words[i] != NULL; i++)
+    {
+      if (i < 16)
+        {
+          description_matches <<= 1;
+          if (strstr (data->search_keys[SEARCH_KEY_DESCRIPTION], words[i]))
+            description_matches |= 1;
+        }
+
+      if (strstr (data->search_keys[SEARCH_KEY_ACCELERATOR], words[i]))
+        accelerator_matches++;
+    }
+
+  return description_matches << 16 | MIN (accelerator_matches, G_MAXUINT16);
+}
+
 static gboolean
 filter_function (GtkListBoxRow *row,
                  gpointer       user_data)
 {
   CcKeyboardPanel *self = user_data;
   RowData *data;
-  gboolean retval;
-  gchar *search, *name;
 
-  if (gtk_entry_get_text_length (GTK_ENTRY (self->search_entry)) == 0)
+  if (cc_search_matcher_is_empty (self->matcher))
     return TRUE;
 
   /* When searching, the '+' row is always hidden */
@@ -391,15 +499,28 @@ filter_function (GtkListBoxRow *row,
     return FALSE;
 
   data = g_object_get_data (G_OBJECT (row), "data");
-  name = cc_util_normalize_casefold_and_unaccent (data->item->description);
-  search = cc_util_normalize_casefold_and_unaccent (gtk_entry_get_text (GTK_ENTRY (self->search_entry)));
 
-  retval = strstr (name, search) != NULL;
+  if (!cc_search_matcher_match (self->matcher,
+                                data,
+                                (const char * const *) data->search_keys,
+                                N_SEARCH_KEYS))
+    return FALSE;
 
-  g_free (search);
-  g_free (name);
+  data->search_rank = get_search_rank (self, data);
 
-  return retval;
+  return TRUE;
+}
+
+static void
+search_entry_changed_cb (GtkSearchEntry  *entry,
+                         CcKeyboardPanel *self)
+{
+  /* Rows which did not match are skipped while the query grows */
+  cc_search_matcher_set_query (self->matcher, gtk_entry_get_text (GTK_ENTRY (entry)));
+
+  /* Filtering computes the ranks the sorting uses */
+  gtk_list_box_invalidate_filter (GTK_LIST_BOX (self->listbox));
+  gtk_list_box_invalidate_sort (GTK_LIST_BOX (self->listbox));
 }
 
 static void
@@ -456,6 +577,7 @@ cc_keyboard_panel_finalize (GObject *object)
   GtkWidget *window;
 
   g_clear_pointer (&self->pictures_regex, g_regex_unref);
+  g_clear_pointer (&self->matcher, cc_search_matcher_free);
   g_clear_object (&self->accelerator_sizegroup);
 
   cc_keyboard_option_clear_all ();
@@ -514,6 +636,7 @@ cc_keyboard_panel_class_init (CcKeyboardPanelClass *klass)
   gtk_widget_class_bind_template_child (widget_class, CcKeyboardPanel, search_button);
   gtk_widget_class_bind_template_child (widget_class, CcKeyboardPanel, search_entry);
 
+  gtk_widget_class_bind_template_callback (widget_class, search_entry_changed_cb);
   gtk_widget_class_bind_template_callback (widget_class, shortcut_row_activated);
 }
 
@@ -526,6 +649,8 @@ cc_keyboard_panel_init (CcKeyboardPanel *self)
 
   gtk_widget_init_template (GTK_WIDGET (self));
 
+  self->matcher = cc_search_matcher_new ();
+
   /* Custom CSS */
   provider = gtk_css_provider_new ();
   gtk_css_provider_load_from_data (provider, custom_css, -1, NULL);
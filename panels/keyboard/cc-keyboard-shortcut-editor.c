@@ -53,7 +53,7 @@ struct _CcKeyboardShortcutEditor
   CcKeyboardItem     *item;
   GBinding           *reset_item_binding;
 
-  CcKeyboardItem     *collision_item;
+  GList              *collision_items;
 
   /* Custom shortcuts */
   GdkDevice          *grab_pointer;
@@ -144,7 +144,7 @@ clear_custom_entries (CcKeyboardShortcutEditor *self)
   self->custom_is_modifier = TRUE;
   self->edited = FALSE;
 
-  self->collision_item = NULL;
+  g_clear_pointer (&self->collision_items, g_list_free);
 
   g_signal_handlers_unblock_by_func (self->command_entry, command_entry_changed_cb, self);
   g_signal_handlers_unblock_by_func (self->name_entry, name_entry_changed_cb, self);
@@ -224,6 +224,15 @@ release_grab (CcKeyboardShortcutEditor *self)
     }
 }
 
+static void
+disable_collision_items (CcKeyboardShortcutEditor *self)
+{
+  GList *l;
+
+  for (l = self->collision_items; l; l = l->next)
+    cc_keyboard_manager_disable_shortcut (self->manager, l->data);
+}
+
 static void
 update_shortcut (CcKeyboardShortcutEditor *self)
 {
@@ -233,9 +242,8 @@ update_shortcut (CcKeyboardShortcutEditor *self)
   /* Setup the binding */
   apply_custom_item_fields (self, self->item);
 
-  /* Eventually disable the conflict shortcut */
-  if (self->collision_item)
-    cc_keyboard_manager_disable_shortcut (self->manager, self->collision_item);
+  /* Eventually disable the conflict shortcuts */
+  disable_collision_items (self);
 
   /* Cleanup whatever was set before */
   clear_custom_entries (self);
@@ -269,7 +277,7 @@ static void
 setup_custom_shortcut (CcKeyboardShortcutEditor *self)
 {
   GtkShortcutLabel *shortcut_label;
-  CcKeyboardItem *collision_item;
+  GList *collision_items;
   HeaderMode mode;
   gboolean is_custom;
   gboolean valid, accel_valid;
@@ -315,11 +323,11 @@ setup_custom_shortcut (CcKeyboardShortcutEditor *self)
 
   shortcut_label = get_current_shortcut_label (self);
 
-  collision_item = cc_keyboard_manager_get_collision (self->manager,
-                                                      self->item,
-                                                      self->custom_keyval,
-                                                      self->custom_mask,
-                                                      self->custom_keycode);
+  collision_items = cc_keyboard_manager_get_collisions (self->manager,
+                                                        self->item,
+                                                        self->custom_keyval,
+                                                        self->custom_mask,
+                                                        self->custom_keycode);
 
   accel = gtk_accelerator_name (self->custom_keyval, self->custom_mask);
 
@@ -342,10 +350,11 @@ setup_custom_shortcut (CcKeyboardShortcutEditor *self)
    * must warn the user and let it be very clear that adding this
    * shortcut will disable the other.
    */
-  gtk_widget_set_visible (self->new_shortcut_conflict_label, collision_item != NULL);
+  gtk_widget_set_visible (self->new_shortcut_conflict_label, collision_items != NULL);
 
-  if (collision_item)
+  if (collision_items)
     {
+      CcKeyboardItem *collision_item = collision_items->data;
       GtkWidget *label;
       gchar *friendly_accelerator;
       gchar *collision_text;
@@ -354,11 +363,36 @@ setup_custom_shortcut (CcKeyboardShortcutEditor *self)
                                                              self->custom_mask,
                                                              self->custom_keycode);
 
-      collision_text = g_strdup_printf (_("%s is already being used for <b>%s</b>. If you "
-                                          "replace it, %s will be disabled"),
-                                        friendly_accelerator,
-                                        collision_item->description,
-                                        collision_item->description);
+      if (collision_items->next == NULL)
+        {
+          collision_text = g_strdup_printf (_("%s is already being used for <b>%s</b>. If you "
+                                              "replace it, %s will be disabled"),
+                                            friendly_accelerator,
+                                            collision_item->description,
+                                            collision_item->description);
+        }
+      else
+        {
+          GString *descriptions;
+          GList *l;
+
+          descriptions = g_string_new (collision_item->description);
+          for (l = collision_items->next; l; l = l->next)
+            {
+              CcKeyboardItem *other = l->data;
+
+              /* Translators: Separates the names of the shortcuts in a conflict */
+              g_string_append (descriptions, _(", "));
+              g_string_append (descriptions, other->description);
+            }
+
+          collision_text = g_strdup_printf (_("%s is already being used for <b>%s</b>. If you "
+                                              "replace it, these shortcuts will be disabled"),
+                                            friendly_accelerator,
+                                            descriptions->str);
+
+          g_string_free (descriptions, TRUE);
+        }
 
       label = is_custom_shortcut (self) ? self->new_shortcut_conflict_label : self->shortcut_conflict_label;
 
@@ -374,7 +408,7 @@ setup_custom_shortcut (CcKeyboardShortcutEditor *self)
    * the headerbar to display "Cancel" and "Replace". Otherwise, make sure to set
    * only the close button again.
    */
-  if (collision_item)
+  if (collision_items)
     {
       mode = HEADER_MODE_REPLACE;
     }
@@ -388,7 +422,8 @@ setup_custom_shortcut (CcKeyboardShortcutEditor *self)
 
   set_header_mode (self, mode);
 
-  self->collision_item = collision_item;
+  g_list_free (self->collision_items);
+  self->collision_items = collision_items;
 
   g_free (accel);
 }
@@ -403,9 +438,8 @@ add_button_clicked_cb (CcKeyboardShortcutEditor *self)
   /* Apply the custom shortcut setup at the new item */
   apply_custom_item_fields (self, item);
 
-  /* Eventually disable the conflict shortcut */
-  if (self->collision_item)
-    cc_keyboard_manager_disable_shortcut (self->manager, self->collision_item);
+  /* Eventually disable the conflict shortcuts */
+  disable_collision_items (self);
 
   /* Cleanup everything once we're done */
   clear_custom_entries (self);
@@ -574,6 +608,7 @@ cc_keyboard_shortcut_editor_finalize (GObject *object)
   g_clear_object (&self->manager);
 
   g_clear_pointer (&self->reset_item_binding, g_binding_unbind);
+  g_clear_pointer (&self->collision_items, g_list_free);
 
   G_OBJECT_CLASS (cc_keyboard_shortcut_editor_parent_class)->finalize (object);
 }
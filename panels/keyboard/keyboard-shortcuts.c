@@ -23,6 +23,7 @@
 #include <config.h>
 
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 
 #include "keyboard-shortcuts.h"
 #include "cc-keyboard-option.h"
@@ -30,6 +31,15 @@
 
 #define CUSTOM_KEYS_BASENAME  "/org/gnome/settings-daemon/plugins/media-keys/custom-keybindings"
 
+typedef struct {
+  KeyList *keylist;
+  gint64   mtime;
+  goffset  size;
+} CachedKeyList;
+
+/* Parsed keybinding files, by path */
+static GHashTable *keylist_cache = NULL;
+
 static char *
 replace_pictures_folder (const char *description)
 {
@@ -380,6 +390,40 @@ setup_keyboard_options (GtkListStore *store)
                       G_CALLBACK (xkb_option_changed), store);
 }
 
+static void
+keylist_free (KeyList *keylist)
+{
+  guint i;
+
+  if (keylist == NULL)
+    return;
+
+  for (i = 0; i < keylist->entries->len; i++)
+    {
+      KeyListEntry *entry = &g_array_index (keylist->entries, KeyListEntry, i);
+
+      g_free (entry->schema);
+      g_free (entry->description);
+      g_free (entry->name);
+      g_free (entry->reverse_entry);
+    }
+  g_array_free (keylist->entries, TRUE);
+
+  g_free (keylist->name);
+  g_free (keylist->group);
+  g_free (keylist->package);
+  g_free (keylist->wm_name);
+  g_free (keylist->schema);
+  g_free (keylist);
+}
+
+static void
+cached_keylist_free (CachedKeyList *cached)
+{
+  keylist_free (cached->keylist);
+  g_free (cached);
+}
+
 KeyList*
 parse_keylist_from_file (const gchar *path)
 {
@@ -387,7 +431,6 @@ parse_keylist_from_file (const gchar *path)
   GError *err = NULL;
   char *buf;
   gsize buf_len;
-  guint i;
 
   GMarkupParseContext *ctx;
   GMarkupParser parser = { parse_start_tag, NULL, NULL, NULL, NULL };
@@ -397,22 +440,15 @@ parse_keylist_from_file (const gchar *path)
     return NULL;
 
   keylist = g_new0 (KeyList, 1);
-  keylist->entries = g_array_new (FALSE, TRUE, sizeof (KeyListEntry));
+  /* Zero-terminated, so the entries end with an empty one */
+  keylist->entries = g_array_new (TRUE, TRUE, sizeof (KeyListEntry));
   ctx = g_markup_parse_context_new (&parser, 0, keylist, NULL);
 
   if (!g_markup_parse_context_parse (ctx, buf, buf_len, &err))
     {
       g_warning ("Failed to parse '%s': '%s'", path, err->message);
       g_error_free (err);
-      g_free (keylist->name);
-      g_free (keylist->package);
-      g_free (keylist->wm_name);
-
-      for (i = 0; i < keylist->entries->len; i++)
-        g_free (((KeyListEntry *) &(keylist->entries->data[i]))->name);
-
-      g_array_free (keylist->entries, TRUE);
-      g_free (keylist);
+      keylist_free (keylist);
       keylist = NULL;
     }
   g_markup_parse_context_free (ctx);
@@ -421,6 +457,41 @@ parse_keylist_from_file (const gchar *path)
   return keylist;
 }
 
+/**
+ * get_keylist_for_file:
+ * @path: a keybindings XML file
+ *
+ * Same as parse_keylist_from_file(), but only parses the file again
+ * if it changed since the last call.
+ *
+ * Returns: (transfer none)(nullable): the keys, owned by the cache
+ */
+const KeyList*
+get_keylist_for_file (const gchar *path)
+{
+  CachedKeyList *cached;
+  GStatBuf buf;
+
+  if (g_stat (path, &buf) != 0)
+    return NULL;
+
+  if (keylist_cache == NULL)
+    keylist_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                           g_free, (GDestroyNotify) cached_keylist_free);
+
+  cached = g_hash_table_lookup (keylist_cache, path);
+  if (cached && cached->mtime == buf.st_mtime && cached->size == buf.st_size)
+    return cached->keylist;
+
+  cached = g_new0 (CachedKeyList, 1);
+  cached->keylist = parse_keylist_from_file (path);
+  cached->mtime = buf.st_mtime;
+  cached->size = buf.st_size;
+  g_hash_table_replace (keylist_cache, g_strdup (path), cached);
+
+  return cached->keylist;
+}
+
 /*
  * Stolen from GtkCellRendererAccel:
  * https://git.gnome.org/browse/gtk+/tree/gtk/gtkcellrendereraccel.c#n261
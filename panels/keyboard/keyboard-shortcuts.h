@@ -98,6 +98,8 @@ gboolean is_valid_accel                 (guint           keyval,
 
 KeyList* parse_keylist_from_file        (const gchar *path);
 
+const KeyList* get_keylist_for_file     (const gchar *path);
+
 gchar*   convert_keysym_state_to_string (guint           keysym,
                                          GdkModifierType mask,
                                          guint           keycode);
@@ -27,11 +27,11 @@
 
 #include <NetworkManager.h>
 #include <libmm-glib.h>
-#include <nma-mobile-providers.h>
 
 #include "panel-common.h"
 #include "network-dialogs.h"
 #include "net-device-mobile.h"
+#include "net-mobile-providers.h"
 
 #define NET_DEVICE_MOBILE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), NET_TYPE_DEVICE_MOBILE, NetDeviceMobilePrivate))
 
@@ -50,7 +50,7 @@ struct _NetDeviceMobilePrivate
         MMObject   *mm_object;
         guint       operator_name_updated;
 
-        NMAMobileProvidersDatabase *mpd;
+        GCancellable *cancellable;
 };
 
 enum {
@@ -258,39 +258,9 @@ device_mobile_find_provider (NetDeviceMobile *device_mobile,
                              const gchar     *mccmnc,
                              guint32          sid)
 {
-        NMAMobileProvider *provider;
-        GString *name = NULL;
-
-        if (device_mobile->priv->mpd == NULL) {
-                GError *error = NULL;
-
-                /* Use defaults */
-                device_mobile->priv->mpd = nma_mobile_providers_database_new_sync (NULL, NULL, NULL, &error);
-                if (device_mobile->priv->mpd == NULL) {
-                        g_debug ("Couldn't load mobile providers database: %s",
-                                 error ? error->message : "");
-                        g_clear_error (&error);
-                        return NULL;
-                }
-        }
-
-        if (mccmnc != NULL) {
-                provider = nma_mobile_providers_database_lookup_3gpp_mcc_mnc (device_mobile->priv->mpd, mccmnc);
-                if (provider != NULL)
-                        name = g_string_new (nma_mobile_provider_get_name (provider));
-        }
-
-        if (sid != 0) {
-                provider = nma_mobile_providers_database_lookup_cdma_sid (device_mobile->priv->mpd, sid);
-                if (provider != NULL) {
-                        if (name == NULL)
-                                name = g_string_new (nma_mobile_provider_get_name (provider));
-                        else
-                                g_string_append_printf (name, ", %s", nma_mobile_provider_get_name (provider));
-                }
-        }
-
-        return (name != NULL ? g_string_free (name, FALSE) : NULL);
+        /* Until the providers are loaded this gives nothing, and the
+         * names get looked up again in device_mobile_providers_ready_cb() */
+        return net_mobile_providers_lookup (mccmnc, sid);
 }
 
 static void
@@ -701,6 +671,49 @@ device_mobile_device_got_modem_manager_cdma_cb (GObject      *source_object,
                            device_mobile);
 }
 
+static void
+device_mobile_providers_ready_cb (GObject      *source_object,
+                                  GAsyncResult *res,
+                                  gpointer      user_data)
+{
+        NetDeviceMobile *device_mobile;
+        NetDeviceMobilePrivate *priv;
+        GError *error = NULL;
+
+        if (!net_mobile_providers_wait_ready_finish (res, &error)) {
+                g_clear_error (&error);
+                return;
+        }
+
+        device_mobile = NET_DEVICE_MOBILE (user_data);
+        priv = device_mobile->priv;
+
+        if (priv->mm_object != NULL)
+                device_mobile_refresh_operator_name (device_mobile);
+
+        if (priv->gsm_proxy != NULL) {
+                g_dbus_proxy_call (priv->gsm_proxy,
+                                   "GetRegistrationInfo",
+                                   NULL,
+                                   G_DBUS_CALL_FLAGS_NONE,
+                                   -1,
+                                   NULL,
+                                   device_mobile_get_registration_info_cb,
+                                   device_mobile);
+        }
+
+        if (priv->cdma_proxy != NULL) {
+                g_dbus_proxy_call (priv->cdma_proxy,
+                                   "GetServingSystem",
+                                   NULL,
+                                   G_DBUS_CALL_FLAGS_NONE,
+                                   -1,
+                                   NULL,
+                                   device_mobile_get_serving_system_cb,
+                                   device_mobile);
+        }
+}
+
 static void
 net_device_mobile_constructed (GObject *object)
 {
@@ -762,6 +775,16 @@ net_device_mobile_constructed (GObject *object)
         g_signal_connect_object (client, "notify::wwan-enabled",
                                  G_CALLBACK (mobilebb_enabled_toggled),
                                  device_mobile, 0);
+
+        /* The provider database is loaded in a thread the first time
+         * a modem needs it */
+        if (!net_mobile_providers_is_ready ()) {
+                device_mobile->priv->cancellable = g_cancellable_new ();
+                net_mobile_providers_wait_ready (device_mobile->priv->cancellable,
+                                                 device_mobile_providers_ready_cb,
+                                                 device_mobile);
+        }
+
         nm_device_mobile_refresh_ui (device_mobile);
 }
 
@@ -850,7 +873,10 @@ net_device_mobile_dispose (GObject *object)
                 priv->operator_name_updated = 0;
         }
         g_clear_object (&priv->mm_object);
-        g_clear_object (&priv->mpd);
+
+        if (priv->cancellable != NULL)
+                g_cancellable_cancel (priv->cancellable);
+        g_clear_object (&priv->cancellable);
 
         G_OBJECT_CLASS (net_device_mobile_parent_class)->dispose (object);
 }
@@ -0,0 +1,659 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "net-mobile-providers.h"
+
+#ifndef MOBILE_BROADBAND_PROVIDER_INFO_DATABASE
+#define MOBILE_BROADBAND_PROVIDER_INFO_DATABASE "/usr/share/mobile-broadband-provider-info/serviceproviders.xml"
+#endif
+
+/* All the panel needs from the mobile broadband provider database is
+ * the name of the provider for a 3GPP MCC/MNC or a CDMA SID, so
+ * rather than loading all of it with libnma, the names are extracted
+ * in a thread into a table that is cached as: format version, the
+ * session's languages (which the names are picked for), the size and
+ * modification time of the database, the 3GPP and CDMA entries as
+ * (key, name index) pairs sorted by key, and the names. */
+#define PROVIDERS_CACHE_VERSION 1
+#define PROVIDERS_CACHE_FORMAT "(ustta(uu)a(uu)as)"
+
+/* 3GPP keys are the MCC and MNC digits as a number, plus this for
+ * three digit MNCs, to tell 01 and 001 apart */
+#define KEY_3GPP_MNC3 1000000
+
+typedef struct {
+        guint32 key;
+        guint32 name;
+} ProviderEntry;
+
+G_STATIC_ASSERT (sizeof (ProviderEntry) == 8);
+
+typedef struct {
+        GVariant            *variant;
+        GVariant            *gsm_variant;
+        GVariant            *cdma_variant;
+        GVariant            *names;
+        const ProviderEntry *gsm;
+        gsize                n_gsm;
+        const ProviderEntry *cdma;
+        gsize                n_cdma;
+} ProviderTable;
+
+typedef struct {
+        gchar    **languages;
+        GPtrArray *names;
+        GArray    *gsm;
+        GArray    *cdma;
+
+        /* the provider being parsed */
+        gint       depth;
+        gint       provider_depth;
+        gchar     *name;
+        gint       name_rank;
+        GString   *text;
+        gint       text_rank;
+        GArray    *provider_gsm;
+        GArray    *provider_cdma;
+} ParseData;
+
+/* Only used from the main thread */
+static ProviderTable *providers = NULL;
+static gboolean providers_loading = FALSE;
+static gboolean providers_loaded = FALSE;
+static GList *waiters = NULL;
+
+static gboolean
+parse_3gpp_key (const gchar *mccmnc,
+                gsize        len,
+                guint32     *key)
+{
+        guint32 value = 0;
+        gsize i;
+
+        /* Expect only digits, and either 5 or 6 of them */
+        if (len != 5 && len != 6)
+                return FALSE;
+
+        for (i = 0; i < len; i++) {
+                if (!g_ascii_isdigit (mccmnc[i]))
+                        return FALSE;
+                value = value * 10 + (mccmnc[i] - '0');
+        }
+
+        if (len == 6)
+                value += KEY_3GPP_MNC3;
+
+        *key = value;
+        return TRUE;
+}
+
+static void
+provider_table_free (ProviderTable *table)
+{
+        g_variant_unref (table->gsm_variant);
+        g_variant_unref (table->cdma_variant);
+        g_variant_unref (table->names);
+        g_variant_unref (table->variant);
+        g_free (table);
+}
+
+static ProviderTable *
+provider_table_new (GVariant *variant)
+{
+        ProviderTable *table;
+
+        table = g_new0 (ProviderTable, 1);
+        table->variant = variant;
+        table->gsm_variant = g_variant_get_child_value (variant, 4);
+        table->cdma_variant = g_variant_get_child_value (variant, 5);
+        table->names = g_variant_get_child_value (variant, 6);
+        table->gsm = g_variant_get_fixed_array (table->gsm_variant, &table->n_gsm, sizeof (ProviderEntry));
+        table->cdma = g_variant_get_fixed_array (table->cdma_variant, &table->n_cdma, sizeof (ProviderEntry));
+
+        return table;
+}
+
+static const gchar *
+provider_table_lookup (ProviderTable       *table,
+                       const ProviderEntry *entries,
+                       gsize                n_entries,
+                       guint32              key)
+{
+        const gchar *name;
+        gsize low, high;
+
+        low = 0;
+        high = n_entries;
+        while (low < high) {
+                gsize mid = low + (high - low) / 2;
+
+                if (entries[mid].key < key) {
+                        low = mid + 1;
+                } else if (entries[mid].key > key) {
+                        high = mid;
+                } else {
+                        if (entries[mid].name >= g_variant_n_children (table->names))
+                                return NULL;
+                        g_variant_get_child (table->names, entries[mid].name, "&s", &name);
+                        return name;
+                }
+        }
+
+        return NULL;
+}
+
+static gint
+get_language_rank (ParseData   *data,
+                   const gchar *lang)
+{
+        gint i;
+
+        for (i = 0; data->languages[i] != NULL; i++) {
+                if (g_strcmp0 (data->languages[i], lang) == 0)
+                        return i;
+        }
+
+        return -1;
+}
+
+static const gchar *
+get_attribute (const gchar **attribute_names,
+               const gchar **attribute_values,
+               const gchar  *name)
+{
+        gint i;
+
+        for (i = 0; attribute_names[i] != NULL; i++) {
+                if (strcmp (attribute_names[i], name) == 0)
+                        return attribute_values[i];
+        }
+
+        return NULL;
+}
+
+static void
+parse_start_element (GMarkupParseContext  *context,
+                     const gchar          *element_name,
+                     const gchar         **attribute_names,
+                     const gchar         **attribute_values,
+                     gpointer              user_data,
+                     GError              **error)
+{
+        ParseData *data = user_data;
+        const gchar *value;
+
+        data->depth++;
+
+        if (strcmp (element_name, "provider") == 0) {
+                data->provider_depth = data->depth;
+                g_clear_pointer (&data->name, g_free);
+                data->name_rank = G_MAXINT;
+                g_array_set_size (data->provider_gsm, 0);
+                g_array_set_size (data->provider_cdma, 0);
+                return;
+        }
+
+        if (data->provider_depth == 0)
+                return;
+
+        /* The provider's own name, not the one of its APNs */
+        if (strcmp (element_name, "name") == 0 &&
+            data->depth == data->provider_depth + 1) {
+                value = get_attribute (attribute_names, attribute_values, "xml:lang");
+
+                /* Prefer the session's languages, then the untranslated
+                 * name, then whatever comes first */
+                if (value == NULL)
+                        data->text_rank = get_language_rank (data, "C");
+                else
+                        data->text_rank = get_language_rank (data, value);
+                if (data->text_rank < 0)
+                        data->text_rank = G_MAXINT - 1;
+
+                data->text = g_string_new (NULL);
+        } else if (strcmp (element_name, "network-id") == 0) {
+                const gchar *mcc, *mnc;
+                gchar *mccmnc;
+                guint32 key;
+
+                mcc = get_attribute (attribute_names, attribute_values, "mcc");
+                mnc = get_attribute (attribute_names, attribute_values, "mnc");
+                if (mcc == NULL || mnc == NULL || strlen (mcc) != 3)
+                        return;
+
+                mccmnc = g_strconcat (mcc, mnc, NULL);
+                if (parse_3gpp_key (mccmnc, strlen (mccmnc), &key))
+                        g_array_append_val (data->provider_gsm, key);
+                g_free (mccmnc);
+        } else if (strcmp (element_name, "sid") == 0) {
+                guint64 sid;
+                gchar *end;
+
+                value = get_attribute (attribute_names, attribute_values, "value");
+                if (value == NULL)
+                        return;
+
+                sid = g_ascii_strtoull (value, &end, 10);
+                if (end != value && *end == '\0' && sid > 0 && sid <= G_MAXUINT32) {
+                        guint32 key = sid;
+
+                        g_array_append_val (data->provider_cdma, key);
+                }
+        }
+}
+
+static void
+parse_end_element (GMarkupParseContext  *context,
+                   const gchar          *element_name,
+                   gpointer              user_data,
+                   GError              **error)
+{
+        ParseData *data = user_data;
+        ProviderEntry entry;
+        guint i;
+
+        data->depth--;
+
+        if (data->text != NULL && strcmp (element_name, "name") == 0) {
+                g_strstrip (data->text->str);
+                if (data->text_rank < data->name_rank && data->text->str[0] != '\0') {
+                        g_free (data->name);
+                        data->name = g_strdup (data->text->str);
+                        data->name_rank = data->text_rank;
+                }
+                g_string_free (data->text, TRUE);
+                data->text = NULL;
+        } else if (strcmp (element_name, "provider") == 0) {
+                data->provider_depth = 0;
+
+                if (data->name == NULL ||
+                    (data->provider_gsm->len == 0 && data->provider_cdma->len == 0))
+                        return;
+
+                entry.name = data->names->len;
+                g_ptr_array_add (data->names, data->name);
+                data->name = NULL;
+
+                for (i = 0; i < data->provider_gsm->len; i++) {
+                        entry.key = g_array_index (data->provider_gsm, guint32, i);
+                        g_array_append_val (data->gsm, entry);
+                }
+                for (i = 0; i < data->provider_cdma->len; i++) {
+                        entry.key = g_array_index (data->provider_cdma, guint32, i);
+                        g_array_append_val (data->cdma, entry);
+                }
+        }
+}
+
+static void
+parse_text (GMarkupParseContext  *context,
+            const gchar          *text,
+            gsize                 text_len,
+            gpointer              user_data,
+            GError              **error)
+{
+        ParseData *data = user_data;
+
+        if (data->text != NULL)
+                g_string_append_len (data->text, text, text_len);
+}
+
+/* By key, then in the order of the database, where the first provider
+ * for a key wins */
+static gint
+compare_entries (gconstpointer a,
+                 gconstpointer b)
+{
+        const ProviderEntry *ea = a;
+        const ProviderEntry *eb = b;
+
+        if (ea->key != eb->key)
+                return ea->key < eb->key ? -1 : 1;
+        if (ea->name != eb->name)
+                return ea->name < eb->name ? -1 : 1;
+        return 0;
+}
+
+static void
+sort_entries (GArray *entries)
+{
+        ProviderEntry *entry;
+        guint i, n;
+
+        g_array_sort (entries, compare_entries);
+
+        for (i = 0, n = 0; i < entries->len; i++) {
+                entry = &g_array_index (entries, ProviderEntry, i);
+                if (n > 0 && g_array_index (entries, ProviderEntry, n - 1).key == entry->key)
+                        continue;
+                g_array_index (entries, ProviderEntry, n++) = *entry;
+        }
+        g_array_set_size (entries, n);
+}
+
+static GVariant *
+build_from_database (gchar   **languages,
+                     guint64   size,
+                     guint64   mtime,
+                     GError  **error)
+{
+        GMarkupParser parser = { parse_start_element, parse_end_element, parse_text, NULL, NULL };
+        GMarkupParseContext *ctx;
+        ParseData data = { 0 };
+        GVariant *variant = NULL;
+        GVariant *built;
+        gchar *languages_joined;
+        gchar *contents;
+        gsize len;
+
+        if (!g_file_get_contents (MOBILE_BROADBAND_PROVIDER_INFO_DATABASE, &contents, &len, error))
+                return NULL;
+
+        data.languages = languages;
+        data.names = g_ptr_array_new_with_free_func (g_free);
+        data.gsm = g_array_new (FALSE, FALSE, sizeof (ProviderEntry));
+        data.cdma = g_array_new (FALSE, FALSE, sizeof (ProviderEntry));
+        data.provider_gsm = g_array_new (FALSE, FALSE, sizeof (guint32));
+        data.provider_cdma = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+        ctx = g_markup_parse_context_new (&parser, 0, &data, NULL);
+        if (!g_markup_parse_context_parse (ctx, contents, len, error) ||
+            !g_markup_parse_context_end_parse (ctx, error))
+                goto out;
+
+        sort_entries (data.gsm);
+        sort_entries (data.cdma);
+
+        languages_joined = g_strjoinv (":", languages);
+        built = g_variant_new ("(ustt@a(uu)@a(uu)@as)",
+                               (guint32) PROVIDERS_CACHE_VERSION,
+                               languages_joined,
+                               size,
+                               mtime,
+                               g_variant_new_fixed_array (G_VARIANT_TYPE ("(uu)"),
+                                                          data.gsm->data, data.gsm->len,
+                                                          sizeof (ProviderEntry)),
+                               g_variant_new_fixed_array (G_VARIANT_TYPE ("(uu)"),
+                                                          data.cdma->data, data.cdma->len,
+                                                          sizeof (ProviderEntry)),
+                               g_variant_new_strv ((const gchar * const *) data.names->pdata,
+                                                   data.names->len));
+        g_free (languages_joined);
+
+        /* Serialize it once, which is the shape it has when loaded from
+         * the cache, and what makes the lookups cheap */
+        g_variant_ref_sink (built);
+        variant = g_variant_new_from_bytes (G_VARIANT_TYPE (PROVIDERS_CACHE_FORMAT),
+                                            g_variant_get_data_as_bytes (built),
+                                            TRUE);
+        g_variant_ref_sink (variant);
+        g_variant_unref (built);
+out:
+        g_markup_parse_context_free (ctx);
+        g_free (contents);
+        g_free (data.name);
+        if (data.text != NULL)
+                g_string_free (data.text, TRUE);
+        g_ptr_array_unref (data.names);
+        g_array_unref (data.gsm);
+        g_array_unref (data.cdma);
+        g_array_unref (data.provider_gsm);
+        g_array_unref (data.provider_cdma);
+
+        return variant;
+}
+
+static gchar *
+get_cache_file (void)
+{
+        return g_build_filename (g_get_user_cache_dir (),
+                                 "gnome-control-center",
+                                 "mobile-providers.cache",
+                                 NULL);
+}
+
+static GVariant *
+load_from_cache (const gchar *languages,
+                 guint64      size,
+                 guint64      mtime)
+{
+        GMappedFile *mapped;
+        GBytes *bytes;
+        GVariant *cache;
+        gchar *cache_file;
+        const gchar *cached_languages;
+        guint64 cached_size, cached_mtime;
+        guint32 version;
+
+        cache_file = get_cache_file ();
+        mapped = g_mapped_file_new (cache_file, FALSE, NULL);
+        g_free (cache_file);
+        if (mapped == NULL)
+                return NULL;
+
+        bytes = g_mapped_file_get_bytes (mapped);
+        g_mapped_file_unref (mapped);
+        cache = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (PROVIDERS_CACHE_FORMAT),
+                                                              bytes, FALSE));
+        g_bytes_unref (bytes);
+
+        g_variant_get_child (cache, 0, "u", &version);
+        g_variant_get_child (cache, 1, "&s", &cached_languages);
+        g_variant_get_child (cache, 2, "t", &cached_size);
+        g_variant_get_child (cache, 3, "t", &cached_mtime);
+
+        if (version != PROVIDERS_CACHE_VERSION ||
+            g_strcmp0 (cached_languages, languages) != 0 ||
+            cached_size != size ||
+            cached_mtime != mtime) {
+                g_variant_unref (cache);
+                return NULL;
+        }
+
+        return cache;
+}
+
+static void
+save_to_cache (GVariant *variant)
+{
+        GError *error = NULL;
+        gchar *cache_file, *cache_dir;
+
+        cache_file = get_cache_file ();
+        cache_dir = g_path_get_dirname (cache_file);
+        g_mkdir_with_parents (cache_dir, USER_DIR_MODE);
+
+        if (!g_file_set_contents (cache_file,
+                                  g_variant_get_data (variant),
+                                  g_variant_get_size (variant),
+                                  &error)) {
+                g_debug ("Could not write mobile providers cache: %s", error->message);
+                g_error_free (error);
+        }
+
+        g_free (cache_dir);
+        g_free (cache_file);
+}
+
+static void
+load_providers_thread (GTask        *task,
+                       gpointer      source_object,
+                       gpointer      task_data,
+                       GCancellable *cancellable)
+{
+        gchar **languages = task_data;
+        gchar *languages_joined;
+        GError *error = NULL;
+        GVariant *variant;
+        GStatBuf buf;
+
+        if (g_stat (MOBILE_BROADBAND_PROVIDER_INFO_DATABASE, &buf) != 0) {
+                int errsv = errno;
+
+                g_task_return_new_error (task, G_IO_ERROR, g_io_error_from_errno (errsv),
+                                         "%s: %s", MOBILE_BROADBAND_PROVIDER_INFO_DATABASE,
+                                         g_strerror (errsv));
+                return;
+        }
+
+        languages_joined = g_strjoinv (":", languages);
+        variant = load_from_cache (languages_joined, buf.st_size, buf.st_mtime);
+        g_free (languages_joined);
+
+        if (variant == NULL) {
+                variant = build_from_database (languages, buf.st_size, buf.st_mtime, &error);
+                if (variant == NULL) {
+                        g_task_return_error (task, error);
+                        return;
+                }
+                save_to_cache (variant);
+        }
+
+        g_task_return_pointer (task, provider_table_new (variant), (GDestroyNotify) provider_table_free);
+}
+
+static void
+load_providers_cb (GObject      *source_object,
+                   GAsyncResult *res,
+                   gpointer      user_data)
+{
+        GError *error = NULL;
+        GList *list, *l;
+
+        providers = g_task_propagate_pointer (G_TASK (res), &error);
+        if (providers == NULL) {
+                g_debug ("Couldn't load mobile providers database: %s", error->message);
+                g_error_free (error);
+        }
+        providers_loading = FALSE;
+        providers_loaded = TRUE;
+
+        list = waiters;
+        waiters = NULL;
+        for (l = list; l != NULL; l = l->next) {
+                g_task_return_boolean (l->data, providers != NULL);
+                g_object_unref (l->data);
+        }
+        g_list_free (list);
+}
+
+static void
+ensure_loading (void)
+{
+        GTask *task;
+
+        if (providers_loaded || providers_loading)
+                return;
+        providers_loading = TRUE;
+
+        task = g_task_new (NULL, NULL, load_providers_cb, NULL);
+        g_task_set_task_data (task,
+                              g_strdupv ((gchar **) g_get_language_names ()),
+                              (GDestroyNotify) g_strfreev);
+        g_task_run_in_thread (task, load_providers_thread);
+        g_object_unref (task);
+}
+
+/**
+ * net_mobile_providers_wait_ready:
+ *
+ * Starts loading the provider table in a thread if needed, and calls
+ * @callback once it is loaded. The result is %FALSE if the database
+ * could not be loaded.
+ */
+void
+net_mobile_providers_wait_ready (GCancellable        *cancellable,
+                                 GAsyncReadyCallback  callback,
+                                 gpointer             user_data)
+{
+        GTask *task;
+
+        task = g_task_new (NULL, cancellable, callback, user_data);
+
+        if (providers_loaded) {
+                g_task_return_boolean (task, providers != NULL);
+                g_object_unref (task);
+                return;
+        }
+
+        waiters = g_list_prepend (waiters, task);
+        ensure_loading ();
+}
+
+gboolean
+net_mobile_providers_wait_ready_finish (GAsyncResult  *res,
+                                        GError       **error)
+{
+        return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+gboolean
+net_mobile_providers_is_ready (void)
+{
+        return providers != NULL;
+}
+
+/**
+ * net_mobile_providers_lookup:
+ * @mccmnc: (nullable): a 3GPP operator code
+ * @sid: a CDMA SID, or 0
+ *
+ * Never blocks: until the table is loaded, this returns %NULL and
+ * starts loading it.
+ *
+ * Returns: the names of the providers for @mccmnc and @sid, or %NULL
+ */
+gchar *
+net_mobile_providers_lookup (const gchar *mccmnc,
+                             guint32      sid)
+{
+        const gchar *gsm_name = NULL;
+        const gchar *cdma_name = NULL;
+        guint32 key;
+        gsize len;
+
+        if (providers == NULL) {
+                ensure_loading ();
+                return NULL;
+        }
+
+        if (mccmnc != NULL) {
+                len = strlen (mccmnc);
+                if (parse_3gpp_key (mccmnc, len, &key))
+                        gsm_name = provider_table_lookup (providers, providers->gsm, providers->n_gsm, key);
+
+                /* Try to match with just 2 digits of MNC */
+                if (gsm_name == NULL && len == 6 && parse_3gpp_key (mccmnc, 5, &key))
+                        gsm_name = provider_table_lookup (providers, providers->gsm, providers->n_gsm, key);
+        }
+
+        if (sid != 0)
+                cdma_name = provider_table_lookup (providers, providers->cdma, providers->n_cdma, sid);
+
+        if (gsm_name != NULL && cdma_name != NULL)
+                return g_strdup_printf ("%s, %s", gsm_name, cdma_name);
+
+        return g_strdup (gsm_name != NULL ? gsm_name : cdma_name);
+}
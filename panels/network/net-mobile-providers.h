@@ -0,0 +1,38 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __NET_MOBILE_PROVIDERS_H
+#define __NET_MOBILE_PROVIDERS_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+void     net_mobile_providers_wait_ready        (GCancellable        *cancellable,
+                                                 GAsyncReadyCallback  callback,
+                                                 gpointer             user_data);
+gboolean net_mobile_providers_wait_ready_finish (GAsyncResult        *res,
+                                                 GError             **error);
+gboolean net_mobile_providers_is_ready          (void);
+gchar   *net_mobile_providers_lookup            (const gchar         *mccmnc,
+                                                 guint32              sid);
+
+G_END_DECLS
+
+#endif /* __NET_MOBILE_PROVIDERS_H */
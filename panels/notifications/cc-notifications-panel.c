@@ -22,6 +22,7 @@
 #include <string.h>
 #include <glib/gi18n-lib.h>
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <gio/gio.h>
 #include <gio/gdesktopappinfo.h>
 
@@ -34,6 +35,13 @@
 #define APP_SCHEMA MASTER_SCHEMA ".application"
 #define APP_PREFIX "/org/gnome/desktop/notifications/application/"
 
+/* Bump when the format of the application cache changes */
+#define APPS_CACHE_VERSION 2
+#define APPS_CACHE_TYPE "(ua(sx)as)"
+
+/* Number of rows added to the list per main loop iteration */
+#define APPS_PER_BATCH 50
+
 struct _CcNotificationsPanel {
   CcPanel parent_instance;
 
@@ -44,6 +52,11 @@ struct _CcNotificationsPanel {
 
   GHashTable *known_applications;
 
+  /* Applications found by the loading thread, waiting to be added */
+  GPtrArray *pending_apps;
+  guint pending_apps_index;
+  guint pending_apps_id;
+
   GtkAdjustment *focus_adjustment;
 
   GList *sections;
@@ -56,15 +69,15 @@ struct _CcNotificationsPanelClass {
 
 typedef struct {
   char *canonical_app_id;
+  char *collate_key;
   GAppInfo *app_info;
-  GSettings *settings;
 
-  /* Temporary pointer, to pass from the loading thread
-     to the app */
-  CcNotificationsPanel *panel;
+  /* Created on demand, see application_get_settings() */
+  GSettings *settings;
 } Application;
 
 static void application_free (Application *app);
+static void free_pending_apps (CcNotificationsPanel *panel);
 static void build_app_store (CcNotificationsPanel *panel);
 static void select_app      (GtkListBox *box, GtkListBoxRow *row, CcNotificationsPanel *panel);
 static int  sort_apps       (gconstpointer one, gconstpointer two, gpointer user_data);
@@ -76,6 +89,13 @@ cc_notifications_panel_dispose (GObject *object)
 {
   CcNotificationsPanel *panel = CC_NOTIFICATIONS_PANEL (object);
 
+  if (panel->pending_apps_id != 0)
+    {
+      g_source_remove (panel->pending_apps_id);
+      panel->pending_apps_id = 0;
+    }
+  free_pending_apps (panel);
+
   g_clear_object (&panel->builder);
   g_clear_object (&panel->master_settings);
   g_clear_pointer (&panel->known_applications, g_hash_table_unref);
@@ -249,6 +269,95 @@ application_quark (void)
   return quark;
 }
 
+static char *
+app_info_get_id (GAppInfo *app_info)
+{
+  const char *desktop_id;
+  char *ret;
+  const char *filename;
+
+  desktop_id = g_app_info_get_id (app_info);
+  if (desktop_id != NULL)
+    {
+      ret = g_strdup (desktop_id);
+    }
+  else
+    {
+      filename = g_desktop_app_info_get_filename (G_DESKTOP_APP_INFO (app_info));
+      if (filename == NULL)
+        return NULL;
+      ret = g_path_get_basename (filename);
+    }
+
+  if (G_UNLIKELY (g_str_has_suffix (ret, ".desktop") == FALSE))
+    {
+      g_free (ret);
+      return NULL;
+    }
+
+  *(ret + strlen (ret) - strlen(".desktop")) = '\0';
+  return ret;
+}
+
+static char *
+app_info_get_canonical_id (GAppInfo *app_info)
+{
+  char *app_id;
+  guint i;
+
+  app_id = app_info_get_id (app_info);
+  if (app_id == NULL)
+    return NULL;
+
+  g_strcanon (app_id,
+              "0123456789"
+              "abcdefghijklmnopqrstuvwxyz"
+              "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+              "-",
+              '-');
+  for (i = 0; app_id[i] != '\0'; i++)
+    app_id[i] = g_ascii_tolower (app_id[i]);
+
+  return app_id;
+}
+
+/* Takes ownership of @canonical_app_id, @app_info and @settings */
+static Application *
+application_new (char      *canonical_app_id,
+                 GAppInfo  *app_info,
+                 GSettings *settings)
+{
+  Application *app;
+  const char *name;
+
+  name = g_app_info_get_name (app_info);
+
+  app = g_slice_new0 (Application);
+  app->canonical_app_id = canonical_app_id;
+  app->collate_key = g_utf8_collate_key (name ? name : "", -1);
+  app->app_info = app_info;
+  app->settings = settings;
+
+  return app;
+}
+
+static GSettings *
+application_get_settings (Application *app)
+{
+  char *path;
+
+  /* Most applications are never looked at, so only create the
+   * relocatable settings object once the row is shown or opened */
+  if (app->settings == NULL)
+    {
+      path = g_strconcat (APP_PREFIX, app->canonical_app_id, "/", NULL);
+      app->settings = g_settings_new_with_path (APP_SCHEMA, path);
+      g_free (path);
+    }
+
+  return app->settings;
+}
+
 static gboolean
 on_off_label_mapping_get (GValue   *value,
                           GVariant *variant,
@@ -259,6 +368,37 @@ on_off_label_mapping_get (GValue   *value,
   return TRUE;
 }
 
+static void
+bind_on_off_label (Application *app,
+                   GtkWidget   *label)
+{
+  g_settings_bind_with_mapping (application_get_settings (app), "enable",
+                                label, "label",
+                                G_SETTINGS_BIND_GET |
+                                G_SETTINGS_BIND_NO_SENSITIVITY,
+                                on_off_label_mapping_get,
+                                NULL,
+                                NULL,
+                                NULL);
+}
+
+static gboolean
+row_draw (GtkWidget *row,
+          cairo_t   *cr,
+          GtkWidget *label)
+{
+  Application *app;
+
+  /* Rows scrolled out of view are never drawn. The row is hooked
+   * rather than the label, which has no size while it is empty. */
+  g_signal_handlers_disconnect_by_func (row, row_draw, label);
+
+  app = g_object_get_qdata (G_OBJECT (row), application_quark ());
+  bind_on_off_label (app, label);
+
+  return FALSE;
+}
+
 static void
 add_application (CcNotificationsPanel *panel,
                  Application          *app)
@@ -270,7 +410,10 @@ add_application (CcNotificationsPanel *panel,
 
   app_name = g_app_info_get_name (app->app_info);
   if (app_name == NULL || *app_name == '\0')
-    return;
+    {
+      application_free (app);
+      return;
+    }
 
   icon = g_app_info_get_icon (app->app_info);
   if (icon == NULL)
@@ -304,14 +447,10 @@ add_application (CcNotificationsPanel *panel,
   gtk_container_add (GTK_CONTAINER (box), w);
 
   w = gtk_label_new ("");
-  g_settings_bind_with_mapping (app->settings, "enable",
-                                w, "label",
-                                G_SETTINGS_BIND_GET |
-                                G_SETTINGS_BIND_NO_SENSITIVITY,
-                                on_off_label_mapping_get,
-                                NULL,
-                                NULL,
-                                NULL);
+  if (app->settings != NULL)
+    bind_on_off_label (app, w);
+  else
+    g_signal_connect (row, "draw", G_CALLBACK (row_draw), w);
   gtk_widget_set_margin_end (w, 12);
   gtk_widget_set_valign (w, GTK_ALIGN_CENTER);
   gtk_box_pack_end (GTK_BOX (box), w, FALSE, FALSE, 0);
@@ -350,10 +489,7 @@ maybe_add_app_id (CcNotificationsPanel *panel,
     /* The application cannot be found, probably it was uninstalled */
     g_object_unref (settings);
   } else {
-    app = g_slice_new (Application);
-    app->canonical_app_id = g_strdup (canonical_app_id);
-    app->settings = settings;
-    app->app_info = app_info;
+    app = application_new (g_strdup (canonical_app_id), app_info, settings);
 
     g_debug ("Adding application '%s' (canonical app ID: %s)",
              full_app_id, canonical_app_id);
@@ -365,100 +501,224 @@ maybe_add_app_id (CcNotificationsPanel *panel,
   g_free (full_app_id);
 }
 
+static void
+free_pending_apps (CcNotificationsPanel *panel)
+{
+  g_clear_pointer (&panel->pending_apps, g_ptr_array_unref);
+  panel->pending_apps_index = 0;
+}
+
 static gboolean
-queued_app_info (gpointer data)
+add_pending_apps (gpointer user_data)
 {
+  CcNotificationsPanel *panel = user_data;
   Application *app;
-  CcNotificationsPanel *panel;
+  guint n;
 
-  app = data;
-  panel = app->panel;
-  app->panel = NULL;
-
-  if (g_cancellable_is_cancelled (panel->apps_load_cancellable) ||
-      g_hash_table_contains (panel->known_applications,
-                             app->canonical_app_id))
+  for (n = 0;
+       n < APPS_PER_BATCH && panel->pending_apps_index < panel->pending_apps->len;
+       n++)
     {
-      application_free (app);
-      g_object_unref (panel);
-      return FALSE;
+      /* Steal the application, the row owns it from now on */
+      app = g_ptr_array_index (panel->pending_apps, panel->pending_apps_index);
+      g_ptr_array_index (panel->pending_apps, panel->pending_apps_index) = NULL;
+      panel->pending_apps_index++;
+
+      if (g_hash_table_contains (panel->known_applications,
+                                 app->canonical_app_id))
+        {
+          application_free (app);
+          continue;
+        }
+
+      g_debug ("Processing queued application %s", app->canonical_app_id);
+
+      add_application (panel, app);
     }
 
-  g_debug ("Processing queued application %s", app->canonical_app_id);
+  if (panel->pending_apps_index < panel->pending_apps->len)
+    return G_SOURCE_CONTINUE;
 
-  add_application (panel, app);
-  g_object_unref (panel);
+  free_pending_apps (panel);
+  panel->pending_apps_id = 0;
 
-  return FALSE;
+  return G_SOURCE_REMOVE;
 }
 
 static char *
-app_info_get_id (GAppInfo *app_info)
+get_apps_cache_filename (void)
 {
-  const char *desktop_id;
-  char *ret;
-  const char *filename;
-  int l;
+  return g_build_filename (g_get_user_cache_dir (),
+                           "gnome-control-center",
+                           "notifications-apps.cache",
+                           NULL);
+}
 
-  desktop_id = g_app_info_get_id (app_info);
-  if (desktop_id != NULL)
+static int
+compare_file_names (gconstpointer a,
+                    gconstpointer b)
+{
+  return strcmp (*(const char **) a, *(const char **) b);
+}
+
+static void
+add_apps_dir_state (GVariantBuilder *builder,
+                    const char      *path)
+{
+  GPtrArray *names;
+  GStatBuf buf;
+  const char *name;
+  GDir *dir;
+  guint i;
+
+  if (g_stat (path, &buf) != 0)
     {
-      ret = g_strdup (desktop_id);
+      g_variant_builder_add (builder, "(sx)", path, (gint64) -1);
+      return;
     }
-  else
+
+  g_variant_builder_add (builder, "(sx)", path, (gint64) buf.st_mtime);
+
+  dir = g_dir_open (path, 0, NULL);
+  if (dir == NULL)
+    return;
+
+  /* Keep the state the same from one run to the next */
+  names = g_ptr_array_new_with_free_func (g_free);
+  while ((name = g_dir_read_name (dir)) != NULL)
+    g_ptr_array_add (names, g_strdup (name));
+  g_dir_close (dir);
+  g_ptr_array_sort (names, compare_file_names);
+
+  for (i = 0; i < names->len; i++)
     {
-      filename = g_desktop_app_info_get_filename (G_DESKTOP_APP_INFO (app_info));
-      ret = g_path_get_basename (filename);
+      char *child;
+
+      child = g_build_filename (path, names->pdata[i], NULL);
+
+      /* Desktop files can be edited in place, and live in vendor
+       * subdirectories like kde4/, neither of which touch the mtime
+       * of the top-level directory */
+      if (g_file_test (child, G_FILE_TEST_IS_DIR))
+        add_apps_dir_state (builder, child);
+      else if (g_str_has_suffix (child, ".desktop") &&
+               g_stat (child, &buf) == 0)
+        g_variant_builder_add (builder, "(sx)", child, (gint64) buf.st_mtime);
+
+      g_free (child);
     }
 
-  if (G_UNLIKELY (g_str_has_suffix (ret, ".desktop") == FALSE))
+  g_ptr_array_unref (names);
+}
+
+/* The desktop files, their directories and their modification times;
+ * installing, removing or updating an application changes those, and
+ * invalidates the cache */
+static GVariant *
+get_apps_dirs_state (void)
+{
+  GVariantBuilder builder;
+  const char * const *dirs;
+  char *path;
+  guint i;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sx)"));
+
+  path = g_build_filename (g_get_user_data_dir (), "applications", NULL);
+  add_apps_dir_state (&builder, path);
+  g_free (path);
+
+  dirs = g_get_system_data_dirs ();
+  for (i = 0; dirs[i] != NULL; i++)
     {
-      g_free (ret);
+      path = g_build_filename (dirs[i], "applications", NULL);
+      add_apps_dir_state (&builder, path);
+      g_free (path);
+    }
+
+  return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+static char **
+load_cached_app_ids (GVariant *dirs_state)
+{
+  GVariant *cache, *cached_state;
+  GBytes *bytes;
+  char *filename, *contents;
+  char **app_ids = NULL;
+  gsize length;
+  guint32 version;
+
+  filename = get_apps_cache_filename ();
+  if (!g_file_get_contents (filename, &contents, &length, NULL))
+    {
+      g_free (filename);
       return NULL;
     }
+  g_free (filename);
 
-  l = strlen (desktop_id);
-  *(ret + l - strlen(".desktop")) = '\0';
-  return ret;
+  bytes = g_bytes_new_take (contents, length);
+  cache = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (APPS_CACHE_TYPE),
+                                                        bytes, FALSE));
+  g_bytes_unref (bytes);
+
+  g_variant_get_child (cache, 0, "u", &version);
+  cached_state = g_variant_get_child_value (cache, 1);
+
+  if (version == APPS_CACHE_VERSION &&
+      g_variant_equal (cached_state, dirs_state))
+    g_variant_get_child (cache, 2, "^as", &app_ids);
+
+  g_variant_unref (cached_state);
+  g_variant_unref (cache);
+
+  return app_ids;
 }
 
 static void
-process_app_info (CcNotificationsPanel *panel,
-                  GTask                *task,
-                  GAppInfo             *app_info)
+save_cached_app_ids (GVariant           *dirs_state,
+                     const char * const *app_ids)
 {
-  Application *app;
-  char *app_id;
-  char *canonical_app_id;
-  char *path;
-  GSettings *settings;
-  GSource *source;
-  guint i;
+  GVariant *cache;
+  GError *error = NULL;
+  char *filename, *dirname;
 
-  app_id = app_info_get_id (app_info);
-  canonical_app_id = g_strcanon (app_id,
-                                 "0123456789"
-                                 "abcdefghijklmnopqrstuvwxyz"
-                                 "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-                                 "-",
-                                 '-');
-  for (i = 0; canonical_app_id[i] != '\0'; i++)
-    canonical_app_id[i] = g_ascii_tolower (canonical_app_id[i]);
+  cache = g_variant_ref_sink (g_variant_new ("(u@a(sx)^as)",
+                                             APPS_CACHE_VERSION,
+                                             dirs_state,
+                                             app_ids));
 
-  path = g_strconcat (APP_PREFIX, canonical_app_id, "/", NULL);
-  settings = g_settings_new_with_path (APP_SCHEMA, path);
+  filename = get_apps_cache_filename ();
+  dirname = g_path_get_dirname (filename);
+  g_mkdir_with_parents (dirname, USER_DIR_MODE);
 
-  app = g_slice_new (Application);
-  app->canonical_app_id = canonical_app_id;
-  app->settings = settings;
-  app->app_info = g_object_ref (app_info);
-  app->panel = g_object_ref (panel);
+  if (!g_file_set_contents (filename,
+                            g_variant_get_data (cache),
+                            g_variant_get_size (cache),
+                            &error))
+    {
+      g_debug ("Could not save the notification applications cache: %s", error->message);
+      g_error_free (error);
+    }
 
-  source = g_idle_source_new ();
-  g_source_set_callback (source, queued_app_info, app, NULL);
-  g_source_attach (source, g_task_get_context (task));
+  g_free (dirname);
+  g_free (filename);
+  g_variant_unref (cache);
+}
 
-  g_free (path);
+static void
+add_app_info (GPtrArray *apps,
+              GAppInfo  *app_info)
+{
+  char *canonical_app_id;
+
+  canonical_app_id = app_info_get_canonical_id (app_info);
+  if (canonical_app_id == NULL)
+    return;
+
+  g_ptr_array_add (apps, application_new (canonical_app_id,
+                                          g_object_ref (app_info),
+                                          NULL));
 }
 
 static void
@@ -467,24 +727,91 @@ load_apps_thread (GTask        *task,
                   gpointer      task_data,
                   GCancellable *cancellable)
 {
-  GList *iter, *apps;
+  GPtrArray *apps;
+  GVariant *dirs_state;
+  char **app_ids;
+  guint i;
+
+  apps = g_ptr_array_new_with_free_func ((GDestroyNotify) application_free);
+  dirs_state = get_apps_dirs_state ();
+  app_ids = load_cached_app_ids (dirs_state);
+
+  if (app_ids != NULL)
+    {
+      /* Only the applications known to use notifications need to be loaded */
+      for (i = 0; app_ids[i] != NULL && !g_cancellable_is_cancelled (cancellable); i++)
+        {
+          GDesktopAppInfo *app;
+
+          app = g_desktop_app_info_new (app_ids[i]);
+          if (app == NULL)
+            continue;
+
+          g_debug ("Processing cached app '%s'", app_ids[i]);
+          add_app_info (apps, G_APP_INFO (app));
+          g_object_unref (app);
+        }
+    }
+  else
+    {
+      GList *iter, *all_apps;
+      GPtrArray *ids;
+
+      all_apps = g_app_info_get_all ();
+      ids = g_ptr_array_new ();
+
+      for (iter = all_apps; iter && !g_cancellable_is_cancelled (cancellable); iter = iter->next)
+        {
+          GDesktopAppInfo *app;
+
+          app = iter->data;
+          if (g_desktop_app_info_get_boolean (app, "X-GNOME-UsesNotifications")) {
+            add_app_info (apps, G_APP_INFO (app));
+            g_ptr_array_add (ids, (gpointer) g_app_info_get_id (G_APP_INFO (app)));
+            g_debug ("Processing app '%s'", g_app_info_get_id (G_APP_INFO (app)));
+          } else {
+            g_debug ("Skipped app '%s', doesn't use notifications", g_app_info_get_id (G_APP_INFO (app)));
+          }
+        }
+
+      g_ptr_array_add (ids, NULL);
+      if (!g_cancellable_is_cancelled (cancellable))
+        save_cached_app_ids (dirs_state, (const char * const *) ids->pdata);
+
+      g_ptr_array_free (ids, TRUE);
+      g_list_free_full (all_apps, g_object_unref);
+    }
+
+  g_strfreev (app_ids);
+  g_variant_unref (dirs_state);
+
+  g_task_return_pointer (task, apps, (GDestroyNotify) g_ptr_array_unref);
+}
 
-  apps = g_app_info_get_all ();
+static void
+load_apps_cb (GObject      *source_object,
+              GAsyncResult *res,
+              gpointer      user_data)
+{
+  CcNotificationsPanel *panel;
+  GPtrArray *apps;
+  GError *error = NULL;
 
-  for (iter = apps; iter && !g_cancellable_is_cancelled (cancellable); iter = iter->next)
+  apps = g_task_propagate_pointer (G_TASK (res), &error);
+  if (apps == NULL)
     {
-      GDesktopAppInfo *app;
-
-      app = iter->data;
-      if (g_desktop_app_info_get_boolean (app, "X-GNOME-UsesNotifications")) {
-        process_app_info (panel, task, G_APP_INFO (app));
-        g_debug ("Processing app '%s'", g_app_info_get_id (G_APP_INFO (app)));
-      } else {
-        g_debug ("Skipped app '%s', doesn't use notifications", g_app_info_get_id (G_APP_INFO (app)));
-      }
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("Failed to load applications: %s", error->message);
+      g_error_free (error);
+      return;
     }
 
-  g_list_free_full (apps, g_object_unref);
+  /* Add the rows a batch at a time, so the panel stays responsive
+   * with a large number of applications */
+  panel = CC_NOTIFICATIONS_PANEL (source_object);
+  panel->pending_apps = apps;
+  panel->pending_apps_index = 0;
+  panel->pending_apps_id = g_idle_add (add_pending_apps, panel);
 }
 
 static void
@@ -493,7 +820,7 @@ load_apps_async (CcNotificationsPanel *panel)
   GTask *task;
 
   panel->apps_load_cancellable = g_cancellable_new ();
-  task = g_task_new (panel, panel->apps_load_cancellable, NULL, NULL);
+  task = g_task_new (panel, panel->apps_load_cancellable, load_apps_cb, NULL);
   g_task_run_in_thread (task, load_apps_thread);
 
   g_object_unref (task);
@@ -535,15 +862,20 @@ select_app (GtkListBox           *list_box,
   Application *app;
 
   app = g_object_get_qdata (G_OBJECT (row), application_quark ());
-  cc_build_edit_dialog (panel, app->app_info, app->settings, panel->master_settings);
+  cc_build_edit_dialog (panel, app->app_info, application_get_settings (app),
+                        panel->master_settings);
 }
 
 static void
 application_free (Application *app)
 {
+  if (app == NULL)
+    return;
+
   g_free (app->canonical_app_id);
+  g_free (app->collate_key);
   g_object_unref (app->app_info);
-  g_object_unref (app->settings);
+  g_clear_object (&app->settings);
 
   g_slice_free (Application, app);
 }
@@ -558,6 +890,5 @@ sort_apps (gconstpointer one,
   a1 = g_object_get_qdata (G_OBJECT (one), application_quark ());
   a2 = g_object_get_qdata (G_OBJECT (two), application_quark ());
 
-  return g_utf8_collate (g_app_info_get_name (a1->app_info),
-                         g_app_info_get_name (a2->app_info));
+  return strcmp (a1->collate_key, a2->collate_key);
 }
@@ -24,6 +24,7 @@
 
 #include "shell/list-box-helper.h"
 #include "cc-common-language.h"
+#include "cc-locale-catalog.h"
 #include "cc-util.h"
 #include "cc-input-chooser.h"
 
@@ -68,6 +69,8 @@ typedef struct {
   gboolean showing_extra;
   guint filter_timeout_id;
   gchar **filter_words;
+  GHashTable *search_index;
+  GHashTable *matching_rows;
 
   gboolean is_login;
 } CcInputChooserPrivate;
@@ -85,8 +88,19 @@ typedef struct {
   GtkListBoxRow *back_row;
   GHashTable *layout_rows_by_id;
   GHashTable *engine_rows_by_id;
+
+  /* Filter state, see update_matches() */
+  gboolean name_matches;
+  gboolean source_matches;
 } LocaleInfo;
 
+/* What carries a given search key: locales named so in either
+ * language, and input source rows */
+typedef struct {
+  GPtrArray *locales;
+  GPtrArray *rows;
+} SearchEntry;
+
 static void
 locale_info_free (gpointer data)
 {
@@ -104,6 +118,16 @@ locale_info_free (gpointer data)
   g_free (info);
 }
 
+static void
+search_entry_free (gpointer data)
+{
+  SearchEntry *entry = data;
+
+  g_ptr_array_free (entry->locales, TRUE);
+  g_ptr_array_free (entry->rows, TRUE);
+  g_free (entry);
+}
+
 static void
 set_row_widget_margins (GtkWidget *widget)
 {
@@ -486,24 +510,6 @@ match_all (gchar       **words,
   return TRUE;
 }
 
-static gboolean
-match_source_in_table (gchar      **words,
-                       GHashTable  *table)
-{
-  GHashTableIter iter;
-  gpointer row;
-  const gchar *source_name;
-
-  g_hash_table_iter_init (&iter, table);
-  while (g_hash_table_iter_next (&iter, NULL, &row))
-    {
-      source_name = g_object_get_data (G_OBJECT (row), "unaccented-name");
-      if (source_name && match_all (words, source_name))
-        return TRUE;
-    }
-  return FALSE;
-}
-
 static gboolean
 list_filter (GtkListBoxRow *row,
              gpointer   user_data)
@@ -512,7 +518,6 @@ list_filter (GtkListBoxRow *row,
   CcInputChooserPrivate *priv = GET_PRIVATE (chooser);
   LocaleInfo *info;
   gboolean is_extra;
-  const gchar *source_name;
 
   if (row == priv->more_row)
     return !priv->showing_extra;
@@ -530,27 +535,137 @@ list_filter (GtkListBoxRow *row,
   if (row == info->back_row)
     return TRUE;
 
-  if (match_all (priv->filter_words, info->unaccented_name))
+  if (info->name_matches)
     return TRUE;
 
-  if (match_all (priv->filter_words, info->untranslated_name))
-    return TRUE;
+  /* Input sources show up on their own, locales when any of theirs does */
+  if (g_object_get_data (G_OBJECT (row), "unaccented-name"))
+    return g_hash_table_contains (priv->matching_rows, row);
+  else
+    return info->source_matches;
+}
+
+static void
+add_to_search_index (GHashTable  *index,
+                     const gchar *key,
+                     LocaleInfo  *info,
+                     gpointer     row)
+{
+  SearchEntry *entry;
+
+  if (key == NULL || key[0] == '\0')
+    return;
 
-  source_name = g_object_get_data (G_OBJECT (row), "unaccented-name");
-  if (source_name)
+  entry = g_hash_table_lookup (index, key);
+  if (!entry)
     {
-      if (match_all (priv->filter_words, source_name))
-        return TRUE;
+      entry = g_new0 (SearchEntry, 1);
+      entry->locales = g_ptr_array_new ();
+      entry->rows = g_ptr_array_new ();
+      g_hash_table_insert (index, (gpointer) key, entry);
     }
+
+  if (row)
+    g_ptr_array_add (entry->rows, row);
   else
+    g_ptr_array_add (entry->locales, info);
+}
+
+static void
+add_rows_to_search_index (GHashTable *index,
+                          LocaleInfo *info,
+                          GHashTable *rows)
+{
+  GHashTableIter iter;
+  gpointer row;
+
+  g_hash_table_iter_init (&iter, rows);
+  while (g_hash_table_iter_next (&iter, NULL, &row))
+    add_to_search_index (index, g_object_get_data (G_OBJECT (row), "unaccented-name"), info, row);
+}
+
+/* Many layouts are listed under several locales and names repeat, so
+ * the filter words only need matching against each distinct key once.
+ * Called again whenever rows are added, e.g. once IBus shows up.
+ */
+static void
+build_search_index (GtkWidget *chooser)
+{
+  CcInputChooserPrivate *priv = GET_PRIVATE (chooser);
+  GHashTableIter iter;
+  LocaleInfo *info;
+
+  if (priv->search_index == NULL)
     {
-      if (match_source_in_table (priv->filter_words, info->layout_rows_by_id))
-        return TRUE;
-      if (match_source_in_table (priv->filter_words, info->engine_rows_by_id))
-        return TRUE;
+      /* The keys belong to the locales and rows, which outlive the index */
+      priv->search_index = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                  NULL, search_entry_free);
+      priv->matching_rows = g_hash_table_new (NULL, NULL);
+    }
+  else
+    {
+      g_hash_table_remove_all (priv->search_index);
+      g_hash_table_remove_all (priv->matching_rows);
     }
 
-  return FALSE;
+  g_hash_table_iter_init (&iter, priv->locales);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &info))
+    {
+      add_to_search_index (priv->search_index, info->unaccented_name, info, NULL);
+      add_to_search_index (priv->search_index, info->untranslated_name, info, NULL);
+
+      if (info->default_input_source_row)
+        add_to_search_index (priv->search_index,
+                             g_object_get_data (G_OBJECT (info->default_input_source_row), "unaccented-name"),
+                             info, info->default_input_source_row);
+      add_rows_to_search_index (priv->search_index, info, info->layout_rows_by_id);
+      add_rows_to_search_index (priv->search_index, info, info->engine_rows_by_id);
+    }
+}
+
+static void
+update_matches (GtkWidget *chooser)
+{
+  CcInputChooserPrivate *priv = GET_PRIVATE (chooser);
+  GHashTableIter iter;
+  const gchar *key;
+  SearchEntry *entry;
+  LocaleInfo *info;
+  guint i;
+
+  g_hash_table_remove_all (priv->matching_rows);
+
+  g_hash_table_iter_init (&iter, priv->locales);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &info))
+    {
+      info->name_matches = FALSE;
+      info->source_matches = FALSE;
+    }
+
+  if (!priv->filter_words)
+    return;
+
+  g_hash_table_iter_init (&iter, priv->search_index);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &key, (gpointer *) &entry))
+    {
+      if (!match_all (priv->filter_words, key))
+        continue;
+
+      for (i = 0; i < entry->locales->len; i++)
+        {
+          info = entry->locales->pdata[i];
+          info->name_matches = TRUE;
+        }
+
+      for (i = 0; i < entry->rows->len; i++)
+        {
+          GtkListBoxRow *row = entry->rows->pdata[i];
+
+          info = g_object_get_data (G_OBJECT (row), "locale-info");
+          info->source_matches = TRUE;
+          g_hash_table_add (priv->matching_rows, row);
+        }
+    }
 }
 
 static gboolean
@@ -599,6 +714,7 @@ do_filter (GtkWidget *chooser)
     {
       if (!previous_words || strvs_differ (priv->filter_words, previous_words))
         {
+          update_matches (chooser);
           gtk_list_box_invalidate_filter (GTK_LIST_BOX (priv->list));
           gtk_list_box_set_placeholder (GTK_LIST_BOX (priv->list), priv->no_results);
         }
@@ -908,8 +1024,8 @@ get_locale_infos (GtkWidget *chooser)
   CcInputChooserPrivate *priv = GET_PRIVATE (chooser);
   GHashTable *layouts_with_locale;
   LocaleInfo *info;
-  gchar **locale_ids;
-  gchar **locale;
+  GPtrArray *locales;
+  guint i;
   GList *list, *l;
 
   priv->locales = g_hash_table_new_full (g_str_hash, g_str_equal,
@@ -919,18 +1035,19 @@ get_locale_infos (GtkWidget *chooser)
 
   layouts_with_locale = g_hash_table_new (g_str_hash, g_str_equal);
 
-  locale_ids = gnome_get_all_locales ();
-  for (locale = locale_ids; *locale; ++locale)
+  /* Callers wait for the catalog with cc_locale_catalog_wait_ready() */
+  locales = cc_locale_catalog_get ();
+  g_warn_if_fail (locales != NULL);
+  for (i = 0; locales != NULL && i < locales->len; i++)
     {
-      gchar *lang_code, *country_code;
+      const CcLocaleInfo *locale = locales->pdata[i];
+      const CcLocaleInfo *simple;
+      const gchar *lang_code = locale->language_code;
+      const gchar *country_code = locale->country_code;
       gchar *simple_locale;
-      gchar *tmp;
       const gchar *type = NULL;
       const gchar *id = NULL;
 
-      if (!gnome_parse_locale (*locale, &lang_code, &country_code, NULL, NULL))
-        continue;
-
       if (country_code != NULL)
 	simple_locale = g_strdup_printf ("%s_%s.UTF-8", lang_code, country_code);
       else
@@ -939,18 +1056,30 @@ get_locale_infos (GtkWidget *chooser)
       if (g_hash_table_contains (priv->locales, simple_locale))
         {
           g_free (simple_locale);
-          g_free (country_code);
-          g_free (lang_code);
           continue;
         }
 
       info = g_new0 (LocaleInfo, 1);
       info->id = simple_locale; /* Take ownership */
-      info->name = gnome_get_language_from_locale (simple_locale, NULL);
-      info->unaccented_name = cc_util_normalize_casefold_and_unaccent (info->name);
-      tmp = gnome_get_language_from_locale (simple_locale, "C");
-      info->untranslated_name = cc_util_normalize_casefold_and_unaccent (tmp);
-      g_free (tmp);
+
+      /* The simplified locale is nearly always installed too */
+      simple = cc_locale_catalog_lookup (simple_locale);
+      if (simple != NULL)
+        {
+          info->name = g_strdup (simple->language_names[CC_LOCALE_NAME_CURRENT]);
+          info->unaccented_name = g_strdup (simple->language_keys[CC_LOCALE_NAME_CURRENT]);
+          info->untranslated_name = g_strdup (simple->language_keys[CC_LOCALE_NAME_UNTRANSLATED]);
+        }
+      else
+        {
+          gchar *tmp;
+
+          info->name = gnome_get_language_from_locale (simple_locale, NULL);
+          info->unaccented_name = cc_util_normalize_casefold_and_unaccent (info->name);
+          tmp = gnome_get_language_from_locale (simple_locale, "C");
+          info->untranslated_name = cc_util_normalize_casefold_and_unaccent (tmp);
+          g_free (tmp);
+        }
 
       g_hash_table_replace (priv->locales, simple_locale, info);
       add_locale_to_table (priv->locales_by_language, lang_code, info);
@@ -980,11 +1109,7 @@ get_locale_infos (GtkWidget *chooser)
           add_ids_to_set (layouts_with_locale, list);
           g_list_free (list);
         }
-
-      g_free (lang_code);
-      g_free (country_code);
     }
-  g_strfreev (locale_ids);
 
   /* Add a "Other" locale to hold the remaining input sources */
   info = g_new0 (LocaleInfo, 1);
@@ -1019,6 +1144,8 @@ cc_input_chooser_private_free (gpointer data)
   g_hash_table_destroy (priv->locales);
   g_hash_table_destroy (priv->locales_by_language);
   g_strfreev (priv->filter_words);
+  g_hash_table_destroy (priv->search_index);
+  g_hash_table_destroy (priv->matching_rows);
   if (priv->filter_timeout_id)
     g_source_remove (priv->filter_timeout_id);
   g_free (priv);
@@ -1089,6 +1216,7 @@ cc_input_chooser_new (GtkWindow    *main_window,
 #ifdef HAVE_IBUS
   get_ibus_locale_infos (chooser);
 #endif  /* HAVE_IBUS */
+  build_search_index (chooser);
   show_locale_rows (chooser);
 
   /* Try to come up with a sensible size */
@@ -1116,6 +1244,12 @@ cc_input_chooser_set_ibus_engines (GtkWidget  *chooser,
 
   priv->ibus_engines = ibus_engines;
   get_ibus_locale_infos (chooser);
+
+  /* Make the new engine rows searchable before they are shown with
+     the current filter */
+  build_search_index (chooser);
+  update_matches (chooser);
+
   show_locale_rows (chooser);
 #endif  /* HAVE_IBUS */
 }
@@ -35,6 +35,7 @@
 #include "cc-input-options.h"
 
 #include "cc-common-language.h"
+#include "cc-locale-catalog.h"
 
 #define GNOME_DESKTOP_USE_UNSTABLE_API
 #include <libgnome-desktop/gnome-languages.h>
@@ -75,6 +76,8 @@ typedef enum {
         MOVE_DOWN_INPUT,
 } SystemOp;
 
+typedef void (*ShowChooserFunc) (CcRegionPanel *self);
+
 struct _CcRegionPanelPrivate {
 	GtkBuilder *builder;
 
@@ -87,6 +90,7 @@ struct _CcRegionPanelPrivate {
         GDBusProxy  *localed;
         GDBusProxy  *session;
         GCancellable *cancellable;
+        ShowChooserFunc pending_chooser;
 
         GtkWidget *overlay;
         GtkWidget *notification;
@@ -456,12 +460,53 @@ get_effective_language (CcRegionPanel *self)
                 return priv->language;
 }
 
+static void
+catalog_ready (GObject      *source_object,
+               GAsyncResult *res,
+               gpointer      user_data)
+{
+        CcRegionPanel *self;
+        ShowChooserFunc show_chooser;
+
+        if (!cc_locale_catalog_wait_ready_finish (res, NULL))
+                return;
+
+        self = CC_REGION_PANEL (user_data);
+        show_chooser = self->priv->pending_chooser;
+        self->priv->pending_chooser = NULL;
+
+        if (show_chooser != NULL)
+                show_chooser (self);
+}
+
+/* The choosers need the locale catalog, which is built in the
+ * background; open them once it is ready rather than waiting for it.
+ * If several are asked for meanwhile, the last one asked for opens. */
+static gboolean
+wait_for_catalog (CcRegionPanel   *self,
+                  ShowChooserFunc  show_chooser)
+{
+        CcRegionPanelPrivate *priv = self->priv;
+
+        if (cc_locale_catalog_is_ready ())
+                return FALSE;
+
+        if (priv->pending_chooser == NULL)
+                cc_locale_catalog_wait_ready (priv->cancellable, catalog_ready, self);
+        priv->pending_chooser = show_chooser;
+
+        return TRUE;
+}
+
 static void
 show_language_chooser (CcRegionPanel *self)
 {
         GtkWidget *toplevel;
         GtkWidget *chooser;
 
+        if (wait_for_catalog (self, show_language_chooser))
+                return;
+
         toplevel = gtk_widget_get_toplevel (GTK_WIDGET (self));
         chooser = cc_language_chooser_new (toplevel);
         cc_language_chooser_set_language (chooser, get_effective_language (self));
@@ -496,6 +541,9 @@ show_region_chooser (CcRegionPanel *self)
         GtkWidget *toplevel;
         GtkWidget *chooser;
 
+        if (wait_for_catalog (self, show_region_chooser))
+                return;
+
         toplevel = gtk_widget_get_toplevel (GTK_WIDGET (self));
         chooser = cc_format_chooser_new (toplevel);
         cc_format_chooser_set_region (chooser, get_effective_region (self));
@@ -1139,6 +1187,9 @@ show_input_chooser (CcRegionPanel *self)
         GtkWidget *chooser;
         GtkWidget *toplevel;
 
+        if (wait_for_catalog (self, show_input_chooser))
+                return;
+
         chooser = g_object_get_data (G_OBJECT (self), "input-chooser");
 
         if (!chooser) {
@@ -1852,6 +1903,9 @@ cc_region_panel_init (CcRegionPanel *self)
         setup_language_section (self);
         setup_input_section (self);
 
+        /* Have the locale choosers' data ready when they are opened */
+        cc_locale_catalog_prefetch ();
+
         priv->overlay = GTK_WIDGET (gtk_builder_get_object (priv->builder, "overlay"));
 	gtk_container_add (GTK_CONTAINER (self), priv->overlay);
 }
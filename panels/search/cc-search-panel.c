@@ -18,12 +18,15 @@
  * Author: Cosimo Cecchi <cosimoc@gnome.org>
  */
 
+#include <config.h>
+
 #include "cc-search-panel.h"
 #include "cc-search-locations-dialog.h"
 #include "cc-search-resources.h"
 
 #include <gio/gdesktopappinfo.h>
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 
 CC_PANEL_REGISTER (CcSearchPanel, cc_search_panel)
 
@@ -40,11 +43,26 @@ struct _CcSearchPanelPrivate
   GSettings  *search_settings;
   GHashTable *sort_order;
 
+  GHashTable *provider_rows;
+  GList      *provider_monitors;
+  GtkWidget  *no_providers_label;
+
   CcSearchLocationsDialog  *locations_dialog;
 };
 
 #define SHELL_PROVIDER_GROUP "Shell Search Provider"
 
+/* Bump when the format of the providers cache changes */
+#define PROVIDERS_CACHE_VERSION 1
+#define PROVIDERS_CACHE_TYPE "(ua(sx)a(ssb))"
+
+typedef struct
+{
+  gchar    *path;
+  gchar    *desktop_id;
+  gboolean  default_disabled;
+} SearchProvider;
+
 static gint
 list_sort_func (gconstpointer a,
                 gconstpointer b,
@@ -171,6 +189,9 @@ search_panel_set_no_providers (CcSearchPanel *self)
 {
   GtkWidget *w;
 
+  if (self->priv->no_providers_label != NULL)
+    return;
+
   /* center the list box in the scrolled window */
   gtk_widget_set_valign (self->priv->list_box, GTK_ALIGN_CENTER);
 
@@ -178,6 +199,21 @@ search_panel_set_no_providers (CcSearchPanel *self)
   gtk_widget_show (w);
 
   gtk_container_add (GTK_CONTAINER (self->priv->list_box), w);
+  self->priv->no_providers_label = w;
+}
+
+static void
+search_panel_unset_no_providers (CcSearchPanel *self)
+{
+  if (self->priv->no_providers_label == NULL)
+    return;
+
+  /* the label got wrapped in a row by the list box */
+  gtk_widget_destroy (gtk_widget_get_parent (self->priv->no_providers_label));
+  self->priv->no_providers_label = NULL;
+
+  /* reset valignment of the list box */
+  gtk_widget_set_valign (self->priv->list_box, GTK_ALIGN_FILL);
 }
 
 static void
@@ -428,10 +464,11 @@ switch_settings_mapping_get_default_disabled (GValue *value,
                                               user_data, FALSE);
 }
 
-static void
+static GtkWidget *
 search_panel_add_one_app_info (CcSearchPanel *self,
                                GAppInfo *app_info,
-                               gboolean default_enabled)
+                               gboolean default_enabled,
+                               gint position)
 {
   GtkWidget *row, *box, *w;
   GIcon *icon;
@@ -441,10 +478,9 @@ search_panel_add_one_app_info (CcSearchPanel *self,
      and is not configurable */
   if (g_strcmp0 (g_app_info_get_id (app_info),
                  "gnome-control-center.desktop") == 0)
-    return;
+    return NULL;
 
-  /* reset valignment of the list box */
-  gtk_widget_set_valign (self->priv->list_box, GTK_ALIGN_FILL);
+  search_panel_unset_no_providers (self);
 
   row = gtk_list_box_row_new ();
   box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
@@ -454,7 +490,7 @@ search_panel_add_one_app_info (CcSearchPanel *self,
   g_object_set_data_full (G_OBJECT (row), "app-info",
                           g_object_ref (app_info), g_object_unref);
   g_object_set_data (G_OBJECT (row), "self", self);
-  gtk_container_add (GTK_CONTAINER (self->priv->list_box), row);
+  gtk_list_box_insert (GTK_LIST_BOX (self->priv->list_box), row, position);
 
   icon = g_app_info_get_icon (app_info);
   if (icon == NULL)
@@ -495,19 +531,26 @@ search_panel_add_one_app_info (CcSearchPanel *self,
     }
 
   gtk_widget_show_all (row);
+
+  return row;
 }
 
 static void
-search_panel_add_one_provider (CcSearchPanel *self,
-                               GFile *provider)
+search_provider_free (SearchProvider *provider)
+{
+  g_free (provider->path);
+  g_free (provider->desktop_id);
+  g_slice_free (SearchProvider, provider);
+}
+
+static SearchProvider *
+search_provider_load (const gchar *path)
 {
-  gchar *path, *desktop_id;
+  SearchProvider *provider = NULL;
   GKeyFile *keyfile;
-  GAppInfo *app_info;
   GError *error = NULL;
-  gboolean default_disabled;
+  gchar *desktop_id;
 
-  path = g_file_get_path (provider);
   keyfile = g_key_file_new ();
   g_key_file_load_from_file (keyfile, path, G_KEY_FILE_NONE, &error);
 
@@ -531,21 +574,147 @@ search_panel_add_one_provider (CcSearchPanel *self,
       goto out;
     }
 
-  app_info = G_APP_INFO (g_desktop_app_info_new (desktop_id));
-  g_free (desktop_id);
+  provider = g_slice_new (SearchProvider);
+  provider->path = g_strdup (path);
+  provider->desktop_id = desktop_id;
+  provider->default_disabled = g_key_file_get_boolean (keyfile, SHELL_PROVIDER_GROUP,
+                                                       "DefaultDisabled", NULL);
 
+ out:
+  g_clear_error (&error);
+  g_key_file_unref (keyfile);
+
+  return provider;
+}
+
+static GtkWidget *
+search_panel_add_one_provider (CcSearchPanel *self,
+                               SearchProvider *provider,
+                               gint position)
+{
+  GAppInfo *app_info;
+  GtkWidget *row;
+
+  app_info = G_APP_INFO (g_desktop_app_info_new (provider->desktop_id));
   if (app_info == NULL)
-    goto out;
+    return NULL;
 
-  default_disabled = g_key_file_get_boolean (keyfile, SHELL_PROVIDER_GROUP,
-                                             "DefaultDisabled", NULL);
-  search_panel_add_one_app_info (self, app_info, !default_disabled);
+  row = search_panel_add_one_app_info (self, app_info, !provider->default_disabled, position);
   g_object_unref (app_info);
 
- out:
+  if (row == NULL)
+    return NULL;
+
+  g_hash_table_replace (self->priv->provider_rows, g_strdup (provider->path), row);
+
+  return row;
+}
+
+static void
+search_panel_remove_one_provider (CcSearchPanel *self,
+                                  const gchar *path)
+{
+  GtkWidget *row;
+
+  row = g_hash_table_lookup (self->priv->provider_rows, path);
+  if (row == NULL)
+    return;
+
+  g_hash_table_remove (self->priv->provider_rows, path);
+  gtk_widget_destroy (row);
+
+  if (g_hash_table_size (self->priv->provider_rows) == 0)
+    search_panel_set_no_providers (self);
+  else
+    search_panel_invalidate_button_state (self);
+}
+
+static void
+search_providers_changed (GFileMonitor *monitor,
+                          GFile *file,
+                          GFile *other_file,
+                          GFileMonitorEvent event_type,
+                          CcSearchPanel *self)
+{
+  SearchProvider *provider = NULL;
+  GtkWidget *old_row, *row = NULL;
+  gchar *path;
+
+  if (event_type != G_FILE_MONITOR_EVENT_CREATED &&
+      event_type != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT &&
+      event_type != G_FILE_MONITOR_EVENT_DELETED)
+    return;
+
+  /* only touch the row of the provider that changed, instead of
+   * rescanning all the directories */
+  path = g_file_get_path (file);
+  old_row = g_hash_table_lookup (self->priv->provider_rows, path);
+
+  if (event_type != G_FILE_MONITOR_EVENT_DELETED &&
+      g_file_test (path, G_FILE_TEST_IS_REGULAR))
+    provider = search_provider_load (path);
+
+  /* swap the new row in where the old one was, so that the list
+   * doesn't flash through the empty state */
+  if (provider != NULL)
+    row = search_panel_add_one_provider (self, provider,
+                                         old_row ? gtk_list_box_row_get_index (GTK_LIST_BOX_ROW (old_row)) : -1);
+  g_clear_pointer (&provider, search_provider_free);
+
+  if (row != NULL)
+    {
+      if (old_row != NULL)
+        {
+          if (gtk_list_box_get_selected_row (GTK_LIST_BOX (self->priv->list_box)) == GTK_LIST_BOX_ROW (old_row))
+            gtk_list_box_select_row (GTK_LIST_BOX (self->priv->list_box), GTK_LIST_BOX_ROW (row));
+          gtk_widget_destroy (old_row);
+        }
+
+      search_panel_invalidate_button_state (self);
+      search_panel_propagate_sort_order (self);
+    }
+  else
+    {
+      search_panel_remove_one_provider (self, path);
+    }
+
   g_free (path);
-  g_clear_error (&error);
-  g_key_file_unref (keyfile);
+}
+
+static gchar *
+search_providers_get_directory (const gchar *system_dir)
+{
+  return g_build_filename (system_dir, "gnome-shell", "search-providers", NULL);
+}
+
+static void
+search_panel_monitor_providers (CcSearchPanel *self)
+{
+  const gchar * const *system_data_dirs;
+  GFileMonitor *monitor;
+  GFile *location;
+  gchar *path;
+  int idx;
+
+  system_data_dirs = g_get_system_data_dirs ();
+  for (idx = 0; system_data_dirs[idx] != NULL; idx++)
+    {
+      path = search_providers_get_directory (system_data_dirs[idx]);
+      location = g_file_new_for_path (path);
+
+      monitor = g_file_monitor_directory (location, G_FILE_MONITOR_NONE,
+                                          NULL, NULL);
+      if (monitor != NULL)
+        {
+          g_signal_connect (monitor, "changed",
+                            G_CALLBACK (search_providers_changed), self);
+          self->priv->provider_monitors = g_list_prepend (self->priv->provider_monitors,
+                                                          monitor);
+        }
+
+      g_object_unref (location);
+      g_free (path);
+    }
 }
 
 static void
@@ -553,10 +722,10 @@ search_providers_discover_ready (GObject *source,
                                  GAsyncResult *result,
                                  gpointer user_data)
 {
-  GList *providers, *l;
-  GFile *provider;
+  GPtrArray *providers;
   CcSearchPanel *self = CC_SEARCH_PANEL (source);
   GError *error = NULL;
+  guint idx;
 
   providers = g_task_propagate_pointer (G_TASK (result), &error);
 
@@ -567,39 +736,171 @@ search_providers_discover_ready (GObject *source,
     }
 
   g_clear_object (&self->priv->load_cancellable);
+  search_panel_monitor_providers (self);
 
-  if (providers == NULL)
+  for (idx = 0; providers != NULL && idx < providers->len; idx++)
+    search_panel_add_one_provider (self, g_ptr_array_index (providers, idx), -1);
+
+  if (g_hash_table_size (self->priv->provider_rows) == 0)
+    search_panel_set_no_providers (self);
+  else
+    /* propagate a write to GSettings, to make sure we always have
+     * all the providers in the list.
+     */
+    search_panel_propagate_sort_order (self);
+
+  g_clear_pointer (&providers, g_ptr_array_unref);
+}
+
+static gchar *
+search_providers_get_cache_filename (void)
+{
+  return g_build_filename (g_get_user_cache_dir (),
+                           "gnome-control-center",
+                           "search-providers.cache",
+                           NULL);
+}
+
+/* The provider directories and their modification times; adding or
+ * removing a provider changes those, and invalidates the cache */
+static GVariant *
+search_providers_get_directories_state (void)
+{
+  GVariantBuilder builder;
+  const gchar * const *system_data_dirs;
+  GStatBuf buf;
+  gchar *path;
+  gint64 mtime;
+  int idx;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sx)"));
+
+  system_data_dirs = g_get_system_data_dirs ();
+  for (idx = 0; system_data_dirs[idx] != NULL; idx++)
     {
-      search_panel_set_no_providers (self);
-      return;
+      path = search_providers_get_directory (system_data_dirs[idx]);
+      if (g_stat (path, &buf) == 0)
+        mtime = buf.st_mtime;
+      else
+        mtime = -1;
+
+      g_variant_builder_add (&builder, "(sx)", path, mtime);
+      g_free (path);
     }
 
-  for (l = providers; l != NULL; l = l->next)
+  return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+static GPtrArray *
+search_providers_load_cache (GVariant *directories_state)
+{
+  GPtrArray *providers = NULL;
+  GVariant *cache, *cached_state;
+  GVariantIter *iter;
+  SearchProvider *provider;
+  GBytes *bytes;
+  gchar *filename, *contents;
+  const gchar *path, *desktop_id;
+  gboolean default_disabled;
+  guint32 version;
+  gsize length;
+
+  filename = search_providers_get_cache_filename ();
+  if (!g_file_get_contents (filename, &contents, &length, NULL))
     {
-      provider = l->data;
-      search_panel_add_one_provider (self, provider);
-      g_object_unref (provider);
+      g_free (filename);
+      return NULL;
     }
+  g_free (filename);
 
-  /* propagate a write to GSettings, to make sure we always have
-   * all the providers in the list.
-   */
-  search_panel_propagate_sort_order (self);
-  g_list_free (providers);
+  bytes = g_bytes_new_take (contents, length);
+  cache = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (PROVIDERS_CACHE_TYPE),
+                                                        bytes, FALSE));
+  g_bytes_unref (bytes);
+
+  g_variant_get_child (cache, 0, "u", &version);
+  cached_state = g_variant_get_child_value (cache, 1);
+
+  if (version == PROVIDERS_CACHE_VERSION &&
+      g_variant_equal (cached_state, directories_state))
+    {
+      providers = g_ptr_array_new_with_free_func ((GDestroyNotify) search_provider_free);
+
+      g_variant_get_child (cache, 2, "a(ssb)", &iter);
+      while (g_variant_iter_next (iter, "(&s&sb)", &path, &desktop_id, &default_disabled))
+        {
+          provider = g_slice_new (SearchProvider);
+          provider->path = g_strdup (path);
+          provider->desktop_id = g_strdup (desktop_id);
+          provider->default_disabled = default_disabled;
+          g_ptr_array_add (providers, provider);
+        }
+      g_variant_iter_free (iter);
+    }
+
+  g_variant_unref (cached_state);
+  g_variant_unref (cache);
+
+  return providers;
 }
 
-static GList *
+static void
+search_providers_save_cache (GVariant *directories_state,
+                             GPtrArray *providers)
+{
+  GVariantBuilder builder;
+  SearchProvider *provider;
+  GVariant *cache;
+  GError *error = NULL;
+  gchar *filename, *dirname;
+  guint idx;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ssb)"));
+  for (idx = 0; idx < providers->len; idx++)
+    {
+      provider = g_ptr_array_index (providers, idx);
+      g_variant_builder_add (&builder, "(ssb)",
+                             provider->path,
+                             provider->desktop_id,
+                             provider->default_disabled);
+    }
+
+  cache = g_variant_ref_sink (g_variant_new ("(u@a(sx)a(ssb))",
+                                             PROVIDERS_CACHE_VERSION,
+                                             directories_state,
+                                             &builder));
+
+  filename = search_providers_get_cache_filename ();
+  dirname = g_path_get_dirname (filename);
+  g_mkdir_with_parents (dirname, USER_DIR_MODE);
+
+  if (!g_file_set_contents (filename,
+                            g_variant_get_data (cache),
+                            g_variant_get_size (cache),
+                            &error))
+    {
+      g_debug ("Could not save the search providers cache: %s", error->message);
+      g_error_free (error);
+    }
+
+  g_free (dirname);
+  g_free (filename);
+  g_variant_unref (cache);
+}
+
+static void
 search_providers_discover_one_directory (const gchar *system_dir,
+                                         GPtrArray *providers,
                                          GCancellable *cancellable)
 {
-  GList *providers = NULL;
-  gchar *providers_path;
-  GFile *providers_location, *provider;
+  gchar *providers_path, *path;
+  GFile *providers_location;
   GFileInfo *info;
   GFileEnumerator *enumerator;
+  SearchProvider *provider;
   GError *error = NULL;
 
-  providers_path = g_build_filename (system_dir, "gnome-shell", "search-providers", NULL);
+  providers_path = search_providers_get_directory (system_dir);
   providers_location = g_file_new_for_path (providers_path);
 
   enumerator = g_file_enumerate_children (providers_location,
@@ -620,8 +921,11 @@ search_providers_discover_one_directory (const gchar *system_dir,
 
   while ((info = g_file_enumerator_next_file (enumerator, cancellable, &error)) != NULL)
     {
-      provider = g_file_get_child (providers_location, g_file_info_get_name (info));
-      providers = g_list_prepend (providers, provider);
+      path = g_build_filename (providers_path, g_file_info_get_name (info), NULL);
+      provider = search_provider_load (path);
+      if (provider != NULL)
+        g_ptr_array_add (providers, provider);
+      g_free (path);
       g_object_unref (info);
     }
 
@@ -637,8 +941,6 @@ search_providers_discover_one_directory (const gchar *system_dir,
   g_clear_object (&enumerator);
   g_clear_object (&providers_location);
   g_free (providers_path);
-
-  return providers;
 }
 
 static void
@@ -647,24 +949,37 @@ search_providers_discover_thread (GTask *task,
                                   gpointer task_data,
                                   GCancellable *cancellable)
 {
-  GList *providers = NULL;
+  GPtrArray *providers;
+  GVariant *directories_state;
   const gchar * const *system_data_dirs;
   int idx;
 
-  system_data_dirs = g_get_system_data_dirs ();
-  for (idx = 0; system_data_dirs[idx] != NULL; idx++)
+  directories_state = search_providers_get_directories_state ();
+  providers = search_providers_load_cache (directories_state);
+
+  if (providers == NULL)
     {
-      providers = g_list_concat (search_providers_discover_one_directory (system_data_dirs[idx], cancellable),
-                                 providers);
+      providers = g_ptr_array_new_with_free_func ((GDestroyNotify) search_provider_free);
 
-      if (g_task_return_error_if_cancelled (task))
+      system_data_dirs = g_get_system_data_dirs ();
+      for (idx = 0; system_data_dirs[idx] != NULL; idx++)
         {
-          g_list_free_full (providers, g_object_unref);
-          return;
+          search_providers_discover_one_directory (system_data_dirs[idx],
+                                                   providers, cancellable);
+
+          if (g_task_return_error_if_cancelled (task))
+            {
+              g_ptr_array_unref (providers);
+              g_variant_unref (directories_state);
+              return;
+            }
         }
+
+      search_providers_save_cache (directories_state, providers);
     }
 
-  g_task_return_pointer (task, providers, NULL);
+  g_variant_unref (directories_state);
+  g_task_return_pointer (task, providers, (GDestroyNotify) g_ptr_array_unref);
 }
 
 static void
@@ -679,6 +994,15 @@ populate_search_providers (CcSearchPanel *self)
   g_object_unref (task);
 }
 
+static void
+search_panel_free_monitor (GFileMonitor *monitor,
+                           CcSearchPanel *self)
+{
+  g_signal_handlers_disconnect_by_func (monitor, search_providers_changed, self);
+  g_file_monitor_cancel (monitor);
+  g_object_unref (monitor);
+}
+
 static void
 cc_search_panel_dispose (GObject *object)
 {
@@ -688,6 +1012,9 @@ cc_search_panel_dispose (GObject *object)
     g_cancellable_cancel (priv->load_cancellable);
   g_clear_object (&priv->load_cancellable);
 
+  g_list_foreach (priv->provider_monitors, (GFunc) search_panel_free_monitor, object);
+  g_clear_pointer (&priv->provider_monitors, g_list_free);
+
   G_OBJECT_CLASS (cc_search_panel_parent_class)->dispose (object);
 }
 
@@ -699,6 +1026,7 @@ cc_search_panel_finalize (GObject *object)
   g_clear_object (&priv->builder);
   g_clear_object (&priv->search_settings);
   g_hash_table_destroy (priv->sort_order);
+  g_hash_table_destroy (priv->provider_rows);
 
   if (priv->locations_dialog)
     gtk_widget_destroy (GTK_WIDGET (priv->locations_dialog));
@@ -791,6 +1119,8 @@ cc_search_panel_init (CcSearchPanel *self)
   self->priv->search_settings = g_settings_new ("org.gnome.desktop.search-providers");
   self->priv->sort_order = g_hash_table_new_full (g_str_hash, g_str_equal,
                                                   g_free, NULL);
+  self->priv->provider_rows = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                     g_free, NULL);
   g_signal_connect_swapped (self->priv->search_settings, "changed::sort-order",
                             G_CALLBACK (search_panel_invalidate_sort_order), self);
   search_panel_invalidate_sort_order (self);
@@ -319,7 +319,7 @@ gvc_level_bar_set_rms_adjustment (GvcLevelBar   *bar,
         g_return_if_fail (GTK_IS_ADJUSTMENT (adjustment));
 
         if (bar->priv->rms_adjustment != NULL) {
-                g_signal_handlers_disconnect_by_func (bar->priv->peak_adjustment,
+                g_signal_handlers_disconnect_by_func (bar->priv->rms_adjustment,
                                                       G_CALLBACK (on_rms_adjustment_value_changed),
                                                       bar);
                 g_object_unref (bar->priv->rms_adjustment);
@@ -327,10 +327,9 @@ gvc_level_bar_set_rms_adjustment (GvcLevelBar   *bar,
 
         bar->priv->rms_adjustment = g_object_ref_sink (adjustment);
 
-
-        g_signal_connect (bar->priv->peak_adjustment,
+        g_signal_connect (bar->priv->rms_adjustment,
                           "value-changed",
-                          G_CALLBACK (on_peak_adjustment_value_changed),
+                          G_CALLBACK (on_rms_adjustment_value_changed),
                           bar);
 
         update_rms_value (bar);
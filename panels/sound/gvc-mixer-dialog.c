@@ -46,6 +46,19 @@
 
 #define SCALE_SIZE 128
 
+/* The level meters record the peak-detected monitor streams at
+ * METER_SAMPLE_RATE, and are updated METER_UPDATE_RATE times per
+ * second with the peak and RMS of the block read in between */
+#define METER_SAMPLE_RATE 100
+#define METER_UPDATE_RATE 20
+#define METER_BLOCK_SIZE  (METER_SAMPLE_RATE / METER_UPDATE_RATE)
+
+typedef struct
+{
+        GtkWidget       *level_bar;
+        gdouble          last_peak;
+} GvcLevelMeter;
+
 #define GVC_MIXER_DIALOG_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), GVC_TYPE_MIXER_DIALOG, GvcMixerDialogPrivate))
 
 struct GvcMixerDialogPrivate
@@ -56,6 +69,7 @@ struct GvcMixerDialogPrivate
         GtkWidget       *output_bar;
         GtkWidget       *input_bar;
         GtkWidget       *input_level_bar;
+        GtkWidget       *output_level_bar;
         GtkWidget       *effects_bar;
         GtkWidget       *output_stream_box;
         GtkWidget       *sound_effects_box;
@@ -78,7 +92,8 @@ struct GvcMixerDialogPrivate
         GtkWidget       *test_dialog;
         GtkSizeGroup    *size_group;
 
-        gdouble          last_input_peak;
+        GvcLevelMeter    input_meter;
+        GvcLevelMeter    output_meter;
         guint            num_apps;
 };
 
@@ -107,6 +122,11 @@ static void     bar_set_stream              (GvcMixerDialog      *dialog,
 
 static void     on_adjustment_value_changed (GtkAdjustment  *adjustment,
                                              GvcMixerDialog *dialog);
+
+static void     create_monitor_stream_for_sink (GvcMixerDialog *dialog,
+                                                GvcMixerStream *stream);
+static void     stop_monitor_stream            (GvcMixerDialog *dialog,
+                                                GvcLevelMeter  *meter);
 static void     on_control_active_output_update (GvcMixerControl *control,
                                                  guint            id,
                                                  GvcMixerDialog  *dialog);
@@ -158,6 +178,9 @@ update_output_settings (GvcMixerDialog      *dialog,
         GtkAdjustment       *adj;
 
         g_debug ("Updating output settings");
+
+        stop_monitor_stream (dialog, &dialog->priv->output_meter);
+
         if (dialog->priv->output_balance_bar != NULL) {
                 gtk_container_remove (GTK_CONTAINER (dialog->priv->output_settings_box),
                                       dialog->priv->output_balance_bar);
@@ -197,6 +220,8 @@ update_output_settings (GvcMixerDialog      *dialog,
 	gtk_adjustment_set_value (adj,
 				  gvc_mixer_stream_get_volume (stream));
 
+        create_monitor_stream_for_sink (dialog, stream);
+
         map = gvc_mixer_stream_get_channel_map (stream);
         if (map == NULL) {
                 g_warning ("Default sink stream has no channel map");
@@ -287,50 +312,70 @@ update_output_settings (GvcMixerDialog      *dialog,
 #define DECAY_STEP .15
 
 static void
-update_input_peak (GvcMixerDialog *dialog,
-                   gdouble         v)
+update_meter (GvcLevelMeter *meter,
+              gdouble        peak,
+              gdouble        rms)
 {
         GtkAdjustment *adj;
 
-        if (dialog->priv->last_input_peak >= DECAY_STEP) {
-                if (v < dialog->priv->last_input_peak - DECAY_STEP) {
-                        v = dialog->priv->last_input_peak - DECAY_STEP;
+        if (meter->last_peak >= DECAY_STEP) {
+                if (peak < meter->last_peak - DECAY_STEP) {
+                        peak = meter->last_peak - DECAY_STEP;
                 }
         }
 
-        dialog->priv->last_input_peak = v;
+        meter->last_peak = peak;
 
-        adj = gvc_level_bar_get_peak_adjustment (GVC_LEVEL_BAR (dialog->priv->input_level_bar));
-        if (v >= 0) {
-                gtk_adjustment_set_value (adj, v);
-        } else {
-                gtk_adjustment_set_value (adj, 0.0);
-        }
+        adj = gvc_level_bar_get_peak_adjustment (GVC_LEVEL_BAR (meter->level_bar));
+        gtk_adjustment_set_value (adj, CLAMP (peak, 0.0, 1.0));
+
+        adj = gvc_level_bar_get_rms_adjustment (GVC_LEVEL_BAR (meter->level_bar));
+        gtk_adjustment_set_value (adj, CLAMP (rms, 0.0, 1.0));
 }
 
+/* Computes the peak and the sum of squares of a block of samples,
+ * using independent accumulators so that the compiler can vectorise
+ * the loop without having to reorder floating point operations */
 static void
-update_input_meter (GvcMixerDialog *dialog,
-                    uint32_t        source_index,
-                    uint32_t        sink_input_idx,
-                    double          v)
+reduce_block (const float *samples,
+              gsize        n_samples,
+              float       *peak,
+              float       *sum_squares)
 {
-        update_input_peak (dialog, v);
+        float  p[4] = { 0.0, 0.0, 0.0, 0.0 };
+        float  s[4] = { 0.0, 0.0, 0.0, 0.0 };
+        gsize  i, j;
+
+        for (i = 0; i + 4 <= n_samples; i += 4) {
+                for (j = 0; j < 4; j++) {
+                        float v = fabsf (samples[i + j]);
+
+                        p[j] = v > p[j] ? v : p[j];
+                        s[j] += v * v;
+                }
+        }
+        for (; i < n_samples; i++) {
+                float v = fabsf (samples[i]);
+
+                p[0] = v > p[0] ? v : p[0];
+                s[0] += v * v;
+        }
+
+        *peak = MAX (MAX (p[0], p[1]), MAX (p[2], p[3]));
+        *sum_squares = (s[0] + s[1]) + (s[2] + s[3]);
 }
 
 static void
 on_monitor_suspended_callback (pa_stream *s,
                                void      *userdata)
 {
-        GvcMixerDialog *dialog;
+        GvcLevelMeter *meter;
 
-        dialog = userdata;
+        meter = userdata;
 
         if (pa_stream_is_suspended (s)) {
                 g_debug ("Stream suspended");
-                update_input_meter (dialog,
-                                    pa_stream_get_device_index (s),
-                                    PA_INVALID_INDEX,
-                                    -1);
+                update_meter (meter, 0.0, 0.0);
         }
 }
 
@@ -339,11 +384,12 @@ on_monitor_read_callback (pa_stream *s,
                           size_t     length,
                           void      *userdata)
 {
-        GvcMixerDialog *dialog;
+        GvcLevelMeter  *meter;
         const void     *data;
-        double          v;
+        gsize           n_samples;
+        float           peak, sum_squares;
 
-        dialog = userdata;
+        meter = userdata;
 
         if (pa_stream_peek (s, &data, &length) < 0) {
                 g_warning ("Failed to read data from stream");
@@ -351,36 +397,32 @@ on_monitor_read_callback (pa_stream *s,
         }
 
         if (!data) {
-                pa_stream_drop (s);
+                /* Either empty, or a hole in the stream */
+                if (length > 0)
+                        pa_stream_drop (s);
                 return;
         }
 
         assert (length > 0);
         assert (length % sizeof (float) == 0);
 
-        v = ((const float *) data)[length / sizeof (float) -1];
+        /* Look at every sample of the block, not just the last one,
+         * so that short peaks between updates aren't lost */
+        n_samples = length / sizeof (float);
+        reduce_block (data, n_samples, &peak, &sum_squares);
 
         pa_stream_drop (s);
 
-        if (v < 0) {
-                v = 0;
-        }
-        if (v > 1) {
-                v = 1;
-        }
-
-        update_input_meter (dialog,
-                            pa_stream_get_device_index (s),
-                            pa_stream_get_monitor_stream (s),
-                            v);
+        update_meter (meter, peak, sqrt (sum_squares / n_samples));
 }
 
 static void
-create_monitor_stream_for_source (GvcMixerDialog *dialog,
-                                  GvcMixerStream *stream)
+create_monitor_stream (GvcMixerDialog *dialog,
+                       GvcLevelMeter  *meter,
+                       GvcMixerStream *stream,
+                       const char     *device)
 {
         pa_stream     *s;
-        char           t[16];
         pa_buffer_attr attr;
         pa_sample_spec ss;
         pa_context    *context;
@@ -407,14 +449,12 @@ create_monitor_stream_for_source (GvcMixerDialog *dialog,
 
         ss.channels = 1;
         ss.format = PA_SAMPLE_FLOAT32;
-        ss.rate = 25;
+        ss.rate = METER_SAMPLE_RATE;
 
         memset (&attr, 0, sizeof (attr));
-        attr.fragsize = sizeof (float);
+        attr.fragsize = METER_BLOCK_SIZE * sizeof (float);
         attr.maxlength = (uint32_t) -1;
 
-        snprintf (t, sizeof (t), "%u", gvc_mixer_stream_get_index (stream));
-
         proplist = pa_proplist_new ();
         pa_proplist_sets (proplist, PA_PROP_APPLICATION_ID, "org.gnome.VolumeControl");
         s = pa_stream_new_with_proplist (context, _("Peak detect"), &ss, NULL, proplist);
@@ -424,11 +464,11 @@ create_monitor_stream_for_source (GvcMixerDialog *dialog,
                 return;
         }
 
-        pa_stream_set_read_callback (s, on_monitor_read_callback, dialog);
-        pa_stream_set_suspended_callback (s, on_monitor_suspended_callback, dialog);
+        pa_stream_set_read_callback (s, on_monitor_read_callback, meter);
+        pa_stream_set_suspended_callback (s, on_monitor_suspended_callback, meter);
 
         res = pa_stream_connect_record (s,
-                                        t,
+                                        device,
                                         &attr,
                                         (pa_stream_flags_t) (PA_STREAM_DONT_MOVE
                                                              |PA_STREAM_PEAK_DETECT
@@ -438,23 +478,54 @@ create_monitor_stream_for_source (GvcMixerDialog *dialog,
                 pa_stream_unref (s);
         } else {
                 g_object_set_data (G_OBJECT (stream), "has-monitor", GINT_TO_POINTER (TRUE));
-                g_object_set_data (G_OBJECT (dialog->priv->input_level_bar), "pa_stream", s);
-                g_object_set_data (G_OBJECT (dialog->priv->input_level_bar), "stream", stream);
+                g_object_set_data (G_OBJECT (meter->level_bar), "pa_stream", s);
+                g_object_set_data (G_OBJECT (meter->level_bar), "stream", stream);
+        }
+}
+
+static void
+create_monitor_stream_for_source (GvcMixerDialog *dialog,
+                                  GvcMixerStream *stream)
+{
+        char t[16];
+
+        if (stream == NULL) {
+                return;
         }
+
+        snprintf (t, sizeof (t), "%u", gvc_mixer_stream_get_index (stream));
+        create_monitor_stream (dialog, &dialog->priv->input_meter, stream, t);
 }
 
 static void
-stop_monitor_stream_for_source (GvcMixerDialog *dialog)
+create_monitor_stream_for_sink (GvcMixerDialog *dialog,
+                                GvcMixerStream *stream)
+{
+        char *monitor;
+
+        if (stream == NULL) {
+                return;
+        }
+
+        /* Sinks are recorded from through their monitor source */
+        monitor = g_strdup_printf ("%s.monitor", gvc_mixer_stream_get_name (stream));
+        create_monitor_stream (dialog, &dialog->priv->output_meter, stream, monitor);
+        g_free (monitor);
+}
+
+static void
+stop_monitor_stream (GvcMixerDialog *dialog,
+                     GvcLevelMeter  *meter)
 {
         pa_stream      *s;
         pa_context     *context;
         int             res;
         GvcMixerStream *stream;
 
-        s = g_object_get_data (G_OBJECT (dialog->priv->input_level_bar), "pa_stream");
+        s = g_object_get_data (G_OBJECT (meter->level_bar), "pa_stream");
         if (s == NULL)
                 return;
-        stream = g_object_get_data (G_OBJECT (dialog->priv->input_level_bar), "stream");
+        stream = g_object_get_data (G_OBJECT (meter->level_bar), "stream");
         g_assert (stream != NULL);
 
         g_debug ("Stopping monitor for %u", pa_stream_get_index (s));
@@ -465,11 +536,17 @@ stop_monitor_stream_for_source (GvcMixerDialog *dialog)
                 return;
         }
 
+        pa_stream_set_read_callback (s, NULL, NULL);
+        pa_stream_set_suspended_callback (s, NULL, NULL);
+
         res = pa_stream_disconnect (s);
         if (res == 0)
                 g_object_set_data (G_OBJECT (stream), "has-monitor", GINT_TO_POINTER (FALSE));
-        g_object_set_data (G_OBJECT (dialog->priv->input_level_bar), "pa_stream", NULL);
-        g_object_set_data (G_OBJECT (dialog->priv->input_level_bar), "stream", NULL);
+        pa_stream_unref (s);
+        g_object_set_data (G_OBJECT (meter->level_bar), "pa_stream", NULL);
+        g_object_set_data (G_OBJECT (meter->level_bar), "stream", NULL);
+
+        update_meter (meter, 0.0, 0.0);
 }
 
 static void
@@ -482,7 +559,7 @@ update_input_settings (GvcMixerDialog   *dialog,
 
         g_debug ("Updating input settings");
 
-        stop_monitor_stream_for_source (dialog);
+        stop_monitor_stream (dialog, &dialog->priv->input_meter);
 
         if (dialog->priv->input_profile_combo != NULL) {
                 gtk_container_remove (GTK_CONTAINER (dialog->priv->input_settings_box),
@@ -1677,6 +1754,38 @@ gvc_mixer_dialog_constructor (GType                  type,
         self->priv->output_settings_box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
         gtk_container_add (GTK_CONTAINER (box), self->priv->output_settings_box);
 
+        box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+        gtk_box_pack_start (GTK_BOX (self->priv->output_settings_box),
+                            box,
+                            FALSE, FALSE, 6);
+
+        sbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+        gtk_box_pack_start (GTK_BOX (box),
+                            sbox,
+                            FALSE, FALSE, 0);
+
+        label = gtk_label_new (_("Output level:"));
+        gtk_box_pack_start (GTK_BOX (sbox),
+                            label,
+                            FALSE, FALSE, 0);
+        if (self->priv->size_group != NULL)
+                gtk_size_group_add_widget (self->priv->size_group, sbox);
+
+        self->priv->output_level_bar = gvc_level_bar_new ();
+        gvc_level_bar_set_scale (GVC_LEVEL_BAR (self->priv->output_level_bar),
+                                 GVC_LEVEL_SCALE_LINEAR);
+        gtk_box_pack_start (GTK_BOX (box),
+                            self->priv->output_level_bar,
+                            TRUE, TRUE, 6);
+        self->priv->output_meter.level_bar = self->priv->output_level_bar;
+
+        ebox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+        gtk_box_pack_start (GTK_BOX (box),
+                            ebox,
+                            FALSE, FALSE, 0);
+        if (self->priv->size_group != NULL)
+                gtk_size_group_add_widget (self->priv->size_group, ebox);
+
         /* Input page */
         self->priv->input_box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 12);
         gtk_container_set_border_width (GTK_CONTAINER (self->priv->input_box), 12);
@@ -1721,6 +1830,7 @@ gvc_mixer_dialog_constructor (GType                  type,
         gtk_box_pack_start (GTK_BOX (box),
                             self->priv->input_level_bar,
                             TRUE, TRUE, 6);
+        self->priv->input_meter.level_bar = self->priv->input_level_bar;
 
         ebox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
         gtk_box_pack_start (GTK_BOX (box),
@@ -1831,6 +1941,8 @@ gvc_mixer_dialog_dispose (GObject *object)
         GvcMixerDialog *dialog = GVC_MIXER_DIALOG (object);
 
         if (dialog->priv->mixer_control != NULL) {
+                stop_monitor_stream (dialog, &dialog->priv->input_meter);
+                stop_monitor_stream (dialog, &dialog->priv->output_meter);
 
                 g_signal_handlers_disconnect_by_func (dialog->priv->mixer_control,
                                                       on_control_output_added,
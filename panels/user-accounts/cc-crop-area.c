@@ -28,10 +28,20 @@
 
 #include "cc-crop-area.h"
 
+/* Largest side of the working copy of the picture that gets scaled to
+ * the widget, as pictures from cameras can be huge. The picture itself
+ * is only used for the result, or if the widget is larger than that. */
+#define MAX_PREVIEW_SIZE 1024
+
+/* How much the picture is darkened around the crop rectangle */
+#define DIM_ALPHA 0.2
+
 struct _CcCropAreaPrivate {
         GdkPixbuf *browse_pixbuf;
-        GdkPixbuf *pixbuf;
-        GdkPixbuf *color_shifted;
+        GdkPixbuf *preview;
+        cairo_surface_t *surface;
+        gint allocation_width;
+        gint allocation_height;
         gdouble scale;
         GdkRectangle image;
         GdkCursorType current_cursor;
@@ -46,44 +56,30 @@ struct _CcCropAreaPrivate {
 
 G_DEFINE_TYPE (CcCropArea, cc_crop_area, GTK_TYPE_DRAWING_AREA);
 
-static inline guchar
-shift_color_byte (guchar b,
-                  int    shift)
-{
-        return CLAMP(b + shift, 0, 255);
-}
-
 static void
-shift_colors (GdkPixbuf *pixbuf,
-              gint       red,
-              gint       green,
-              gint       blue,
-              gint       alpha)
+update_preview (CcCropArea *area)
 {
-        gint x, y, offset, y_offset, rowstride, width, height;
-        guchar *pixels;
-        gint channels;
-
-        width = gdk_pixbuf_get_width (pixbuf);
-        height = gdk_pixbuf_get_height (pixbuf);
-        rowstride = gdk_pixbuf_get_rowstride (pixbuf);
-        pixels = gdk_pixbuf_get_pixels (pixbuf);
-        channels = gdk_pixbuf_get_n_channels (pixbuf);
-
-        for (y = 0; y < height; y++) {
-                y_offset = y * rowstride;
-                for (x = 0; x < width; x++) {
-                        offset = y_offset + x * channels;
-                        if (red != 0)
-                                pixels[offset] = shift_color_byte (pixels[offset], red);
-                        if (green != 0)
-                                pixels[offset + 1] = shift_color_byte (pixels[offset + 1], green);
-                        if (blue != 0)
-                                pixels[offset + 2] = shift_color_byte (pixels[offset + 2], blue);
-                        if (alpha != 0 && channels >= 4)
-                                pixels[offset + 3] = shift_color_byte (pixels[offset + 3], blue);
-                }
+        gint width, height;
+        gdouble scale;
+
+        g_clear_object (&area->priv->preview);
+        g_clear_pointer (&area->priv->surface, cairo_surface_destroy);
+
+        if (area->priv->browse_pixbuf == NULL)
+                return;
+
+        width = gdk_pixbuf_get_width (area->priv->browse_pixbuf);
+        height = gdk_pixbuf_get_height (area->priv->browse_pixbuf);
+        scale = MAX_PREVIEW_SIZE / (gdouble) MAX (width, height);
+        if (scale >= 1.0) {
+                area->priv->preview = g_object_ref (area->priv->browse_pixbuf);
+                return;
         }
+
+        area->priv->preview = gdk_pixbuf_scale_simple (area->priv->browse_pixbuf,
+                                                       MAX (1, width * scale),
+                                                       MAX (1, height * scale),
+                                                       GDK_INTERP_BILINEAR);
 }
 
 static void
@@ -95,10 +91,17 @@ update_pixbufs (CcCropArea *area)
         gdouble scale;
         gint dest_width, dest_height;
         GtkWidget *widget;
+        GdkPixbuf *source;
+        GdkPixbuf *pixbuf;
 
         widget = GTK_WIDGET (area);
         gtk_widget_get_allocation (widget, &allocation);
 
+        if (area->priv->surface != NULL &&
+            area->priv->allocation_width == allocation.width &&
+            area->priv->allocation_height == allocation.height)
+                return;
+
         width = gdk_pixbuf_get_width (area->priv->browse_pixbuf);
         height = gdk_pixbuf_get_height (area->priv->browse_pixbuf);
 
@@ -108,53 +111,57 @@ update_pixbufs (CcCropArea *area)
 
         dest_width = width * scale;
         dest_height = height * scale;
-
-        if (area->priv->pixbuf == NULL ||
-            gdk_pixbuf_get_width (area->priv->pixbuf) != allocation.width ||
-            gdk_pixbuf_get_height (area->priv->pixbuf) != allocation.height) {
-                if (area->priv->pixbuf != NULL)
-                        g_object_unref (area->priv->pixbuf);
-                area->priv->pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB,
-                                                     gdk_pixbuf_get_has_alpha (area->priv->browse_pixbuf),
-                                                     8,
-                                                     dest_width, dest_height);
-                gdk_pixbuf_fill (area->priv->pixbuf, 0x0);
-
-                gdk_pixbuf_scale (area->priv->browse_pixbuf,
-                                  area->priv->pixbuf,
-                                  0, 0,
-                                  dest_width, dest_height,
-                                  0, 0,
-                                  scale, scale,
-                                  GDK_INTERP_BILINEAR);
-
-                if (area->priv->color_shifted)
-                        g_object_unref (area->priv->color_shifted);
-                area->priv->color_shifted = gdk_pixbuf_copy (area->priv->pixbuf);
-                shift_colors (area->priv->color_shifted, -32, -32, -32, 0);
-
-                if (area->priv->scale == 0.0) {
-                        gdouble scale_to_80, scale_to_image, crop_scale;
-
-                        /* Scale the crop rectangle to 80% of the area, or less to fit the image */
-                        scale_to_80 = MIN ((gdouble)gdk_pixbuf_get_width (area->priv->pixbuf) * 0.8 / area->priv->base_width,
-                                           (gdouble)gdk_pixbuf_get_height (area->priv->pixbuf) * 0.8 / area->priv->base_height);
-                        scale_to_image = MIN ((gdouble)dest_width / area->priv->base_width,
-                                              (gdouble)dest_height / area->priv->base_height);
-                        crop_scale = MIN (scale_to_80, scale_to_image);
-
-                        area->priv->crop.width = crop_scale * area->priv->base_width / scale;
-                        area->priv->crop.height = crop_scale * area->priv->base_height / scale;
-                        area->priv->crop.x = (gdk_pixbuf_get_width (area->priv->browse_pixbuf) - area->priv->crop.width) / 2;
-                        area->priv->crop.y = (gdk_pixbuf_get_height (area->priv->browse_pixbuf) - area->priv->crop.height) / 2;
-                }
-
-                area->priv->scale = scale;
-                area->priv->image.x = (allocation.width - dest_width) / 2;
-                area->priv->image.y = (allocation.height - dest_height) / 2;
-                area->priv->image.width = dest_width;
-                area->priv->image.height = dest_height;
+        if (dest_width < 1 || dest_height < 1)
+                return;
+
+        source = area->priv->preview;
+        if (dest_width > gdk_pixbuf_get_width (source))
+                source = area->priv->browse_pixbuf;
+
+        pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB,
+                                 gdk_pixbuf_get_has_alpha (area->priv->browse_pixbuf),
+                                 8,
+                                 dest_width, dest_height);
+        gdk_pixbuf_fill (pixbuf, 0x0);
+
+        gdk_pixbuf_scale (source,
+                          pixbuf,
+                          0, 0,
+                          dest_width, dest_height,
+                          0, 0,
+                          dest_width / (gdouble) gdk_pixbuf_get_width (source),
+                          dest_height / (gdouble) gdk_pixbuf_get_height (source),
+                          GDK_INTERP_BILINEAR);
+
+        if (area->priv->surface != NULL)
+                cairo_surface_destroy (area->priv->surface);
+        area->priv->surface = gdk_cairo_surface_create_from_pixbuf (pixbuf, 1, gtk_widget_get_window (widget));
+        g_object_unref (pixbuf);
+
+        area->priv->allocation_width = allocation.width;
+        area->priv->allocation_height = allocation.height;
+
+        if (area->priv->scale == 0.0) {
+                gdouble scale_to_80, scale_to_image, crop_scale;
+
+                /* Scale the crop rectangle to 80% of the area, or less to fit the image */
+                scale_to_80 = MIN ((gdouble)dest_width * 0.8 / area->priv->base_width,
+                                   (gdouble)dest_height * 0.8 / area->priv->base_height);
+                scale_to_image = MIN ((gdouble)dest_width / area->priv->base_width,
+                                      (gdouble)dest_height / area->priv->base_height);
+                crop_scale = MIN (scale_to_80, scale_to_image);
+
+                area->priv->crop.width = crop_scale * area->priv->base_width / scale;
+                area->priv->crop.height = crop_scale * area->priv->base_height / scale;
+                area->priv->crop.x = (gdk_pixbuf_get_width (area->priv->browse_pixbuf) - area->priv->crop.width) / 2;
+                area->priv->crop.y = (gdk_pixbuf_get_height (area->priv->browse_pixbuf) - area->priv->crop.height) / 2;
         }
+
+        area->priv->scale = scale;
+        area->priv->image.x = (allocation.width - dest_width) / 2;
+        area->priv->image.y = (allocation.height - dest_height) / 2;
+        area->priv->image.width = dest_width;
+        area->priv->image.height = dest_height;
 }
 
 static void
@@ -192,25 +199,27 @@ cc_crop_area_draw (GtkWidget *widget,
                 return FALSE;
 
         update_pixbufs (uarea);
+        if (uarea->priv->surface == NULL)
+                return FALSE;
 
-        width = gdk_pixbuf_get_width (uarea->priv->pixbuf);
-        height = gdk_pixbuf_get_height (uarea->priv->pixbuf);
+        width = uarea->priv->image.width;
+        height = uarea->priv->image.height;
         crop_to_widget (uarea, &crop);
 
         ix = uarea->priv->image.x;
         iy = uarea->priv->image.y;
 
-        gdk_cairo_set_source_pixbuf (cr, uarea->priv->color_shifted, ix, iy);
+        cairo_set_source_surface (cr, uarea->priv->surface, ix, iy);
+        cairo_rectangle (cr, ix, iy, width, height);
+        cairo_fill (cr);
+
+        cairo_set_source_rgba (cr, 0, 0, 0, DIM_ALPHA);
         cairo_rectangle (cr, ix, iy, width, crop.y - iy);
         cairo_rectangle (cr, ix, crop.y, crop.x - ix, crop.height);
         cairo_rectangle (cr, crop.x + crop.width, crop.y, width - crop.width - (crop.x - ix), crop.height);
         cairo_rectangle (cr, ix, crop.y + crop.height, width, height - crop.height - (crop.y - iy));
         cairo_fill (cr);
 
-        gdk_cairo_set_source_pixbuf (cr, uarea->priv->pixbuf, ix, iy);
-        cairo_rectangle (cr, crop.x, crop.y, crop.width, crop.height);
-        cairo_fill (cr);
-
         if (uarea->priv->active_region != OUTSIDE) {
                 gint x1, x2, y1, y2;
                 cairo_set_source_rgb (cr, 1, 1, 1);
@@ -698,14 +707,10 @@ cc_crop_area_finalize (GObject *object)
                 g_object_unref (area->priv->browse_pixbuf);
                 area->priv->browse_pixbuf = NULL;
         }
-        if (area->priv->pixbuf) {
-                g_object_unref (area->priv->pixbuf);
-                area->priv->pixbuf = NULL;
-        }
-        if (area->priv->color_shifted) {
-                g_object_unref (area->priv->color_shifted);
-                area->priv->color_shifted = NULL;
-        }
+        g_clear_object (&area->priv->preview);
+        g_clear_pointer (&area->priv->surface, cairo_surface_destroy);
+
+        G_OBJECT_CLASS (cc_crop_area_parent_class)->finalize (object);
 }
 
 static void
@@ -788,6 +793,8 @@ cc_crop_area_set_picture (CcCropArea *area,
                 height = 0;
         }
 
+        update_preview (area);
+
         area->priv->crop.width = 2 * area->priv->base_width;
         area->priv->crop.height = 2 * area->priv->base_height;
         area->priv->crop.x = (width - area->priv->crop.width) / 2;
@@ -26,8 +26,15 @@
 struct _UmCellRendererUserImagePrivate {
         GtkWidget *parent;
         ActUser *user;
+        GCancellable *cancellable;
+        GHashTable *pending_users;
 };
 
+typedef struct {
+        UmCellRendererUserImage *cell_renderer;
+        ActUser *user;
+} IconWaiter;
+
 #define UM_CELL_RENDERER_USER_IMAGE_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), UM_TYPE_CELL_RENDERER_USER_IMAGE, UmCellRendererUserImagePrivate))
 
 enum {
@@ -38,17 +45,76 @@ enum {
 
 G_DEFINE_TYPE_WITH_CODE (UmCellRendererUserImage, um_cell_renderer_user_image, GTK_TYPE_CELL_RENDERER_PIXBUF, G_ADD_PRIVATE (UmCellRendererUserImage));
 
+static void
+icon_waiter_free (IconWaiter *waiter)
+{
+        g_object_unref (waiter->user);
+        g_free (waiter);
+}
+
+static void
+user_icon_rendered_cb (GObject      *source_object,
+                       GAsyncResult *res,
+                       gpointer      user_data)
+{
+        IconWaiter *waiter = user_data;
+        UmCellRendererUserImage *cell_renderer;
+        cairo_surface_t *surface;
+        GError *error = NULL;
+
+        surface = render_user_icon_finish (res, &error);
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+                g_error_free (error);
+                icon_waiter_free (waiter);
+                return;
+        }
+
+        cell_renderer = waiter->cell_renderer;
+        g_hash_table_remove (cell_renderer->priv->pending_users, waiter->user);
+        icon_waiter_free (waiter);
+
+        if (surface == NULL) {
+                g_error_free (error);
+                return;
+        }
+        cairo_surface_destroy (surface);
+
+        /* The renderer is shared by all rows, draw them again to pick
+         * up the icon from the cache */
+        gtk_widget_queue_draw (cell_renderer->priv->parent);
+}
+
 static void
 render_user_image (UmCellRendererUserImage *cell_renderer)
 {
         cairo_surface_t *surface;
+        IconWaiter *waiter;
         gint scale;
 
         if (cell_renderer->priv->user != NULL) {
                 scale = gtk_widget_get_scale_factor (cell_renderer->priv->parent);
-                surface = render_user_icon (cell_renderer->priv->user, UM_ICON_STYLE_FRAME | UM_ICON_STYLE_STATUS, 48, scale);
+                surface = lookup_user_icon (cell_renderer->priv->user, UM_ICON_STYLE_FRAME | UM_ICON_STYLE_STATUS, 48, scale);
                 g_object_set (GTK_CELL_RENDERER_PIXBUF (cell_renderer), "surface", surface, NULL);
-                cairo_surface_destroy (surface);
+                if (surface != NULL) {
+                        cairo_surface_destroy (surface);
+                } else if (!g_hash_table_contains (cell_renderer->priv->pending_users,
+                                                   cell_renderer->priv->user)) {
+                        /* Rows get drawn again while the icon loads,
+                         * one redraw when it is done is enough */
+                        g_hash_table_add (cell_renderer->priv->pending_users,
+                                          g_object_ref (cell_renderer->priv->user));
+
+                        waiter = g_new0 (IconWaiter, 1);
+                        waiter->cell_renderer = cell_renderer;
+                        waiter->user = g_object_ref (cell_renderer->priv->user);
+
+                        render_user_icon_async (cell_renderer->priv->user,
+                                                UM_ICON_STYLE_FRAME | UM_ICON_STYLE_STATUS,
+                                                48, scale,
+                                                cell_renderer->priv->cancellable,
+                                                user_icon_rendered_cb,
+                                                waiter);
+                }
         } else {
                 g_object_set (GTK_CELL_RENDERER_PIXBUF (cell_renderer), "surface", NULL, NULL);
         }
@@ -93,6 +159,9 @@ um_cell_renderer_user_image_finalize (GObject *object)
 {
         UmCellRendererUserImage *cell_renderer = UM_CELL_RENDERER_USER_IMAGE (object);
 
+        g_cancellable_cancel (cell_renderer->priv->cancellable);
+        g_clear_object (&cell_renderer->priv->cancellable);
+        g_clear_pointer (&cell_renderer->priv->pending_users, g_hash_table_destroy);
         g_clear_object (&cell_renderer->priv->parent);
         g_clear_object (&cell_renderer->priv->user);
 
@@ -128,6 +197,9 @@ static void
 um_cell_renderer_user_image_init (UmCellRendererUserImage *cell_renderer)
 {
         cell_renderer->priv = UM_CELL_RENDERER_USER_IMAGE_GET_PRIVATE (cell_renderer);
+        cell_renderer->priv->cancellable = g_cancellable_new ();
+        cell_renderer->priv->pending_users = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                                    g_object_unref, NULL);
 }
 
 GtkCellRenderer *
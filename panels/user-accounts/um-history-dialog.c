@@ -43,6 +43,12 @@ struct _UmHistoryDialog {
         GDateTime *current_week;
 
         ActUser *user;
+
+        /* The login history of the user, parsed in a thread */
+        GVariant *history_variant;
+        GArray *login_history;
+        GVariant *loading_variant;
+        GCancellable *cancellable;
 };
 
 typedef struct {
@@ -116,48 +122,154 @@ clear_history (UmHistoryDialog *um)
         g_list_free (list);
 }
 
-static GArray *
-get_login_history (ActUser *user)
+static gint
+compare_login_time (gconstpointer a,
+                    gconstpointer b)
+{
+        const UmLoginHistory *ha = a;
+        const UmLoginHistory *hb = b;
+
+        if (ha->login_time != hb->login_time)
+                return ha->login_time < hb->login_time ? -1 : 1;
+        return 0;
+}
+
+static void
+parse_login_history_thread (GTask        *task,
+                            gpointer      source_object,
+                            gpointer      task_data,
+                            GCancellable *cancellable)
 {
-	GArray *login_history;
-	GVariantIter *iter, *iter2;
-	GVariant *variant;
-	const GVariant *value;
-	const gchar *key;
-	UmLoginHistory history;
-
-	login_history = NULL;
-	value = act_user_get_login_history (user);
-	g_variant_get ((GVariant *) value, "a(xxa{sv})", &iter);
-	while (g_variant_iter_loop (iter, "(xxa{sv})", &history.login_time, &history.logout_time, &iter2)) {
-		while (g_variant_iter_loop (iter2, "{sv}", &key, &variant)) {
-			if (g_strcmp0 (key, "type") == 0) {
-				history.type = g_variant_get_string (variant, NULL);
-			}
-		}
-
-		if (login_history == NULL) {
-			login_history = g_array_new (FALSE, TRUE, sizeof (UmLoginHistory));
-		}
-
-		g_array_append_val (login_history, history);
-	}
-
-	return login_history;
+        GVariant *value = task_data;
+        GArray *login_history;
+        GVariantIter *iter, *iter2;
+        GVariant *variant;
+        const gchar *key;
+        UmLoginHistory history;
+        gboolean sorted = TRUE;
+
+        login_history = g_array_sized_new (FALSE, TRUE, sizeof (UmLoginHistory),
+                                           g_variant_n_children (value));
+
+        /* The type strings point into the variant, which the dialog
+         * keeps along with the array */
+        g_variant_get (value, "a(xxa{sv})", &iter);
+        while (g_variant_iter_loop (iter, "(xxa{sv})", &history.login_time, &history.logout_time, &iter2)) {
+                history.type = "";
+                while (g_variant_iter_loop (iter2, "{sv}", &key, &variant)) {
+                        if (g_strcmp0 (key, "type") == 0) {
+                                history.type = g_variant_get_string (variant, NULL);
+                        }
+                }
+
+                if (login_history->len > 0 &&
+                    g_array_index (login_history, UmLoginHistory, login_history->len - 1).login_time > history.login_time)
+                        sorted = FALSE;
+
+                g_array_append_val (login_history, history);
+        }
+        g_variant_iter_free (iter);
+
+        /* AccountsService gives them in order, which finding the weeks
+         * relies on */
+        if (!sorted)
+                g_array_sort (login_history, compare_login_time);
+
+        g_task_return_pointer (task, login_history, (GDestroyNotify) g_array_unref);
 }
 
+static void show_week (UmHistoryDialog *um);
+
 static void
-set_sensitivity (UmHistoryDialog *um)
+login_history_parsed_cb (GObject      *source_object,
+                         GAsyncResult *res,
+                         gpointer      user_data)
 {
+        UmHistoryDialog *um = user_data;
         GArray *login_history;
+        GError *error = NULL;
+
+        login_history = g_task_propagate_pointer (G_TASK (res), &error);
+        if (login_history == NULL) {
+                g_error_free (error);
+                return;
+        }
+
+        g_clear_pointer (&um->login_history, g_array_unref);
+        g_clear_pointer (&um->history_variant, g_variant_unref);
+        um->login_history = login_history;
+        um->history_variant = um->loading_variant;
+        um->loading_variant = NULL;
+
+        show_week (um);
+}
+
+/* Returns the parsed login history of the user, or %NULL while it is
+ * being parsed, in which case the week is shown again once it is. */
+static GArray *
+get_login_history (UmHistoryDialog *um)
+{
+        GVariant *value;
+        GTask *task;
+
+        value = (GVariant *) act_user_get_login_history (um->user);
+        if (value == NULL)
+                return NULL;
+
+        if (value == um->history_variant)
+                return um->login_history;
+
+        if (value == um->loading_variant)
+                return NULL;
+
+        if (um->cancellable != NULL) {
+                g_cancellable_cancel (um->cancellable);
+                g_object_unref (um->cancellable);
+        }
+        g_clear_pointer (&um->loading_variant, g_variant_unref);
+
+        um->cancellable = g_cancellable_new ();
+        um->loading_variant = g_variant_ref (value);
+
+        task = g_task_new (NULL, um->cancellable, login_history_parsed_cb, um);
+        g_task_set_task_data (task, g_variant_ref (value), (GDestroyNotify) g_variant_unref);
+        g_task_run_in_thread (task, parse_login_history_thread);
+        g_object_unref (task);
+
+        return NULL;
+}
+
+/* Index of the last record logged in before @time, or -1 */
+static gint
+find_last_login_before (GArray *login_history,
+                        gint64  time)
+{
+        guint low, high;
+
+        low = 0;
+        high = login_history->len;
+        while (low < high) {
+                guint mid = low + (high - low) / 2;
+
+                if (g_array_index (login_history, UmLoginHistory, mid).login_time < time)
+                        low = mid + 1;
+                else
+                        high = mid;
+        }
+
+        return (gint) low - 1;
+}
+
+static void
+set_sensitivity (UmHistoryDialog *um,
+                 GArray          *login_history)
+{
         UmLoginHistory history;
         gboolean sensitive = FALSE;
 
-        login_history = get_login_history (um->user);
-        if (login_history != NULL) {
+        if (login_history != NULL && login_history->len > 0) {
                 history = g_array_index (login_history, UmLoginHistory, 0);
                 sensitive = g_date_time_to_unix (um->week) > history.login_time;
-                g_array_free (login_history, TRUE);
         }
         gtk_widget_set_sensitive (get_widget (um, "previous-button"), sensitive);
 
@@ -210,9 +322,9 @@ show_week (UmHistoryDialog *um)
 
         show_week_label (um);
         clear_history (um);
-        set_sensitivity (um);
 
-        login_history = get_login_history (um->user);
+        login_history = get_login_history (um);
+        set_sensitivity (um, login_history);
         if (login_history == NULL) {
                 return;
         }
@@ -222,12 +334,7 @@ show_week (UmHistoryDialog *um)
         temp = g_date_time_add_weeks (um->week, 1);
         to = g_date_time_to_unix (temp);
         g_date_time_unref (temp);
-        for (i = login_history->len - 1; i >= 0; i--) {
-                history = g_array_index (login_history, UmLoginHistory, i);
-                if (history.login_time < to) {
-                        break;
-                }
-        }
+        i = find_last_login_before (login_history, to);
 
         /* Add new session records */
         box = get_widget (um, "history-box");
@@ -259,8 +366,6 @@ show_week (UmHistoryDialog *um)
         }
 
         gtk_widget_show_all (box);
-
-        g_array_free (login_history, TRUE);
 }
 
 static void
@@ -316,6 +421,14 @@ um_history_dialog_set_user (UmHistoryDialog *um,
                 um->user = g_object_ref (user);
         }
 
+        if (um->cancellable != NULL) {
+                g_cancellable_cancel (um->cancellable);
+                g_clear_object (&um->cancellable);
+        }
+        g_clear_pointer (&um->loading_variant, g_variant_unref);
+        g_clear_pointer (&um->history_variant, g_variant_unref);
+        g_clear_pointer (&um->login_history, g_array_unref);
+
         update_dialog_title (um);
 }
 
@@ -395,6 +508,14 @@ um_history_dialog_free (UmHistoryDialog *um)
 {
         gtk_widget_destroy (um->dialog);
 
+        if (um->cancellable != NULL) {
+                g_cancellable_cancel (um->cancellable);
+                g_clear_object (&um->cancellable);
+        }
+        g_clear_pointer (&um->loading_variant, g_variant_unref);
+        g_clear_pointer (&um->history_variant, g_variant_unref);
+        g_clear_pointer (&um->login_history, g_array_unref);
+
         g_clear_object (&um->user);
         g_clear_object (&um->builder);
 
@@ -25,22 +25,58 @@
 
 struct _UmUserImagePrivate {
         ActUser *user;
+        GCancellable *cancellable;
 };
 
 #define UM_USER_IMAGE_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), UM_TYPE_USER_IMAGE, UmUserImagePrivate))
 
 G_DEFINE_TYPE_WITH_CODE (UmUserImage, um_user_image, GTK_TYPE_IMAGE, G_ADD_PRIVATE (UmUserImage));
 
+static void
+user_icon_rendered_cb (GObject      *source_object,
+                       GAsyncResult *res,
+                       gpointer      user_data)
+{
+        cairo_surface_t *surface;
+        GError *error = NULL;
+
+        surface = render_user_icon_finish (res, &error);
+        if (surface == NULL) {
+                g_error_free (error);
+                return;
+        }
+
+        gtk_image_set_from_surface (GTK_IMAGE (user_data), surface);
+        cairo_surface_destroy (surface);
+}
+
 static void
 render_image (UmUserImage *image)
 {
         cairo_surface_t *surface;
         gint scale;
 
+        if (image->priv->user == NULL)
+                return;
+
+        /* Don't let an older icon replace this one */
+        g_cancellable_cancel (image->priv->cancellable);
+        g_clear_object (&image->priv->cancellable);
+
         scale = gtk_widget_get_scale_factor (GTK_WIDGET (image));
-        surface = render_user_icon (image->priv->user, UM_ICON_STYLE_NONE, 48, scale);
-        gtk_image_set_from_surface (GTK_IMAGE (image), surface);
-        cairo_surface_destroy (surface);
+        surface = lookup_user_icon (image->priv->user, UM_ICON_STYLE_NONE, 48, scale);
+        if (surface != NULL) {
+                gtk_image_set_from_surface (GTK_IMAGE (image), surface);
+                cairo_surface_destroy (surface);
+                return;
+        }
+
+        /* Keep showing the previous icon until this one is decoded */
+        image->priv->cancellable = g_cancellable_new ();
+        render_user_icon_async (image->priv->user, UM_ICON_STYLE_NONE, 48, scale,
+                                image->priv->cancellable,
+                                user_icon_rendered_cb,
+                                image);
 }
 
 void
@@ -68,6 +104,8 @@ um_user_image_finalize (GObject *object)
 {
         UmUserImage *image = UM_USER_IMAGE (object);
 
+        g_cancellable_cancel (image->priv->cancellable);
+        g_clear_object (&image->priv->cancellable);
         g_clear_object (&image->priv->user);
 
         G_OBJECT_CLASS (um_user_image_parent_class)->finalize (object);
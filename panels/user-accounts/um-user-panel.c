@@ -52,6 +52,7 @@
 #include "um-history-dialog.h"
 
 #include "cc-common-language.h"
+#include "cc-locale-catalog.h"
 #include "cc-util.h"
 
 #include "um-realm-manager.h"
@@ -74,6 +75,7 @@ struct _CcUserPanelPrivate {
         GtkWidget *main_box;
         GPermission *permission;
         GtkWidget *language_chooser;
+        gboolean   language_chooser_pending;
 
         UmPasswordDialog *password_dialog;
         UmPhotoDialog *photo_dialog;
@@ -81,6 +83,9 @@ struct _CcUserPanelPrivate {
 
         gint other_accounts;
         GtkTreeIter *other_iter;
+        GHashTable *user_rows;
+        GHashTable *changed_users;
+        guint changed_users_id;
 
         UmAccountDialog *account_dialog;
 };
@@ -186,29 +191,24 @@ get_name_col_str (ActUser *user)
 
 static void show_user (ActUser *user, CcUserPanelPrivate *d);
 
-static void
-user_added (ActUserManager *um, ActUser *user, CcUserPanelPrivate *d)
+/* Adds a row for @user, and the heading for other accounts with the
+ * first one. Returns the sort key of the row, or -1 if it isn't shown.
+ */
+static gint
+insert_user_row (CcUserPanelPrivate *d,
+                 GtkListStore       *store,
+                 ActUser            *user)
 {
-        GtkWidget *widget;
-        GtkTreeModel *model;
-        GtkListStore *store;
         GtkTreeIter iter;
-        GtkTreeIter dummy;
         gchar *text, *title;
-        GtkTreeSelection *selection;
         gint sort_key;
 
-        if (act_user_is_system_account (user)) {
-                return;
+        if (act_user_is_system_account (user) ||
+            g_hash_table_contains (d->user_rows, user)) {
+                return -1;
         }
 
         g_debug ("user added: %d %s\n", act_user_get_uid (user), get_real_or_user_name (user));
-        widget = get_widget (d, "list-treeview");
-        model = gtk_tree_view_get_model (GTK_TREE_VIEW (widget));
-        store = GTK_LIST_STORE (model);
-        selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (widget));
-
-        text = get_name_col_str (user);
 
         if (act_user_get_uid (user) == getuid ()) {
                 sort_key = 1;
@@ -217,35 +217,63 @@ user_added (ActUserManager *um, ActUser *user, CcUserPanelPrivate *d)
                 d->other_accounts++;
                 sort_key = 3;
         }
-        gtk_list_store_append (store, &iter);
 
-        gtk_list_store_set (store, &iter,
-                            USER_COL, user,
-                            NAME_COL, text,
-                            USER_ROW_COL, TRUE,
-                            TITLE_COL, NULL,
-                            HEADING_ROW_COL, FALSE,
-                            SORT_KEY_COL, sort_key,
-                            -1);
+        text = get_name_col_str (user);
+        gtk_list_store_insert_with_values (store, &iter, -1,
+                                           USER_COL, user,
+                                           NAME_COL, text,
+                                           USER_ROW_COL, TRUE,
+                                           TITLE_COL, NULL,
+                                           HEADING_ROW_COL, FALSE,
+                                           SORT_KEY_COL, sort_key,
+                                           -1);
         g_free (text);
 
-        if (sort_key == 1 &&
-            !gtk_tree_selection_get_selected (selection, &model, &dummy)) {
-                gtk_tree_selection_select_iter (selection, &iter);
-        }
+        /* List store iters persist, even when the rows get sorted */
+        g_hash_table_insert (d->user_rows, user, gtk_tree_iter_copy (&iter));
 
         /* Show heading for other accounts if new one have been added. */
         if (d->other_accounts == 1 && sort_key == 3) {
                 title = g_strdup_printf ("<small><span foreground=\"#555555\">%s</span></small>", _("Other Accounts"));
-                gtk_list_store_append (store, &iter);
-                gtk_list_store_set (store, &iter,
-                                    TITLE_COL, title,
-                                    HEADING_ROW_COL, TRUE,
-                                    SORT_KEY_COL, 2,
-                                    -1);
+                gtk_list_store_insert_with_values (store, &iter, -1,
+                                                   TITLE_COL, title,
+                                                   HEADING_ROW_COL, TRUE,
+                                                   SORT_KEY_COL, 2,
+                                                   -1);
                 d->other_iter = gtk_tree_iter_copy (&iter);
                 g_free (title);
         }
+
+        return sort_key;
+}
+
+static void
+select_user_row_if_none (CcUserPanelPrivate *d,
+                         ActUser            *user)
+{
+        GtkTreeSelection *selection;
+        GtkTreeIter *row;
+
+        selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (get_widget (d, "list-treeview")));
+        if (gtk_tree_selection_get_selected (selection, NULL, NULL))
+                return;
+
+        row = g_hash_table_lookup (d->user_rows, user);
+        if (row != NULL)
+                gtk_tree_selection_select_iter (selection, row);
+}
+
+static void
+user_added (ActUserManager *um, ActUser *user, CcUserPanelPrivate *d)
+{
+        GtkWidget *widget;
+        GtkTreeModel *model;
+
+        widget = get_widget (d, "list-treeview");
+        model = gtk_tree_view_get_model (GTK_TREE_VIEW (widget));
+
+        if (insert_user_row (d, GTK_LIST_STORE (model), user) == 1)
+                select_user_row_if_none (d, user);
 }
 
 static void
@@ -295,34 +323,30 @@ user_removed (ActUserManager *um, ActUser *user, CcUserPanelPrivate *d)
         GtkTreeSelection *selection;
         GtkListStore *store;
         GtkTreeIter iter, next;
-        ActUser *u;
+        GtkTreeIter *row;
         gint key;
 
         g_debug ("user removed: %s\n", act_user_get_user_name (user));
+        row = g_hash_table_lookup (d->user_rows, user);
+        if (row == NULL)
+                return;
+
         tv = (GtkTreeView *)get_widget (d, "list-treeview");
         selection = gtk_tree_view_get_selection (tv);
         model = gtk_tree_view_get_model (tv);
         store = GTK_LIST_STORE (model);
-        if (gtk_tree_model_get_iter_first (model, &iter)) {
-                do {
-                        gtk_tree_model_get (model, &iter, USER_COL, &u, SORT_KEY_COL, &key, -1);
-
-                        if (u != NULL) {
-                                if (act_user_get_uid (user) == act_user_get_uid (u)) {
-                                        if (!get_next_user_row (model, &iter, &next))
-                                                get_previous_user_row (model, &iter, &next);
-                                        if (key == 3) {
-                                                d->other_accounts--;
-                                        }
-                                        gtk_list_store_remove (store, &iter);
-                                        gtk_tree_selection_select_iter (selection, &next);
-                                        g_object_unref (u);
-                                        break;
-                                }
-                                g_object_unref (u);
-                        }
-                } while (gtk_tree_model_iter_next (model, &iter));
+
+        iter = *row;
+        g_hash_table_remove (d->user_rows, user);
+
+        gtk_tree_model_get (model, &iter, SORT_KEY_COL, &key, -1);
+        if (!get_next_user_row (model, &iter, &next))
+                get_previous_user_row (model, &iter, &next);
+        if (key == 3) {
+                d->other_accounts--;
         }
+        gtk_list_store_remove (store, &iter);
+        gtk_tree_selection_select_iter (selection, &next);
 
         /* Hide heading for other accounts if last one have been removed. */
         if (d->other_iter != NULL && d->other_accounts == 0 && key == 3) {
@@ -332,49 +356,62 @@ user_removed (ActUserManager *um, ActUser *user, CcUserPanelPrivate *d)
         }
 }
 
-static void
-user_changed (ActUserManager *um, ActUser *user, CcUserPanelPrivate *d)
+static gboolean
+update_changed_users (gpointer user_data)
 {
+        CcUserPanelPrivate *d = user_data;
         GtkTreeView *tv;
         GtkTreeSelection *selection;
         GtkTreeModel *model;
         GtkTreeIter iter;
-        ActUser *current;
+        GtkTreeIter *row;
+        GHashTableIter changed;
+        ActUser *user, *current;
         char *text;
 
+        d->changed_users_id = 0;
+
         tv = (GtkTreeView *)get_widget (d, "list-treeview");
         model = gtk_tree_view_get_model (tv);
         selection = gtk_tree_view_get_selection (tv);
 
-        g_assert (gtk_tree_model_get_iter_first (model, &iter));
-        do {
-                gtk_tree_model_get (model, &iter, USER_COL, &current, -1);
-                if (current == user) {
-                        text = get_name_col_str (user);
-
-                        gtk_list_store_set (GTK_LIST_STORE (model), &iter,
-                                            USER_COL, user,
-                                            NAME_COL, text,
-                                            -1);
-                        g_free (text);
-                        g_object_unref (current);
-
-                        break;
-                }
-                if (current)
-                        g_object_unref (current);
+        g_hash_table_iter_init (&changed, d->changed_users);
+        while (g_hash_table_iter_next (&changed, (gpointer *) &user, NULL)) {
+                row = g_hash_table_lookup (d->user_rows, user);
+                if (row == NULL)
+                        continue;
 
-        } while (gtk_tree_model_iter_next (model, &iter));
+                text = get_name_col_str (user);
+                gtk_list_store_set (GTK_LIST_STORE (model), row,
+                                    USER_COL, user,
+                                    NAME_COL, text,
+                                    -1);
+                g_free (text);
+        }
 
         if (gtk_tree_selection_get_selected (selection, &model, &iter)) {
                 gtk_tree_model_get (model, &iter, USER_COL, &current, -1);
 
-                if (current == user) {
-                        show_user (user, d);
+                if (current != NULL && g_hash_table_contains (d->changed_users, current)) {
+                        show_user (current, d);
                 }
                 if (current)
                         g_object_unref (current);
         }
+
+        g_hash_table_remove_all (d->changed_users);
+
+        return G_SOURCE_REMOVE;
+}
+
+static void
+user_changed (ActUserManager *um, ActUser *user, CcUserPanelPrivate *d)
+{
+        /* Users tend to change in bursts, when they log in or out, so
+         * update each row and the selected user only once per burst */
+        g_hash_table_add (d->changed_users, g_object_ref (user));
+        if (d->changed_users_id == 0)
+                d->changed_users_id = g_idle_add (update_changed_users, d);
 }
 
 static void
@@ -1149,6 +1186,26 @@ language_response (GtkDialog         *dialog,
         gtk_widget_hide (GTK_WIDGET (dialog));
 }
 
+static void change_language (GtkButton *button, CcUserPanelPrivate *d);
+
+static void
+language_chooser_catalog_ready (GObject      *source_object,
+                                GAsyncResult *res,
+                                gpointer      user_data)
+{
+        CcUserPanelPrivate *d = user_data;
+
+        if (!cc_locale_catalog_wait_ready_finish (res, NULL))
+                return;
+
+        /* Open the chooser that was asked for while waiting, for the
+         * user that is selected now */
+        if (d->language_chooser_pending) {
+                d->language_chooser_pending = FALSE;
+                change_language (NULL, d);
+        }
+}
+
 static void
 change_language (GtkButton *button,
                  CcUserPanelPrivate *d)
@@ -1156,6 +1213,18 @@ change_language (GtkButton *button,
         const gchar *current_language;
         ActUser *user;
 
+        /* The chooser needs the locale catalog, which is built in the
+         * background; open it once that is ready.  Further clicks in
+         * the meantime are served by the same pending request. */
+        if (!cc_locale_catalog_is_ready ()) {
+                if (!d->language_chooser_pending)
+                        cc_locale_catalog_wait_ready (d->cancellable,
+                                                      language_chooser_catalog_ready,
+                                                      d);
+                d->language_chooser_pending = TRUE;
+                return;
+        }
+
         user = get_selected_user (d);
         current_language = act_user_get_language (user);
 
@@ -1280,7 +1349,9 @@ users_loaded (ActUserManager     *manager,
 {
         GSList *list, *l;
         ActUser *user;
+        ActUser *own_user = NULL;
         GtkWidget *dialog;
+        GtkTreeSortable *sortable;
 
         if (act_user_manager_no_service (d->um)) {
                 dialog = gtk_message_dialog_new (GTK_WINDOW (gtk_widget_get_toplevel (d->main_box)),
@@ -1304,11 +1375,20 @@ users_loaded (ActUserManager     *manager,
         g_signal_connect (d->um, "user-changed", G_CALLBACK (user_changed), d);
         g_signal_connect (d->um, "user-is-logged-in-changed", G_CALLBACK (user_changed), d);
 
+        /* Sort the rows once they are all in, rather than moving each
+         * one into place as it is added */
+        sortable = GTK_TREE_SORTABLE (gtk_tree_view_get_model (GTK_TREE_VIEW (get_widget (d, "list-treeview"))));
+        gtk_tree_sortable_set_sort_column_id (sortable, GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID, GTK_SORT_ASCENDING);
         for (l = list; l; l = l->next) {
                 user = l->data;
                 g_debug ("adding user %s\n", get_real_or_user_name (user));
-                user_added (d->um, user, d);
+                if (insert_user_row (d, GTK_LIST_STORE (sortable), user) == 1)
+                        own_user = user;
         }
+        gtk_tree_sortable_set_sort_column_id (sortable, GTK_TREE_SORTABLE_DEFAULT_SORT_COLUMN_ID, GTK_SORT_ASCENDING);
+        if (own_user != NULL)
+                select_user_row_if_none (d, own_user);
+
         show_user (list->data, d);
         g_slist_free (list);
 
@@ -1599,6 +1679,10 @@ setup_main_window (CcUserPanel *self)
 
         d->other_accounts = 0;
         d->other_iter = NULL;
+        d->user_rows = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                              NULL, (GDestroyNotify) gtk_tree_iter_free);
+        d->changed_users = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                  g_object_unref, NULL);
 
         column = gtk_tree_view_column_new ();
         cell = um_cell_renderer_user_image_new (userlist);
@@ -1772,6 +1856,8 @@ cc_user_panel_init (CcUserPanel *self)
         gtk_container_add (GTK_CONTAINER (self), get_widget (d, "overlay"));
         d->history_dialog = um_history_dialog_new ();
         setup_main_window (self);
+
+        cc_locale_catalog_prefetch ();
 }
 
 static void
@@ -1820,6 +1906,12 @@ cc_user_panel_dispose (GObject *object)
                 gtk_tree_iter_free (priv->other_iter);
                 priv->other_iter = NULL;
         }
+        if (priv->changed_users_id != 0) {
+                g_source_remove (priv->changed_users_id);
+                priv->changed_users_id = 0;
+        }
+        g_clear_pointer (&priv->changed_users, g_hash_table_destroy);
+        g_clear_pointer (&priv->user_rows, g_hash_table_destroy);
         G_OBJECT_CLASS (cc_user_panel_parent_class)->dispose (object);
 }
 
@@ -796,8 +796,9 @@ generate_username_choices (const gchar  *name,
 }
 
 static gboolean
-check_user_file (const char *filename,
-                 gssize      max_file_size)
+check_user_file (const char  *filename,
+                 gssize       max_file_size,
+                 struct stat *fileinfo_out)
 {
         struct stat fileinfo;
 
@@ -823,6 +824,9 @@ check_user_file (const char *filename,
                 return FALSE;
         }
 
+        if (fileinfo_out != NULL)
+                *fileinfo_out = fileinfo;
+
         return TRUE;
 }
 
@@ -916,45 +920,88 @@ logged_in_pixbuf (GdkPixbuf *pixbuf, gint scale)
 }
 
 #define MAX_FILE_SIZE     65536
+#define MAX_CACHED_ICONS  512
 
-cairo_surface_t *
-render_user_icon (ActUser     *user,
-                  UmIconStyle  style,
-                  gint         icon_size,
-                  gint         scale)
+/* Rendered user icons, shared by all the user images, keyed by the
+ * icon file and its stat() details, the size, scale and style. The
+ * icon files are decoded in a thread, the default one in the main
+ * thread, as it comes from the icon theme. */
+typedef struct {
+        cairo_surface_t *surface;
+        gboolean         loading;
+        GList           *waiting;
+        GList           *lru_link;
+} CachedIcon;
+
+typedef struct {
+        gchar       *icon_file;
+        UmIconStyle  style;
+        gint         icon_size;
+        gint         scale;
+} IconRequest;
+
+static GHashTable *icon_cache = NULL;
+
+/* The keys of icon_cache, most recently used first */
+static GQueue icon_lru = G_QUEUE_INIT;
+
+static void
+cached_icon_free (CachedIcon *cached)
 {
-        GdkPixbuf    *pixbuf;
-        GdkPixbuf    *framed;
-        gboolean      res;
-        GError       *error;
-        const gchar  *icon_file;
-        cairo_surface_t *surface = NULL;
+        g_assert (cached->waiting == NULL);
 
-        g_return_val_if_fail (ACT_IS_USER (user), NULL);
-        g_return_val_if_fail (icon_size > 12, NULL);
+        if (cached->surface != NULL)
+                cairo_surface_destroy (cached->surface);
+        g_free (cached);
+}
 
-        icon_file = act_user_get_icon_file (user);
-        pixbuf = NULL;
-        if (icon_file) {
-                res = check_user_file (icon_file, MAX_FILE_SIZE);
-                if (res) {
-                        pixbuf = gdk_pixbuf_new_from_file_at_size (icon_file,
-                                                                   icon_size * scale,
-                                                                   icon_size * scale,
-                                                                   NULL);
-                }
-                else {
-                        pixbuf = NULL;
+static void
+icon_request_free (IconRequest *request)
+{
+        g_free (request->icon_file);
+        g_free (request);
+}
+
+/* Takes ownership of @pixbuf */
+static cairo_surface_t *
+decorate_user_icon (GdkPixbuf   *pixbuf,
+                    UmIconStyle  style,
+                    gint         scale)
+{
+        GdkPixbuf *framed;
+        cairo_surface_t *surface;
+
+        if (style & UM_ICON_STYLE_FRAME) {
+                framed = frame_pixbuf (pixbuf, scale);
+                if (framed != NULL) {
+                        g_object_unref (pixbuf);
+                        pixbuf = framed;
                 }
         }
 
-        if (pixbuf != NULL) {
-                goto out;
+        if (style & UM_ICON_STYLE_STATUS) {
+                framed = logged_in_pixbuf (pixbuf, scale);
+                if (framed != NULL) {
+                        g_object_unref (pixbuf);
+                        pixbuf = framed;
+                }
         }
 
-        error = NULL;
-        pixbuf = gtk_icon_theme_load_icon (gtk_icon_theme_get_default (),
+        surface = gdk_cairo_surface_create_from_pixbuf (pixbuf, scale, NULL);
+        g_object_unref (pixbuf);
+
+        return surface;
+}
+
+static cairo_surface_t *
+render_default_icon (UmIconStyle style,
+                     gint        icon_size,
+                     gint        scale)
+{
+        GdkPixbuf *pixbuf;
+        GError *error = NULL;
 
+        pixbuf = gtk_icon_theme_load_icon (gtk_icon_theme_get_default (),
                                            "avatar-default",
                                            icon_size * scale,
                                            GTK_ICON_LOOKUP_FORCE_SIZE,
@@ -964,30 +1011,238 @@ render_user_icon (ActUser     *user,
                 g_error_free (error);
         }
 
- out:
+        if (pixbuf == NULL)
+                return NULL;
 
-        if (pixbuf != NULL && (style & UM_ICON_STYLE_FRAME)) {
-                framed = frame_pixbuf (pixbuf, scale);
-                if (framed != NULL) {
-                        g_object_unref (pixbuf);
-                        pixbuf = framed;
-                }
+        return decorate_user_icon (pixbuf, style, scale);
+}
+
+static void
+load_user_icon_thread (GTask        *task,
+                       gpointer      source_object,
+                       gpointer      task_data,
+                       GCancellable *cancellable)
+{
+        IconRequest *request = task_data;
+        GdkPixbuf *pixbuf;
+        GError *error = NULL;
+
+        pixbuf = gdk_pixbuf_new_from_file_at_size (request->icon_file,
+                                                   request->icon_size * request->scale,
+                                                   request->icon_size * request->scale,
+                                                   &error);
+        if (pixbuf == NULL) {
+                g_task_return_error (task, error);
+                return;
         }
 
-        if (pixbuf != NULL && (style & UM_ICON_STYLE_STATUS) && act_user_is_logged_in (user)) {
-                framed = logged_in_pixbuf (pixbuf, scale);
-                if (framed != NULL) {
-                        g_object_unref (pixbuf);
-                        pixbuf = framed;
-                }
+        g_task_return_pointer (task,
+                               decorate_user_icon (pixbuf, request->style, request->scale),
+                               (GDestroyNotify) cairo_surface_destroy);
+}
+
+static void
+return_cached_icon (GTask      *task,
+                    CachedIcon *cached)
+{
+        if (cached->surface != NULL)
+                g_task_return_pointer (task,
+                                       cairo_surface_reference (cached->surface),
+                                       (GDestroyNotify) cairo_surface_destroy);
+        else
+                g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                                         "No user icon available");
+}
+
+static void
+load_user_icon_cb (GObject      *source_object,
+                   GAsyncResult *res,
+                   gpointer      user_data)
+{
+        gchar *key = user_data;
+        IconRequest *request;
+        CachedIcon *cached;
+        GList *waiting, *l;
+        GError *error = NULL;
+
+        request = g_task_get_task_data (G_TASK (res));
+        cached = g_hash_table_lookup (icon_cache, key);
+        g_assert (cached != NULL && cached->loading);
+
+        cached->surface = g_task_propagate_pointer (G_TASK (res), &error);
+        if (cached->surface == NULL) {
+                g_debug ("Could not load user icon %s: %s", request->icon_file, error->message);
+                g_error_free (error);
+                cached->surface = render_default_icon (request->style, request->icon_size, request->scale);
         }
+        cached->loading = FALSE;
 
-        if (pixbuf != NULL) {
-                surface = gdk_cairo_surface_create_from_pixbuf (pixbuf, scale, NULL);
-                g_object_unref (pixbuf);
+        waiting = cached->waiting;
+        cached->waiting = NULL;
+        for (l = waiting; l != NULL; l = l->next) {
+                return_cached_icon (l->data, cached);
+                g_object_unref (l->data);
         }
+        g_list_free (waiting);
 
-        return surface;
+        g_free (key);
+}
+
+static void
+trim_icon_cache (void)
+{
+        GList *l, *prev;
+
+        /* Icons that are still loading stay, their callback needs them */
+        for (l = icon_lru.tail;
+             l != NULL && g_hash_table_size (icon_cache) >= MAX_CACHED_ICONS;
+             l = prev) {
+                const gchar *key = l->data;
+                CachedIcon *cached;
+
+                prev = l->prev;
+
+                cached = g_hash_table_lookup (icon_cache, key);
+                if (cached->loading)
+                        continue;
+
+                g_queue_delete_link (&icon_lru, l);
+                g_hash_table_remove (icon_cache, key);
+        }
+}
+
+static CachedIcon *
+get_cached_icon (ActUser     *user,
+                 UmIconStyle  style,
+                 gint         icon_size,
+                 gint         scale)
+{
+        CachedIcon *cached;
+        IconRequest *request;
+        GTask *task;
+        struct stat fileinfo;
+        const gchar *icon_file;
+        gchar *key;
+
+        if (icon_cache == NULL)
+                icon_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                    g_free, (GDestroyNotify) cached_icon_free);
+
+        if (!act_user_is_logged_in (user))
+                style &= ~UM_ICON_STYLE_STATUS;
+
+        /* The icon file is replaced in place when the user picks
+         * another picture, so look at more than its mtime */
+        icon_file = act_user_get_icon_file (user);
+        if (icon_file != NULL && check_user_file (icon_file, MAX_FILE_SIZE, &fileinfo)) {
+                key = g_strdup_printf ("%s:%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT ":%d:%d:%d",
+                                       icon_file,
+                                       (gint64) fileinfo.st_ino,
+                                       (gint64) fileinfo.st_size,
+                                       (gint64) fileinfo.st_mtime,
+                                       (gint64) fileinfo.st_ctime,
+                                       icon_size, scale, style);
+        } else {
+                icon_file = NULL;
+                key = g_strdup_printf (":%d:%d:%d", icon_size, scale, style);
+        }
+
+        cached = g_hash_table_lookup (icon_cache, key);
+        if (cached != NULL) {
+                g_free (key);
+                g_queue_unlink (&icon_lru, cached->lru_link);
+                g_queue_push_head_link (&icon_lru, cached->lru_link);
+                return cached;
+        }
+
+        trim_icon_cache ();
+
+        cached = g_new0 (CachedIcon, 1);
+        g_hash_table_insert (icon_cache, key, cached);
+        g_queue_push_head (&icon_lru, key);
+        cached->lru_link = icon_lru.head;
+
+        if (icon_file == NULL) {
+                cached->surface = render_default_icon (style, icon_size, scale);
+                return cached;
+        }
+
+        cached->loading = TRUE;
+
+        request = g_new0 (IconRequest, 1);
+        request->icon_file = g_strdup (icon_file);
+        request->style = style;
+        request->icon_size = icon_size;
+        request->scale = scale;
+
+        task = g_task_new (NULL, NULL, load_user_icon_cb, g_strdup (key));
+        g_task_set_task_data (task, request, (GDestroyNotify) icon_request_free);
+        g_task_run_in_thread (task, load_user_icon_thread);
+        g_object_unref (task);
+
+        return cached;
+}
+
+/**
+ * lookup_user_icon:
+ *
+ * Returns the icon of @user if it is already rendered, which it always
+ * is for users without a picture. Otherwise, starts loading it, and
+ * returns %NULL; use render_user_icon_async() to wait for it.
+ */
+cairo_surface_t *
+lookup_user_icon (ActUser     *user,
+                  UmIconStyle  style,
+                  gint         icon_size,
+                  gint         scale)
+{
+        CachedIcon *cached;
+
+        g_return_val_if_fail (ACT_IS_USER (user), NULL);
+        g_return_val_if_fail (icon_size > 12, NULL);
+
+        cached = get_cached_icon (user, style, icon_size, scale);
+        if (cached->loading || cached->surface == NULL)
+                return NULL;
+
+        return cairo_surface_reference (cached->surface);
+}
+
+void
+render_user_icon_async (ActUser             *user,
+                        UmIconStyle          style,
+                        gint                 icon_size,
+                        gint                 scale,
+                        GCancellable        *cancellable,
+                        GAsyncReadyCallback  callback,
+                        gpointer             user_data)
+{
+        CachedIcon *cached;
+        GTask *task;
+
+        g_return_if_fail (ACT_IS_USER (user));
+        g_return_if_fail (icon_size > 12);
+
+        task = g_task_new (NULL, cancellable, callback, user_data);
+        g_task_set_source_tag (task, render_user_icon_async);
+
+        cached = get_cached_icon (user, style, icon_size, scale);
+        if (cached->loading) {
+                cached->waiting = g_list_prepend (cached->waiting, task);
+                return;
+        }
+
+        return_cached_icon (task, cached);
+        g_object_unref (task);
+}
+
+cairo_surface_t *
+render_user_icon_finish (GAsyncResult  *res,
+                         GError       **error)
+{
+        g_return_val_if_fail (g_task_is_valid (res, NULL), NULL);
+
+        return g_task_propagate_pointer (G_TASK (res), error);
 }
 
 void
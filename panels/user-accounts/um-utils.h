@@ -73,10 +73,19 @@ gboolean is_valid_username                (const gchar     *name,
 void     generate_username_choices        (const gchar     *name,
                                            GtkListStore    *store);
 
-cairo_surface_t *render_user_icon         (ActUser         *user,
+cairo_surface_t *lookup_user_icon         (ActUser         *user,
                                            UmIconStyle      style,
                                            gint             icon_size,
                                            gint             scale);
+void     render_user_icon_async           (ActUser             *user,
+                                           UmIconStyle          style,
+                                           gint                 icon_size,
+                                           gint                 scale,
+                                           GCancellable        *cancellable,
+                                           GAsyncReadyCallback  callback,
+                                           gpointer             user_data);
+cairo_surface_t *render_user_icon_finish  (GAsyncResult        *res,
+                                           GError             **error);
 
 void     set_user_icon_data               (ActUser         *user,
                                            GdkPixbuf       *pixbuf);
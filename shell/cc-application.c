@@ -28,6 +28,7 @@
 #include "cc-application.h"
 #include "cc-panel-loader.h"
 #include "cc-shell-log.h"
+#include "cc-stall-monitor.h"
 #include "cc-window.h"
 
 #if defined(HAVE_WACOM)
@@ -207,6 +208,22 @@ cc_application_activate (GApplication *application)
   cc_window_present (self->priv->window);
 }
 
+static void
+active_panel_changed_cb (CcShell       *shell,
+                         GParamSpec    *pspec,
+                         CcApplication *self)
+{
+  CcPanel *panel;
+
+  /* Panels are attributed their stalls when loaded, see
+   * cc_panel_loader_load_by_name() */
+  panel = cc_shell_get_active_panel (shell);
+  if (panel == NULL)
+    cc_stall_monitor_set_panel (NULL);
+  else
+    g_object_unref (panel);
+}
+
 static void
 cc_application_startup (GApplication *application)
 {
@@ -218,6 +235,8 @@ cc_application_startup (GApplication *application)
 
   G_APPLICATION_CLASS (cc_application_parent_class)->startup (application);
 
+  cc_stall_monitor_start_from_env ();
+
 #if defined(HAVE_WACOM)
   if (gtk_clutter_init (NULL, NULL) != CLUTTER_INIT_SUCCESS)
     {
@@ -261,6 +280,18 @@ cc_application_startup (GApplication *application)
                                          "app.help", help_accels);
 
   self->priv->window = cc_window_new (GTK_APPLICATION (application));
+
+  if (cc_stall_monitor_is_running ())
+    g_signal_connect (self->priv->window, "notify::active-panel",
+                      G_CALLBACK (active_panel_changed_cb), self);
+}
+
+static void
+cc_application_shutdown (GApplication *application)
+{
+  cc_stall_monitor_stop ();
+
+  G_APPLICATION_CLASS (cc_application_parent_class)->shutdown (application);
 }
 
 static GObject *
@@ -311,6 +342,7 @@ cc_application_class_init (CcApplicationClass *class)
   object_class->dispose = cc_application_dispose;
   application_class->activate = cc_application_activate;
   application_class->startup = cc_application_startup;
+  application_class->shutdown = cc_application_shutdown;
   application_class->command_line = cc_application_command_line;
   application_class->handle_local_options = cc_application_handle_local_options;
 
@@ -28,6 +28,8 @@
 
 #ifndef CC_PANEL_LOADER_NO_GTYPES
 
+#include "cc-stall-monitor.h"
+
 /* Extension points */
 extern GType cc_background_panel_get_type (void);
 #ifdef BUILD_BLUETOOTH
@@ -225,6 +227,8 @@ cc_panel_loader_load_by_name (CcShell     *shell,
   get_type = g_hash_table_lookup (panel_types, name);
   g_return_val_if_fail (get_type != NULL, NULL);
 
+  cc_stall_monitor_set_panel (name);
+
   return g_object_new (get_type (),
                        "shell", shell,
                        "parameters", parameters,
@@ -0,0 +1,504 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/*
+ * The Control Center is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * The Control Center is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with the Control Center; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* Debugging aid that reports when the main loop is blocked for too
+ * long, typically by synchronous D-Bus calls or file I/O in panels.
+ *
+ * Set CC_STALL_MONITOR_THRESHOLD to a number of milliseconds to enable
+ * it. Every stall over the threshold is attributed to the panel that
+ * was active or being loaded, and, where backtrace() is available, to
+ * the innermost control center function on the stack while the main
+ * thread was blocked. The summary is printed on exit and on SIGUSR1.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#ifdef G_OS_UNIX
+#include <glib-unix.h>
+#endif
+
+#if defined(HAVE_EXECINFO_H) && defined(G_OS_UNIX)
+#define CC_STALL_MONITOR_SAMPLING 1
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+#include "cc-stall-monitor.h"
+
+#define DEFAULT_THRESHOLD_MS 50
+#define MAX_FRAMES           64
+
+typedef struct
+{
+  char   *panel;
+  char   *site;
+  guint   count;
+  gint64  total_us;
+  gint64  max_us;
+} StallStats;
+
+typedef struct
+{
+  GSource source;
+  gint64  dispatch_start;
+} MonitorSource;
+
+static GSource *monitor_source = NULL;
+static gint64 threshold_us = 0;
+static char *current_panel = NULL;
+static GHashTable *stalls = NULL;
+static guint report_signal_id = 0;
+
+#ifdef CC_STALL_MONITOR_SAMPLING
+#define SAMPLE_SIGNAL SIGPROF
+
+static pthread_t main_thread;
+static GThread *watchdog = NULL;
+static volatile gint watchdog_running = 0;
+
+/* Incremented when the main loop starts and stops dispatching, so it
+ * is odd while the main thread is busy */
+static volatile gint busy_generation = 0;
+
+/* Written by the signal handler, which runs in the main thread */
+static void *sample_frames[MAX_FRAMES];
+static volatile sig_atomic_t n_sample_frames = 0;
+#endif /* CC_STALL_MONITOR_SAMPLING */
+
+static void
+stall_stats_free (StallStats *stats)
+{
+  g_free (stats->panel);
+  g_free (stats->site);
+  g_free (stats);
+}
+
+#ifdef CC_STALL_MONITOR_SAMPLING
+static void
+sample_signal_handler (int signum)
+{
+  n_sample_frames = backtrace (sample_frames, MAX_FRAMES);
+}
+
+static gpointer
+watchdog_thread (gpointer data)
+{
+  gint seen_generation = 0;
+  gint sampled_generation = 0;
+  gint64 seen_since = 0;
+  gulong interval;
+
+  interval = MAX (threshold_us / 4, 1000);
+
+  while (g_atomic_int_get (&watchdog_running))
+    {
+      gint generation;
+
+      g_usleep (interval);
+
+      generation = g_atomic_int_get (&busy_generation);
+      if ((generation & 1) == 0)
+        continue;
+
+      if (generation != seen_generation)
+        {
+          seen_generation = generation;
+          seen_since = g_get_monotonic_time () - interval / 2;
+          continue;
+        }
+
+      /* Look at what the main thread is doing, once per stall */
+      if (generation != sampled_generation &&
+          g_get_monotonic_time () - seen_since >= threshold_us)
+        {
+          sampled_generation = generation;
+          pthread_kill (main_thread, SAMPLE_SIGNAL);
+        }
+    }
+
+  return NULL;
+}
+
+/* Frames look like "module(function+0x12) [0x1234]" */
+static char *
+frame_get_module (const char *symbol)
+{
+  return g_strndup (symbol, strcspn (symbol, "( "));
+}
+
+static char *
+frame_get_function (const char *symbol)
+{
+  const char *start;
+  gsize len;
+
+  start = strchr (symbol, '(');
+  if (start == NULL)
+    return g_strdup (symbol);
+
+  start++;
+  len = strcspn (start, "+)");
+
+  /* Static functions aren't named, keep the offset for addr2line */
+  if (len == 0)
+    return g_strdup (symbol);
+
+  return g_strndup (start, len);
+}
+
+static char *
+get_sample_site (void)
+{
+  char **symbols;
+  char *module;
+  char *site = NULL;
+  int i, n;
+
+  n = n_sample_frames;
+  if (n <= 1)
+    return NULL;
+
+  symbols = backtrace_symbols (sample_frames, n);
+  if (symbols == NULL)
+    return NULL;
+
+  /* The first frame is the signal handler, so in the executable, and
+   * the second one is the signal trampoline. Report the innermost
+   * frame of the executable after those, and what it called into. */
+  module = frame_get_module (symbols[0]);
+  for (i = 2; i < n; i++)
+    {
+      char *frame_module, *function, *callee;
+
+      frame_module = frame_get_module (symbols[i]);
+      if (g_strcmp0 (frame_module, module) != 0)
+        {
+          g_free (frame_module);
+          continue;
+        }
+      g_free (frame_module);
+
+      function = frame_get_function (symbols[i]);
+      if (i > 2)
+        {
+          callee = frame_get_function (symbols[i - 1]);
+          site = g_strdup_printf ("%s → %s", function, callee);
+          g_free (callee);
+          g_free (function);
+        }
+      else
+        {
+          site = function;
+        }
+      break;
+    }
+
+  g_free (module);
+  free (symbols);
+
+  return site;
+}
+#endif /* CC_STALL_MONITOR_SAMPLING */
+
+static void
+record_stall (gint64 elapsed_us)
+{
+  StallStats *stats;
+  const char *panel;
+  char *site = NULL;
+  char *key;
+
+#ifdef CC_STALL_MONITOR_SAMPLING
+  site = get_sample_site ();
+#endif
+  if (site == NULL)
+    site = g_strdup ("unknown");
+
+  panel = current_panel != NULL ? current_panel : "overview";
+
+  g_debug ("Main loop blocked for %" G_GINT64_FORMAT " ms in %s, at %s",
+           elapsed_us / 1000, panel, site);
+
+  key = g_strconcat (panel, "\n", site, NULL);
+  stats = g_hash_table_lookup (stalls, key);
+  if (stats == NULL)
+    {
+      stats = g_new0 (StallStats, 1);
+      stats->panel = g_strdup (panel);
+      stats->site = site;
+      g_hash_table_insert (stalls, key, stats);
+    }
+  else
+    {
+      g_free (site);
+      g_free (key);
+    }
+
+  stats->count++;
+  stats->total_us += elapsed_us;
+  stats->max_us = MAX (stats->max_us, elapsed_us);
+}
+
+/* The source is never ready, it only times how long the main loop
+ * spends dispatching between polls: check() is called after polling,
+ * and prepare() again once all the ready sources are dispatched. */
+static gboolean
+monitor_prepare (GSource *source,
+                 gint    *timeout)
+{
+  MonitorSource *monitor = (MonitorSource *) source;
+
+  *timeout = -1;
+
+  if (monitor->dispatch_start != 0)
+    {
+      gint64 elapsed_us;
+
+      elapsed_us = g_get_monotonic_time () - monitor->dispatch_start;
+      monitor->dispatch_start = 0;
+#ifdef CC_STALL_MONITOR_SAMPLING
+      g_atomic_int_inc (&busy_generation);
+#endif
+
+      if (elapsed_us >= threshold_us)
+        record_stall (elapsed_us);
+    }
+
+  return FALSE;
+}
+
+static gboolean
+monitor_check (GSource *source)
+{
+  MonitorSource *monitor = (MonitorSource *) source;
+
+  monitor->dispatch_start = g_get_monotonic_time ();
+#ifdef CC_STALL_MONITOR_SAMPLING
+  n_sample_frames = 0;
+  g_atomic_int_inc (&busy_generation);
+#endif
+
+  return FALSE;
+}
+
+static gboolean
+monitor_dispatch (GSource     *source,
+                  GSourceFunc  callback,
+                  gpointer     user_data)
+{
+  return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs monitor_funcs = {
+  monitor_prepare,
+  monitor_check,
+  monitor_dispatch,
+  NULL
+};
+
+#ifdef G_OS_UNIX
+static gboolean
+report_signal_cb (gpointer user_data)
+{
+  cc_stall_monitor_print_report ();
+  return G_SOURCE_CONTINUE;
+}
+#endif
+
+static gint
+compare_stats_by_total (gconstpointer a,
+                        gconstpointer b)
+{
+  const StallStats *sa = *(const StallStats **) a;
+  const StallStats *sb = *(const StallStats **) b;
+
+  if (sa->total_us != sb->total_us)
+    return sa->total_us > sb->total_us ? -1 : 1;
+  return g_strcmp0 (sa->site, sb->site);
+}
+
+/**
+ * cc_stall_monitor_print_report:
+ *
+ * Prints the stalls recorded so far to stderr, grouped by panel and
+ * call site, the longest total first.
+ */
+void
+cc_stall_monitor_print_report (void)
+{
+  GHashTableIter iter;
+  GPtrArray *sorted;
+  StallStats *stats;
+  guint i;
+
+  if (stalls == NULL)
+    return;
+
+  sorted = g_ptr_array_new ();
+  g_hash_table_iter_init (&iter, stalls);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &stats))
+    g_ptr_array_add (sorted, stats);
+  g_ptr_array_sort (sorted, compare_stats_by_total);
+
+  g_printerr ("Main loop stalls over %" G_GINT64_FORMAT " ms:\n", threshold_us / 1000);
+  g_printerr ("%10s %6s %10s  %-20s %s\n", "total ms", "count", "max ms", "panel", "site");
+  for (i = 0; i < sorted->len; i++)
+    {
+      stats = g_ptr_array_index (sorted, i);
+      g_printerr ("%10.1f %6u %10.1f  %-20s %s\n",
+                  stats->total_us / 1000.0,
+                  stats->count,
+                  stats->max_us / 1000.0,
+                  stats->panel,
+                  stats->site);
+    }
+
+  g_ptr_array_unref (sorted);
+}
+
+/**
+ * cc_stall_monitor_start:
+ * @threshold_ms: the shortest stall to report
+ *
+ * Starts watching the default main context.
+ */
+void
+cc_stall_monitor_start (guint threshold_ms)
+{
+  if (monitor_source != NULL)
+    return;
+
+  threshold_us = (gint64) threshold_ms * 1000;
+  stalls = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                  g_free, (GDestroyNotify) stall_stats_free);
+
+  monitor_source = g_source_new (&monitor_funcs, sizeof (MonitorSource));
+  /* Sources with a lower priority than a ready one aren't checked */
+  g_source_set_priority (monitor_source, G_MININT);
+  g_source_set_name (monitor_source, "[gnome-control-center] stall monitor");
+  g_source_attach (monitor_source, NULL);
+
+#ifdef G_OS_UNIX
+  report_signal_id = g_unix_signal_add (SIGUSR1, report_signal_cb, NULL);
+#endif
+
+#ifdef CC_STALL_MONITOR_SAMPLING
+  {
+    struct sigaction action;
+
+    memset (&action, 0, sizeof (action));
+    action.sa_handler = sample_signal_handler;
+    action.sa_flags = SA_RESTART;
+    sigemptyset (&action.sa_mask);
+    sigaction (SAMPLE_SIGNAL, &action, NULL);
+
+    /* The first call loads libgcc, which can't be done in the handler */
+    backtrace (sample_frames, MAX_FRAMES);
+    n_sample_frames = 0;
+
+    main_thread = pthread_self ();
+    g_atomic_int_set (&watchdog_running, 1);
+    watchdog = g_thread_new ("stall-watchdog", watchdog_thread, NULL);
+  }
+#endif
+
+  g_message ("Reporting main loop stalls over %u ms", threshold_ms);
+}
+
+/**
+ * cc_stall_monitor_start_from_env:
+ *
+ * Starts the monitor if CC_STALL_MONITOR_THRESHOLD is set.
+ */
+void
+cc_stall_monitor_start_from_env (void)
+{
+  const char *value;
+  guint64 threshold_ms;
+
+  value = g_getenv ("CC_STALL_MONITOR_THRESHOLD");
+  if (value == NULL)
+    return;
+
+  threshold_ms = g_ascii_strtoull (value, NULL, 10);
+  if (threshold_ms == 0 || threshold_ms > G_MAXUINT)
+    threshold_ms = DEFAULT_THRESHOLD_MS;
+
+  cc_stall_monitor_start (threshold_ms);
+}
+
+/**
+ * cc_stall_monitor_stop:
+ *
+ * Prints the report and stops watching the main context.
+ */
+void
+cc_stall_monitor_stop (void)
+{
+  if (monitor_source == NULL)
+    return;
+
+  cc_stall_monitor_print_report ();
+
+#ifdef CC_STALL_MONITOR_SAMPLING
+  g_atomic_int_set (&watchdog_running, 0);
+  g_thread_join (watchdog);
+  watchdog = NULL;
+  signal (SAMPLE_SIGNAL, SIG_DFL);
+#endif
+
+  if (report_signal_id != 0)
+    {
+      g_source_remove (report_signal_id);
+      report_signal_id = 0;
+    }
+
+  g_source_destroy (monitor_source);
+  g_source_unref (monitor_source);
+  monitor_source = NULL;
+
+  g_clear_pointer (&stalls, g_hash_table_destroy);
+  g_clear_pointer (&current_panel, g_free);
+}
+
+gboolean
+cc_stall_monitor_is_running (void)
+{
+  return monitor_source != NULL;
+}
+
+/**
+ * cc_stall_monitor_set_panel:
+ * @panel_id: (allow-none): the panel being loaded or shown, or %NULL
+ *   for the overview
+ *
+ * Sets the panel that the following stalls are attributed to.
+ */
+void
+cc_stall_monitor_set_panel (const char *panel_id)
+{
+  if (monitor_source == NULL)
+    return;
+
+  g_free (current_panel);
+  current_panel = g_strdup (panel_id);
+}
@@ -0,0 +1,35 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/*
+ * The Control Center is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * The Control Center is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with the Control Center; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _CC_STALL_MONITOR_H
+#define _CC_STALL_MONITOR_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+void     cc_stall_monitor_start_from_env (void);
+void     cc_stall_monitor_start          (guint       threshold_ms);
+void     cc_stall_monitor_stop           (void);
+gboolean cc_stall_monitor_is_running     (void);
+
+void     cc_stall_monitor_set_panel      (const char *panel_id);
+void     cc_stall_monitor_print_report   (void);
+
+G_END_DECLS
+
+#endif /* _CC_STALL_MONITOR_H */